@@ -0,0 +1,42 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <time.h>
+
+#define DRILL_BENCHMARK_TICK_COUNT (600)
+
+// Ticks drills with 1, 16 and 256 balls, the cost should grow far slower than the ball count
+UTEST(NimbleBallBenchmark, drill)
+{
+    static NlDrill drill;
+    const size_t ballCounts[] = {1, 16, NL_DRILL_MAX_BALLS};
+
+    for (size_t countIndex = 0; countIndex < sizeof(ballCounts) / sizeof(ballCounts[0]); ++countIndex) {
+        size_t ballCount = ballCounts[countIndex];
+        NlGame game;
+        nlGameInit(&game);
+        startTwoPlayerMatch(&game);
+        nlDrillInit(&drill, &game, ballCount);
+
+        uint32_t seed = 11;
+        clock_t start = clock();
+        for (size_t tick = 0; tick < DRILL_BENCHMARK_TICK_COUNT; ++tick) {
+            NlPlayerInputWithParticipantInfo inputs[2];
+            for (uint8_t i = 0; i < 2; ++i) {
+                seed = seed * 1664525u + 1013904223u;
+                setInGameInput(&inputs[i], (uint8_t) (i + 1), (int8_t) (seed >> 24), (int8_t) (seed >> 16),
+                               (uint8_t) ((tick % 30) < 10 ? 0x01 : 0));
+            }
+            nlGameTickDrill(&game, &drill, inputs, 2, 0);
+        }
+        clock_t drillClocks = clock() - start;
+        ASSERT_EQ(ballCount, (size_t) drill.balls.count);
+
+        printf("drill %3zu balls: %d ticks, %ld clocks\n", ballCount, DRILL_BENCHMARK_TICK_COUNT, (long) drillClocks);
+    }
+}
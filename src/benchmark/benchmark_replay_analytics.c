@@ -0,0 +1,117 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay_analytics.h>
+#include <time.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+#define ANALYTICS_BENCHMARK_REPLAY_COUNT (8)
+#define ANALYTICS_BENCHMARK_TICK_COUNT (3600)
+#define ANALYTICS_BENCHMARK_KEYFRAME_INTERVAL (600)
+#define ANALYTICS_BENCHMARK_KEYFRAME_COUNT (ANALYTICS_BENCHMARK_TICK_COUNT / ANALYTICS_BENCHMARK_KEYFRAME_INTERVAL)
+#define ANALYTICS_BENCHMARK_WORKER_COUNT (4)
+
+static NlReplayTick g_benchmarkTicks[ANALYTICS_BENCHMARK_REPLAY_COUNT][ANALYTICS_BENCHMARK_TICK_COUNT];
+static NlReplayKeyframe g_benchmarkKeyframes[ANALYTICS_BENCHMARK_REPLAY_COUNT][ANALYTICS_BENCHMARK_KEYFRAME_COUNT];
+static NlReplay g_benchmarkReplays[ANALYTICS_BENCHMARK_REPLAY_COUNT];
+
+static void recordBenchmarkReplay(size_t replayIndex)
+{
+    NlReplayRecorder recorder;
+    nlReplayRecorderInit(&recorder, g_benchmarkTicks[replayIndex], ANALYTICS_BENCHMARK_TICK_COUNT,
+                         g_benchmarkKeyframes[replayIndex], ANALYTICS_BENCHMARK_KEYFRAME_COUNT,
+                         ANALYTICS_BENCHMARK_KEYFRAME_INTERVAL);
+
+    NlGame game;
+    nlGameInit(&game);
+    uint32_t seed = (uint32_t) (replayIndex * 31 + 5);
+    for (size_t tick = 0; tick < ANALYTICS_BENCHMARK_TICK_COUNT; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        for (uint8_t participant = 0; participant < 2; ++participant) {
+            uint8_t participantId = (uint8_t) (participant + 1);
+            if (tick == 0) {
+                setSelectTeamInput(&inputs[participant], participantId, participant);
+                continue;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            setInGameInput(&inputs[participant], participantId, (int8_t) (seed >> 24), (int8_t) (seed >> 16),
+                           (uint8_t) ((tick % 35) < 10 ? 0x01 : 0));
+        }
+        nlReplayRecorderTick(&recorder, &game, inputs, 2);
+    }
+
+    nlReplayRecorderReplay(&recorder, &g_benchmarkReplays[replayIndex]);
+}
+
+static bool loadBenchmarkReplay(void* userData, size_t replayIndex, NlReplay* target)
+{
+    (void) userData;
+    *target = g_benchmarkReplays[replayIndex];
+    return true;
+}
+
+static void* processReplays(void* _worker)
+{
+    NlReplayAnalyticsWorker* worker = (NlReplayAnalyticsWorker*) _worker;
+    while (nlReplayAnalyticsWorkerProcessNext(worker)) {
+    }
+
+    return 0;
+}
+
+// Resimulation throughput of the analytics workers, without any callbacks besides loading
+UTEST(NimbleBallBenchmark, replayAnalytics)
+{
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_REPLAY_COUNT; ++i) {
+        recordBenchmarkReplay(i);
+    }
+
+    NlReplayAnalyticsCallbacks callbacks;
+    callbacks.load = loadBenchmarkReplay;
+    callbacks.release = 0;
+    callbacks.tick = 0;
+    callbacks.match = 0;
+    callbacks.userData = 0;
+
+    NlReplayAnalytics analytics;
+    nlReplayAnalyticsInit(&analytics, ANALYTICS_BENCHMARK_REPLAY_COUNT, callbacks);
+    static NlReplayAnalyticsWorker workers[ANALYTICS_BENCHMARK_WORKER_COUNT];
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_WORKER_COUNT; ++i) {
+        nlReplayAnalyticsWorkerInit(&workers[i], &analytics, 0);
+    }
+
+    clock_t start = clock();
+#if !defined _WIN32
+    pthread_t threads[ANALYTICS_BENCHMARK_WORKER_COUNT];
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_WORKER_COUNT; ++i) {
+        pthread_create(&threads[i], 0, processReplays, &workers[i]);
+    }
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_WORKER_COUNT; ++i) {
+        pthread_join(threads[i], 0);
+    }
+#else
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_WORKER_COUNT; ++i) {
+        processReplays(&workers[i]);
+    }
+#endif
+    clock_t processorClocks = clock() - start;
+
+    uint64_t simulatedTickCount = 0;
+    for (size_t i = 0; i < ANALYTICS_BENCHMARK_WORKER_COUNT; ++i) {
+        simulatedTickCount += workers[i].simulatedTickCount;
+    }
+    ASSERT_EQ((uint64_t) ANALYTICS_BENCHMARK_REPLAY_COUNT * ANALYTICS_BENCHMARK_TICK_COUNT, simulatedTickCount);
+
+    // Processor time is summed over all threads, so this is the throughput of one core
+    double processorSeconds = (double) processorClocks / CLOCKS_PER_SEC;
+    printf("replay analytics: %llu ticks on %d workers, %.0f ticks per second per core\n",
+           (unsigned long long) simulatedTickCount, ANALYTICS_BENCHMARK_WORKER_COUNT,
+           processorSeconds > 0.0 ? (double) simulatedTickCount / processorSeconds : 0.0);
+}
@@ -0,0 +1,86 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_fan_out.h>
+#include <time.h>
+
+#define FAN_OUT_BENCHMARK_TICK_COUNT (60)
+#define FAN_OUT_BENCHMARK_BASELINE_COUNT (4)
+#define FAN_OUT_BENCHMARK_TIER_COUNT (2)
+#define FAN_OUT_BENCHMARK_MAX_SPECTATORS (1000)
+#define FAN_OUT_BENCHMARK_BASELINE_TICK_STEP (6)
+
+// Compares the fan out with encoding once per spectator, for 1, 100 and 1000 spectators
+UTEST(NimbleBallBenchmark, snapshotFanOut)
+{
+    static NlSnapshotFanOut fanOut;
+    static const NlSharedSnapshot* sent[FAN_OUT_BENCHMARK_MAX_SPECTATORS];
+    static uint8_t perConnectionOctets[NL_SNAPSHOT_MAX_OCTET_COUNT];
+    const size_t spectatorCounts[] = {1, 100, FAN_OUT_BENCHMARK_MAX_SPECTATORS};
+
+    // The baselines are taken a few ticks apart from a match where the avatars and the ball are moving
+    NlGame history[FAN_OUT_BENCHMARK_BASELINE_COUNT + 1];
+    nlGameInit(&history[0]);
+    startTwoPlayerMatch(&history[0]);
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[0], 1, 60, 30, 0x01);
+    setInGameInput(&inputs[1], 2, -40, -20, 0);
+    for (size_t i = 0; i < 60; ++i) {
+        nlGameTick(&history[0], inputs, 2, 0);
+    }
+    for (size_t i = 1; i <= FAN_OUT_BENCHMARK_BASELINE_COUNT; ++i) {
+        history[i] = history[i - 1];
+        for (size_t step = 0; step < FAN_OUT_BENCHMARK_BASELINE_TICK_STEP; ++step) {
+            nlGameTick(&history[i], inputs, 2, 0);
+        }
+    }
+    ASSERT_EQ(NlGamePhasePlaying, history[FAN_OUT_BENCHMARK_BASELINE_COUNT].phase);
+
+    for (size_t countIndex = 0; countIndex < sizeof(spectatorCounts) / sizeof(spectatorCounts[0]); ++countIndex) {
+        size_t spectatorCount = spectatorCounts[countIndex];
+        nlSnapshotFanOutInit(&fanOut);
+        size_t fanOutOctetCount = 0;
+
+        clock_t start = clock();
+        for (uint32_t tickId = 0; tickId < FAN_OUT_BENCHMARK_TICK_COUNT; ++tickId) {
+            for (size_t i = 0; i < spectatorCount; ++i) {
+                size_t baselineIndex = i % FAN_OUT_BENCHMARK_BASELINE_COUNT;
+                uint8_t tier = (uint8_t) ((i / FAN_OUT_BENCHMARK_BASELINE_COUNT) % FAN_OUT_BENCHMARK_TIER_COUNT);
+                sent[i] = nlSnapshotFanOutAcquire(&fanOut, &history[FAN_OUT_BENCHMARK_BASELINE_COUNT], tickId,
+                                                  &history[baselineIndex], (uint32_t) baselineIndex, tier);
+                ASSERT_TRUE(sent[i] != 0);
+            }
+            // Each shared snapshot is counted once, however many spectators hold it
+            for (size_t i = 0; i < fanOut.currentCount; ++i) {
+                fanOutOctetCount += (size_t) fanOut.snapshots[fanOut.currentIndices[i]].octetCount;
+            }
+            for (size_t i = 0; i < spectatorCount; ++i) {
+                nlSharedSnapshotRelease(sent[i]);
+            }
+        }
+        clock_t fanOutClocks = clock() - start;
+
+        size_t perConnectionOctetCount = 0;
+        start = clock();
+        for (uint32_t tickId = 0; tickId < FAN_OUT_BENCHMARK_TICK_COUNT; ++tickId) {
+            for (size_t i = 0; i < spectatorCount; ++i) {
+                size_t baselineIndex = i % FAN_OUT_BENCHMARK_BASELINE_COUNT;
+                int octetCount = nlSnapshotEncode(&history[FAN_OUT_BENCHMARK_BASELINE_COUNT], &history[baselineIndex],
+                                                  perConnectionOctets, sizeof(perConnectionOctets));
+                ASSERT_TRUE(octetCount > 0);
+                perConnectionOctetCount += (size_t) octetCount;
+            }
+        }
+        clock_t perConnectionClocks = clock() - start;
+
+        printf("fan out %4zu spectators: %zu encodes, %ld clocks, %zu octets encoded per tick. per connection: %zu "
+               "encodes, %ld clocks, %zu octets encoded per tick\n",
+               spectatorCount, fanOut.stats.encodeCount, (long) fanOutClocks,
+               fanOutOctetCount / FAN_OUT_BENCHMARK_TICK_COUNT, FAN_OUT_BENCHMARK_TICK_COUNT * spectatorCount,
+               (long) perConnectionClocks, perConnectionOctetCount / FAN_OUT_BENCHMARK_TICK_COUNT);
+    }
+}
@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_fan_out.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_spectator.h>
+#include <time.h>
+
+#define SPECTATOR_BENCHMARK_ENCODE_COUNT (10000)
+#define SPECTATOR_BENCHMARK_PLAYING_TICK_COUNT (120)
+
+// Encodes a spectator snapshot of a running match and compares its size and cost with a full snapshot
+UTEST(NimbleBallBenchmark, spectatorSnapshot)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    // Keep both participants moving so the avatars and the ball are spread over the field
+    NlPlayerInputWithParticipantInfo inputs[2];
+    for (size_t i = 0; i < SPECTATOR_BENCHMARK_PLAYING_TICK_COUNT; ++i) {
+        int8_t direction = (int8_t) ((i % 60) < 30 ? 1 : -1);
+        setInGameInput(&inputs[0], 1, (int8_t) (direction * 60), (int8_t) (direction * 30), 0x01);
+        setInGameInput(&inputs[1], 2, (int8_t) (direction * -40), (int8_t) (direction * -20), 0);
+        nlGameTick(&game, inputs, 2, 0);
+    }
+    ASSERT_EQ(NlGamePhasePlaying, game.phase);
+    ASSERT_EQ(2, game.avatars.avatarCount);
+
+    NlSpectatorLod lod;
+    nlSpectatorLodInit(&lod, 0.5f, 64, 1);
+
+    static uint8_t octets[NL_SNAPSHOT_MAX_OCTET_COUNT];
+    int spectatorOctetCount = 0;
+    clock_t start = clock();
+    for (size_t i = 0; i < SPECTATOR_BENCHMARK_ENCODE_COUNT; ++i) {
+        spectatorOctetCount = nlSpectatorFanOutEncode(&lod, &game, 0, NlSnapshotPrecisionTierSpectator, octets,
+                                                      sizeof(octets));
+    }
+    clock_t spectatorClocks = clock() - start;
+
+    int fullOctetCount = 0;
+    start = clock();
+    for (size_t i = 0; i < SPECTATOR_BENCHMARK_ENCODE_COUNT; ++i) {
+        fullOctetCount = nlSnapshotEncode(&game, 0, octets, sizeof(octets));
+    }
+    clock_t fullClocks = clock() - start;
+    ASSERT_TRUE(spectatorOctetCount > 0 && fullOctetCount > 0);
+
+    printf("%d encodes. spectator snapshot: %d octets, %ld clocks. full snapshot: %d octets, %ld clocks\n",
+           SPECTATOR_BENCHMARK_ENCODE_COUNT, spectatorOctetCount, (long) spectatorClocks, fullOctetCount,
+           (long) fullClocks);
+}
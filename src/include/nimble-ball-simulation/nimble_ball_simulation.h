@@ -19,6 +19,22 @@
 
 static const uint8_t NL_TEAM_UNDEFINED = 0xff;
 static const uint8_t NL_AVATAR_INDEX_UNDEFINED = 0xff;
+static const uint8_t NL_PLAYER_INDEX_UNDEFINED = 0xff;
+
+/// One bit for each slot, must be able to hold NL_MAX_PLAYERS bits
+typedef uint16_t NlSlotMask;
+
+/// Stable reference to a player slot. Goes stale when the player leaves, even if the slot is reused.
+typedef struct NlPlayerHandle {
+    uint8_t index;
+    uint8_t generation;
+} NlPlayerHandle;
+
+/// Stable reference to an avatar slot. Goes stale when the avatar is despawned, even if the slot is reused.
+typedef struct NlAvatarHandle {
+    uint8_t index;
+    uint8_t generation;
+} NlAvatarHandle;
 
 typedef struct NlGoal {
     int ownedByTeam;
@@ -26,14 +42,105 @@ typedef struct NlGoal {
     bool facingLeft;
 } NlGoal;
 
+/// Arena layout and gameplay tunables of a game mode. Durations are in ticks at NL_DEFAULT_TICK_DURATION_MS.
+typedef struct NlRuleset {
+    float arenaLeft;
+    float arenaBottom;
+    float arenaWidth;
+    float arenaHeight;
+    float goalSize;
+    float goalDetectWidth;
+    float ballRadius;
+    float avatarRadius;
+    float dribbleReachExtra; ///< added to the avatar radius to get the distance it can dribble the ball from
+    float dribbleDistanceFromBody;
+    uint16_t matchDurationInTicks;
+    uint16_t countDownTicks;
+    uint16_t afterGoalTicks;
+    uint16_t postGameTicks;
+    uint8_t kickCooldownTicks;
+    uint8_t dribbleCooldownTicks;
+    uint8_t maxKickPowerTicks;
+    uint8_t slideTackleDurationTicks;
+    uint8_t slideTackleCooldownTicks;
+} NlRuleset;
+
+extern const NlRuleset g_nlDefaultRuleset;
+
+/// Arena geometry derived from a ruleset
 typedef struct NlConstants {
     NlGoal goals[2];
     BlLineSegment borderSegments[6];
-    uint16_t matchDurationInTicks;
+    uint16_t matchDurationInTicks; ///< at NL_DEFAULT_TICK_DURATION_MS, see NlTickRate for other tick durations
 } NlConstants;
 
+/// Derived from g_nlDefaultRuleset
 extern const NlConstants g_nlConstants;
 
+void nlConstantsInit(NlConstants* self, const NlRuleset* ruleset);
+
+#define NL_DEFAULT_TICK_DURATION_MS (16)
+#define NL_MIN_TICK_DURATION_MS (8)
+#define NL_MAX_TICK_DURATION_MS (50)
+
+/// Timers and physics factors for a tick duration. The gameplay is tuned for NL_DEFAULT_TICK_DURATION_MS, other
+/// durations keep the timers at the same wall clock time and the motion (velocities are in units per tick) the same
+/// per second.
+typedef struct NlTickRate {
+    uint16_t tickDurationMs;
+    float timeScale;         ///< tick duration relative to NL_DEFAULT_TICK_DURATION_MS, scales velocities
+    float accelerationScale; ///< timeScale squared
+    uint16_t countDownTicks;
+    uint16_t afterGoalTicks;
+    uint16_t postGameTicks;
+    uint16_t matchDurationInTicks;
+    uint8_t kickCooldownTicks;
+    uint8_t dribbleCooldownTicks;
+    uint8_t maxKickPowerTicks;
+    uint8_t slideTackleDurationTicks;
+    uint8_t slideTackleCooldownTicks;
+    float ballDamping;
+    float avatarDamping;
+    float dribblePull;    ///< fraction of the distance to the dribble position the ball moves each tick
+    float rotationFollow; ///< fraction of the angle to the requested direction the avatar turns each tick
+} NlTickRate;
+
+/// `tickDurationMs` must be in [NL_MIN_TICK_DURATION_MS, NL_MAX_TICK_DURATION_MS]. Timers that do not fit their
+/// field at short tick durations are clamped.
+void nlTickRateInit(NlTickRate* self, const NlRuleset* ruleset, uint16_t tickDurationMs);
+
+/// The rules a game is played with
+typedef struct NlRules {
+    NlRuleset ruleset;
+    NlConstants constants;
+    NlTickRate tickRate;
+} NlRules;
+
+void nlRulesInit(NlRules* self, const NlRuleset* ruleset, uint16_t tickDurationMs);
+
+#define NL_DEFAULT_RULES_ID (0)
+#define NL_INVALID_RULES_ID (0xff)
+#define NL_MAX_REGISTERED_RULES (16)
+
+/// Which rules a game is played with. The game state only holds this reference, so the rules do not add to every
+/// snapshot and replay keyframe. Resolved with nlRulesResolve. The id is only valid in the process that registered
+/// the rules, so replays and checkpoints store the ruleset and tick duration and bind the games to them when read.
+typedef struct NlRulesRef {
+    uint8_t id;     ///< NL_DEFAULT_RULES_ID or an id from nlRulesRegister
+    bool isDefault; ///< g_nlDefaultRuleset at NL_DEFAULT_TICK_DURATION_MS, ticked with a specialized code path
+} NlRulesRef;
+
+/// Returns the reference to the rules for `ruleset` at `tickDurationMs`, registering them the first time. The
+/// default rules are built in. Ids are handed out in registration order, so processes that exchange snapshots must
+/// register the same rules in the same order. Thread safe. Returns NL_INVALID_RULES_ID, which does not resolve, if
+/// NL_MAX_REGISTERED_RULES other rules are registered.
+NlRulesRef nlRulesRegister(const NlRuleset* ruleset, uint16_t tickDurationMs);
+/// Same as nlRulesRegister for a ruleset read back from storage (replays, checkpoints), where a copy of
+/// g_nlDefaultRuleset gets the default rules
+NlRulesRef nlRulesRegisterStored(const NlRuleset* ruleset, uint16_t tickDurationMs);
+/// Returns NULL if the rules are not registered in this process
+const NlRules* nlRulesResolve(NlRulesRef ref);
+
 typedef struct NlPlayerInGameInput {
     int8_t verticalAxis;
     int8_t horizontalAxis;
@@ -80,6 +187,7 @@ typedef enum NlPlayerPhase {
 
 typedef struct NlPlayer {
     uint8_t playerIndex;
+    uint8_t generation;
     uint8_t preferredTeamId;
     uint8_t controllingAvatarIndex;
     uint8_t assignedToParticipantIndex;
@@ -99,13 +207,17 @@ typedef struct NlTeams {
     uint8_t teamCount;
 } NlTeams;
 
+/// Players are stored in stable slots, a player keeps its index until it leaves.
+/// Iterate using `activeMask`, `playerCount` is only the number of active slots.
 typedef struct NlPlayers {
     NlPlayer players[NL_MAX_PLAYERS];
+    NlSlotMask activeMask;
     uint8_t playerCount;
 } NlPlayers;
 
 typedef struct NlAvatar {
     uint8_t avatarIndex;
+    uint8_t generation;
     BlCircle circle;
     BlVector2 requestedVelocity;
     BlVector2 velocity;
@@ -125,8 +237,11 @@ typedef struct NlAvatar {
     bool isInvisible;
 } NlAvatar;
 
+/// Avatars are stored in stable slots, an avatar keeps its index until it is despawned.
+/// Iterate using `activeMask`, `avatarCount` is only the number of active slots.
 typedef struct NlAvatars {
     NlAvatar avatars[NL_MAX_PLAYERS];
+    NlSlotMask activeMask;
     uint8_t avatarCount;
 } NlAvatars;
 
@@ -156,10 +271,228 @@ typedef struct NlGame {
     uint16_t tickCount;
     uint16_t matchClockLeftInTicks;
     uint8_t latestScoredTeamIndex;
+    NlRulesRef rules;
 } NlGame;
 
+/// What a tick did to state shared between avatars, used to decide if a misprediction needs a full resimulation.
+typedef struct NlTickFootprint {
+    NlSlotMask dribbleTouchedMask; ///< avatars that dribbled the ball (tickDribble)
+    NlSlotMask kickTouchedMask;    ///< avatars that kicked the ball (performKick)
+    NlSlotMask borderHitMask;      ///< avatars that collided with the borders
+    bool ballHitBorder;
+    bool isPlayingWithSameRoster; ///< played the whole tick without phase changes, joins or leaves
+    NlBall ballBeforeDribble;
+    NlBall ballBeforeKick;
+} NlTickFootprint;
+
+typedef enum NlGameEventType {
+    NlGameEventTypeGoal,
+    NlGameEventTypeKick,
+    NlGameEventTypeSlideTackle,
+    NlGameEventTypeBallHitBorder,
+    NlGameEventTypeJoined,
+    NlGameEventTypeLeft,
+    NlGameEventTypePhaseChanged,
+} NlGameEventType;
+
+typedef struct NlGameEventGoal {
+    uint8_t scoringTeamIndex;
+    uint8_t score;
+} NlGameEventGoal;
+
+typedef struct NlGameEventKick {
+    uint8_t avatarIndex;
+    uint8_t kickPower;
+} NlGameEventKick;
+
+typedef struct NlGameEventSlideTackle {
+    uint8_t avatarIndex;
+} NlGameEventSlideTackle;
+
+typedef struct NlGameEventBallHitBorder {
+    BlVector2 position;
+} NlGameEventBallHitBorder;
+
+typedef struct NlGameEventParticipant {
+    uint8_t participantId;
+    uint8_t playerIndex;
+} NlGameEventParticipant;
+
+typedef struct NlGameEventPhaseChanged {
+    uint8_t previousPhase;
+    uint8_t phase;
+} NlGameEventPhaseChanged;
+
+typedef struct NlGameEvent {
+    uint8_t eventType;
+    union {
+        NlGameEventGoal goal;
+        NlGameEventKick kick;
+        NlGameEventSlideTackle slideTackle;
+        NlGameEventBallHitBorder ballHitBorder;
+        NlGameEventParticipant joined;
+        NlGameEventParticipant left;
+        NlGameEventPhaseChanged phaseChanged;
+    } data;
+} NlGameEvent;
+
+/// Caller-provided, fixed capacity buffer that ticks append events to. Events that do not fit are counted in
+/// `droppedCount`. Configure the library with NL_GAME_EVENTS_DISABLED=ON to compile out all event code from the
+/// simulation.
+typedef struct NlGameEvents {
+    NlGameEvent* events;
+    size_t capacity;
+    size_t count;
+    size_t droppedCount;
+} NlGameEvents;
+
+void nlGameEventsInit(NlGameEvents* self, NlGameEvent* events, size_t capacity);
+void nlGameEventsClear(NlGameEvents* self);
+
+typedef struct NlAvatarMatchStats {
+    uint8_t generation; ///< generation of the avatar in the slot the stats are for
+    uint32_t possessionTicks;
+    uint16_t kickCount;
+    uint16_t shotCount;
+    uint16_t goalCount;
+    float distanceCovered;
+} NlAvatarMatchStats;
+
+typedef struct NlTeamMatchStats {
+    uint32_t possessionTicks;
+    uint16_t kickCount;
+    uint16_t shotCount;
+    uint16_t goalCount;
+    float distanceCovered;
+} NlTeamMatchStats;
+
+/// Aggregated while playing from what the tick already computes. Not part of NlGame, so it is not included in
+/// snapshots or state comparisons. Avatar stats are per slot and start over when the slot is reused by a new avatar,
+/// read them before the avatar leaves to keep them.
+typedef struct NlMatchStats {
+    NlTeamMatchStats teams[NL_MAX_TEAMS];
+    NlAvatarMatchStats avatars[NL_MAX_PLAYERS];
+    uint32_t playedTickCount;
+    uint8_t lastTouchedAvatarIndex; ///< NL_AVATAR_INDEX_UNDEFINED until someone touched the ball
+    bool isMatchOver;
+} NlMatchStats;
+
+void nlMatchStatsInit(NlMatchStats* self);
+
+/// Optional outputs from a tick, any of the pointers can be NULL
+typedef struct NlGameTickOutput {
+    NlTickFootprint* footprint;
+    NlGameEvents* events;
+    NlMatchStats* stats; ///< only pass it for authoritative ticks, predicted ticks would be counted twice
+} NlGameTickOutput;
+
 void nlGameInit(NlGame* self);
+/// Same as nlGameInit, but for a tick duration other than NL_DEFAULT_TICK_DURATION_MS. Must match the tick
+/// duration of the simulation vm.
+void nlGameInitWithTickDuration(NlGame* self, uint16_t tickDurationMs);
+/// Initializes a game for a variant mode. Pass g_nlDefaultRuleset itself (not a copy) for the standard mode to get
+/// the specialized tick path. Registers the rules with nlRulesRegister.
+void nlGameInitWithRuleset(NlGame* self, const NlRuleset* ruleset, uint16_t tickDurationMs);
+/// The rules of the game, which must be registered in this process
+const NlRules* nlGameRules(const NlGame* self);
+/// Advances the game one tick. `log` can be NULL to suppress logging, e.g. when resimulating.
 void nlGameTick(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount, Clog* log);
+void nlGameTickWithOutput(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                          const NlGameTickOutput* output, Clog* log);
+
+/// Replaces the mispredicted inputs of a single participant by only resimulating its player and avatar.
+/// `predictedState` is the state after `tickCount` predicted ticks starting from `rollbackState`, and `footprints`
+/// are the footprints of those predicted ticks. Returns false, leaving `predictedState` untouched, if the avatar
+/// interacted with the ball in either the predicted or corrected ticks, then a full resimulation is needed.
+bool nlGameResimulateParticipant(NlGame* predictedState, const NlGame* rollbackState,
+                                 const NlTickFootprint* footprints, const NlPlayerInput* correctedInputs,
+                                 size_t tickCount, uint8_t participantId);
+/// Compact copy of the parts of NlGame that the physics-only tick uses, for bots doing lookahead search. The active
+/// avatars are packed, in slot order, to the start of `avatars.avatars`, and keep their NlGame slot in `avatarIndex`.
+typedef struct NlGameFork {
+    NlAvatars avatars;
+    NlBall ball;
+    NlTeams teams;
+    uint8_t phase;
+    uint16_t phaseCountDown;
+    uint16_t matchClockLeftInTicks;
+    uint8_t latestScoredTeamIndex;
+    const NlRules* rules; ///< resolved, forks are never serialized
+} NlGameFork;
+
+void nlGameFork(NlGameFork* self, const NlGame* game);
+/// Copies only the packed avatars, cheaper than a struct assignment when few avatars are active
+void nlGameForkCopy(NlGameFork* self, const NlGameFork* source);
+/// Physics-only tick, `inputs` has one input for each packed avatar. Skips joins, leaves, team selection, the phase
+/// count downs and logging, so it only advances while playing. For the fields in the fork it gives the same result
+/// as nlGameTick with the same in-game inputs.
+void nlGameForkTick(NlGameFork* self, const NlPlayerInGameInput* inputs);
+
+#define NL_BALL_PREDICTION_MAX_WALL_HITS (8)
+
+typedef struct NlBallPrediction {
+    NlBall ball;
+    uint32_t wallHitTicks[NL_BALL_PREDICTION_MAX_WALL_HITS]; ///< 1 is the next tick
+    size_t wallHitCount;
+    size_t exactTickCount; ///< ticks that were stepped one by one, the rest were computed in closed form
+} NlBallPrediction;
+
+/// Moves a ball that nobody touches one tick, the same way nlGameTick does. Returns true if it hit a border.
+bool nlBallTick(NlBall* ball, const NlRules* rules);
+/// Predicts where a ball that nobody touches is after `tickCount` ticks and when it hits the borders. Straight
+/// stretches are computed in closed form, only the ticks close to a border or to stopping are stepped with
+/// nlBallTick, so the cost does not depend on `tickCount`. The position matches nlBallTick within rounding errors.
+void nlBallPredict(const NlBall* ball, const NlRules* rules, uint32_t tickCount, NlBallPrediction* prediction);
+
+#define NL_DRILL_MAX_BALLS (256)
+#define NL_DRILL_GRID_COLUMNS (16)
+#define NL_DRILL_GRID_ROWS (8)
+
+/// The balls of a drill as a structure of arrays, so the moves of the balls that are clear of the borders vectorize
+typedef struct NlDrillBalls {
+    float positionX[NL_DRILL_MAX_BALLS];
+    float positionY[NL_DRILL_MAX_BALLS];
+    float velocityX[NL_DRILL_MAX_BALLS];
+    float velocityY[NL_DRILL_MAX_BALLS];
+    uint8_t collideCounter[NL_DRILL_MAX_BALLS];
+    uint16_t count;
+    float radius;
+} NlDrillBalls;
+
+/// Uniform grid over the arena with the balls sorted by cell, so an avatar only checks the balls in the cells it
+/// reaches. Rebuilt before each stage that touches the balls.
+typedef struct NlDrillBroadphase {
+    float originX;
+    float originY;
+    float inverseCellWidth;
+    float inverseCellHeight;
+    uint16_t cellStart[NL_DRILL_GRID_COLUMNS * NL_DRILL_GRID_ROWS + 1];
+    uint16_t ballIndices[NL_DRILL_MAX_BALLS];
+} NlDrillBroadphase;
+
+/// Practice and stress mode with many balls. Players and avatars live in a regular NlGame, its `ball` is unused.
+typedef struct NlDrill {
+    NlDrillBalls balls;
+    NlDrillBroadphase broadphase;
+} NlDrill;
+
+/// Spreads `ballCount` resting balls evenly over the arena of `game`
+void nlDrillInit(NlDrill* self, const NlGame* game, size_t ballCount);
+void nlDrillBall(const NlDrill* self, size_t index, NlBall* target);
+void nlDrillSetBall(NlDrill* self, size_t index, const NlBall* ball);
+/// Same as nlGameTick, but avatars dribble and kick the closest drill ball in reach. A ball that goes into a goal
+/// scores and is put back in the middle. There is no match clock.
+void nlGameTickDrill(NlGame* self, NlDrill* drill, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                     Clog* log);
+
 const NlPlayer* nlGameFindSimulationPlayerFromParticipantId(const NlGame* self, uint8_t participantId);
 
+/// Compares only the part of the input union that is used by the input type
+bool nlPlayerInputIsEqual(const NlPlayerInput* a, const NlPlayerInput* b);
+
+NlPlayerHandle nlGamePlayerHandle(const NlGame* self, uint8_t playerIndex);
+NlAvatarHandle nlGameAvatarHandle(const NlGame* self, uint8_t avatarIndex);
+const NlPlayer* nlGameResolvePlayer(const NlGame* self, NlPlayerHandle handle);
+const NlAvatar* nlGameResolveAvatar(const NlGame* self, NlAvatarHandle handle);
+
 #endif
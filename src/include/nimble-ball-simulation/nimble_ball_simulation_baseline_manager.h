@@ -0,0 +1,55 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_BASELINE_MANAGER_H
+#define NIMBLE_BALL_SIMULATION_BASELINE_MANAGER_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_BASELINE_MANAGER_CAPACITY (16)
+
+typedef struct NlBaselineEntry {
+    NlGame game;
+    uint32_t tickId;
+    uint32_t clientCount;
+    uint16_t generation;
+    bool isUsed;
+} NlBaselineEntry;
+
+/// Owned by each connection. Points to the shared baseline of the latest tick the client acknowledged.
+typedef struct NlBaselineClient {
+    uint32_t ackedTickId;
+    uint16_t entryIndex;
+    uint16_t generation;
+    bool hasBaseline;
+} NlBaselineClient;
+
+typedef struct NlBaselineManagerStats {
+    size_t storeCount;
+    size_t evictCount;
+    size_t evictedWithClientsCount;
+    size_t fallbackCount;
+} NlBaselineManagerStats;
+
+/// Keeps the states that clients can acknowledge and use as delta baselines. Each tick is stored at most once and
+/// shared by all clients that acknowledged it, so memory stays the same regardless of the number of clients.
+/// When full, the oldest state no client uses is evicted, otherwise the oldest state overall, and its clients fall
+/// back to full snapshots until they acknowledge a newer tick.
+typedef struct NlBaselineManager {
+    NlBaselineEntry entries[NL_BASELINE_MANAGER_CAPACITY];
+    NlBaselineManagerStats stats;
+} NlBaselineManager;
+
+void nlBaselineManagerInit(NlBaselineManager* self);
+/// Stores a state that has been sent to clients. Storing a tick that is already stored does nothing.
+void nlBaselineManagerStore(NlBaselineManager* self, uint32_t tickId, const NlGame* game);
+void nlBaselineClientInit(NlBaselineClient* client);
+/// The client acknowledged `tickId`. Older or unknown ticks are ignored and the current baseline is kept.
+void nlBaselineManagerAck(NlBaselineManager* self, NlBaselineClient* client, uint32_t tickId);
+/// Returns the baseline to encode the delta against, or NULL if a full snapshot must be sent.
+const NlGame* nlBaselineManagerBaseline(NlBaselineManager* self, const NlBaselineClient* client,
+                                        uint32_t* baselineTickId);
+void nlBaselineManagerRemoveClient(NlBaselineManager* self, NlBaselineClient* client);
+
+#endif
@@ -0,0 +1,71 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_CHECKPOINT_H
+#define NIMBLE_BALL_SIMULATION_CHECKPOINT_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vm.h>
+
+#define NL_CHECKPOINT_INPUT_COUNT (16) // must be a power of two
+
+typedef struct NlCheckpointTickInputs {
+    uint32_t tickId;
+    uint8_t inputCount;
+    NlPlayerInputWithParticipantInfo inputs[NL_MAX_PARTICIPANTS];
+} NlCheckpointTickInputs;
+
+/// The inputs of the latest ticks of a match, so a resumed match can continue input prediction where it left off
+typedef struct NlCheckpointInputs {
+    NlCheckpointTickInputs ticks[NL_CHECKPOINT_INPUT_COUNT];
+    uint32_t addedCount;
+} NlCheckpointInputs;
+
+void nlCheckpointInputsInit(NlCheckpointInputs* self);
+void nlCheckpointInputsAdd(NlCheckpointInputs* self, uint32_t tickId, const NlPlayerInputWithParticipantInfo* inputs,
+                           size_t inputCount);
+/// Returns the inputs `ticksAgo` ticks back, zero is the latest. Returns NULL if they were not kept.
+const NlCheckpointTickInputs* nlCheckpointInputsGet(const NlCheckpointInputs* self, size_t ticksAgo);
+
+/// Everything needed to resume a hosted match
+typedef struct NlCheckpointMatch {
+    uint64_t matchId;
+    uint32_t sequence; ///< zero for an unused slot
+    uint16_t tickDurationMs;
+    NlRuleset ruleset; ///< `game` keeps the rules id of the process that wrote it, it is bound to this on restore
+    NlGame game;
+    NlCheckpointInputs inputs;
+} NlCheckpointMatch;
+
+/// File with a fixed-size slot for each hosted match, mapped into memory. Writing a checkpoint is a copy into the
+/// mapping and a non-blocking (MS_ASYNC) request to write back the touched pages. The page cache keeps the data
+/// if the process dies, and each slot holds two checksummed copies, so a write that the machine did not finish
+/// leaves the previous checkpoint usable. Slots can be written by different threads, but one slot by one thread.
+/// Only available on Linux and macOS, nlCheckpointFileOpen fails on other platforms.
+typedef struct NlCheckpointFile {
+    uint8_t* octets;
+    size_t octetCount;
+    size_t slotCount;
+    size_t pageOctetCount;
+    int fileDescriptor;
+} NlCheckpointFile;
+
+/// Maps the file at `path`, creating it with `slotCount` empty slots if it does not exist. An existing file must
+/// have been created with the same slot count and NlGame layout. Returns zero on success.
+int nlCheckpointFileOpen(NlCheckpointFile* self, const char* path, size_t slotCount);
+/// Waits for all written checkpoints to reach the file and unmaps it
+void nlCheckpointFileClose(NlCheckpointFile* self);
+/// Stores the game of `vm` and the latest inputs in the slot. Call every few seconds of match time for each match.
+int nlCheckpointFileWrite(NlCheckpointFile* self, size_t slotIndex, uint64_t matchId, const NlSimulationVm* vm,
+                          const NlCheckpointInputs* inputs);
+/// Marks the slot as unused, e.g. when the match has ended
+void nlCheckpointFileClearSlot(NlCheckpointFile* self, size_t slotIndex);
+/// Copies the latest intact checkpoint in the slot to `target`. Returns false if the slot is unused.
+bool nlCheckpointFileRead(const NlCheckpointFile* self, size_t slotIndex, NlCheckpointMatch* target);
+
+/// Initializes `vm` with the tick duration of the checkpoint and sets its game, played with the rules of the
+/// checkpoint (nlRulesRegisterStored). Returns negative if the rules could not be registered.
+int nlCheckpointMatchRestoreVm(const NlCheckpointMatch* self, NlSimulationVm* vm, Clog log);
+
+#endif
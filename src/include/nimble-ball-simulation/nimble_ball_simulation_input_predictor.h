@@ -0,0 +1,63 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_INPUT_PREDICTOR_H
+#define NIMBLE_BALL_SIMULATION_INPUT_PREDICTOR_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_INPUT_PREDICTOR_WINDOW (32)
+
+typedef enum NlInputPredictionPolicy {
+    NlInputPredictionPolicyForced,             ///< a zeroed forced input, the avatar keeps its previous request
+    NlInputPredictionPolicyHoldLast,           ///< repeat the previous input exactly
+    NlInputPredictionPolicyDecayToNeutral,     ///< axes decay towards neutral, buttons as in ReleaseSlideTackle
+    NlInputPredictionPolicyReleaseSlideTackle, ///< hold axes and the kick button (charging), release slide tackle
+} NlInputPredictionPolicy;
+
+/// Predicts the input one tick after `previous`. Only depends on its arguments, so it can be used to fill in
+/// missing inputs deterministically.
+NlPlayerInput nlInputPredictionStep(NlInputPredictionPolicy policy, const NlPlayerInput* previous);
+
+typedef struct NlInputPrediction {
+    uint32_t tickId;
+    NlPlayerInput input;
+    bool isValid;
+} NlInputPrediction;
+
+typedef struct NlInputPredictorStats {
+    size_t predictionCount;
+    size_t confirmedCount;
+    size_t mispredictionCount;
+    size_t rollbackDepthSum;
+    size_t maxRollbackDepth;
+} NlInputPredictorStats;
+
+typedef struct NlInputPredictorParticipant {
+    NlPlayerInput lastConfirmedInput;
+    uint32_t lastConfirmedTickId;
+    uint32_t latestPredictedTickId;
+    bool hasConfirmedInput;
+    NlInputPrediction predictions[NL_INPUT_PREDICTOR_WINDOW];
+    NlInputPredictorStats stats;
+} NlInputPredictorParticipant;
+
+/// Predicts inputs for participants that have not arrived yet and keeps telemetry of how often the predictions
+/// were wrong and how deep the resulting rollbacks were. Not part of the deterministic state.
+typedef struct NlInputPredictor {
+    NlInputPredictionPolicy policy;
+    NlInputPredictorParticipant participants[NL_MAX_PARTICIPANTS];
+} NlInputPredictor;
+
+void nlInputPredictorInit(NlInputPredictor* self, NlInputPredictionPolicy policy);
+/// Returns a forced input, without keeping it, for illegal participant ids
+NlPlayerInput nlInputPredictorPredict(NlInputPredictor* self, uint8_t participantId, uint32_t tickId);
+/// Returns true if a prediction had been made for `tickId` and it was wrong, which means a rollback is needed.
+/// Inputs of illegal participant ids are ignored.
+bool nlInputPredictorConfirm(NlInputPredictor* self, uint8_t participantId, uint32_t tickId,
+                             const NlPlayerInput* actualInput);
+/// Returns zero for participants without confirmed predictions and for illegal participant ids
+float nlInputPredictorMispredictionRate(const NlInputPredictor* self, uint8_t participantId);
+
+#endif
@@ -0,0 +1,70 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_INPUT_QUEUE_H
+#define NIMBLE_BALL_SIMULATION_INPUT_QUEUE_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <transmute/transmute.h>
+
+#define NL_INPUT_QUEUE_CAPACITY (256) // must be a power of two
+#define NL_INPUT_ASSEMBLY_WINDOW (32)
+
+typedef enum NlInputQueueEntryType {
+    NlInputQueueEntryTypeInput,
+    NlInputQueueEntryTypeWaitingForReconnect,
+    NlInputQueueEntryTypeLeft,
+} NlInputQueueEntryType;
+
+typedef struct NlInputQueueEntry {
+    uint32_t tickId;
+    uint8_t participantId;
+    uint8_t entryType;
+    NlPlayerInput playerInput;
+} NlInputQueueEntry;
+
+/// Lock-free single producer, single consumer ring buffer. The producer is the network thread that receives the
+/// inputs for a match, the consumer is the thread that ticks the match.
+typedef struct NlInputQueue {
+    NlInputQueueEntry entries[NL_INPUT_QUEUE_CAPACITY];
+    volatile uint32_t writeIndex;
+    volatile uint32_t readIndex;
+    volatile uint32_t droppedCount;
+} NlInputQueue;
+
+void nlInputQueueInit(NlInputQueue* self);
+/// Producer side. Never blocks, returns false (and counts a drop) if the queue is full.
+bool nlInputQueuePush(NlInputQueue* self, const NlInputQueueEntry* entry);
+/// Consumer side. Returns false if the queue is empty.
+bool nlInputQueuePop(NlInputQueue* self, NlInputQueueEntry* entry);
+
+typedef struct NlInputAssemblyParticipant {
+    NlPlayerInput inputs[NL_INPUT_ASSEMBLY_WINDOW];
+    uint32_t tickIds[NL_INPUT_ASSEMBLY_WINDOW];
+    bool hasInput[NL_INPUT_ASSEMBLY_WINDOW];
+    bool isUsed;
+    bool isWaitingForReconnect;
+} NlInputAssemblyParticipant;
+
+typedef struct NlInputAssemblyStats {
+    size_t assembledTickCount;
+    size_t lateCount;
+    size_t tooEarlyCount;
+    size_t missingCount;
+} NlInputAssemblyStats;
+
+/// Owned by the consumer thread. Sorts the queued inputs by tick and builds the TransmuteInput for each tick.
+typedef struct NlInputAssembly {
+    NlInputAssemblyParticipant participants[NL_MAX_PARTICIPANTS];
+    TransmuteParticipantInput participantInputs[NL_MAX_PARTICIPANTS];
+    uint32_t nextTickId;
+    NlInputAssemblyStats stats;
+} NlInputAssembly;
+
+void nlInputAssemblyInit(NlInputAssembly* self, uint32_t firstTickId);
+/// Drains the queue and fills in `target` for the next tick. Participants without an input for the tick are
+/// NoInputInTime, or WaitingForReconnect. `target` points into the assembly and is valid until the next call.
+uint32_t nlInputAssemblyNextTick(NlInputAssembly* self, NlInputQueue* queue, TransmuteInput* target);
+
+#endif
@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_PUBLISHED_STATE_H
+#define NIMBLE_BALL_SIMULATION_PUBLISHED_STATE_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_PUBLISHED_STATE_BUFFER_COUNT (3)
+#define NL_PUBLISHED_STATE_WORD_COUNT ((sizeof(NlGame) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+typedef struct NlPublishedStateBuffer {
+    volatile uint32_t sequence; ///< odd while the buffer is being written
+    volatile uint32_t words[NL_PUBLISHED_STATE_WORD_COUNT];
+} NlPublishedStateBuffer;
+
+/// Triple buffered, seqlock protected copy of the latest completed tick. One writer (the thread that ticks) and any
+/// number of readers (render, spectators, snapshot encoding). The writer never waits for readers, a reader retries
+/// if the writer reused its buffer during the copy.
+typedef struct NlPublishedState {
+    NlPublishedStateBuffer buffers[NL_PUBLISHED_STATE_BUFFER_COUNT];
+    volatile uint32_t latestIndex;
+    volatile uint32_t publishCount;
+} NlPublishedState;
+
+void nlPublishedStateInit(NlPublishedState* self);
+void nlPublishedStatePublish(NlPublishedState* self, const NlGame* game);
+/// Copies the latest published state into `target`. Returns false if nothing has been published yet.
+bool nlPublishedStateRead(NlPublishedState* self, NlGame* target);
+
+#endif
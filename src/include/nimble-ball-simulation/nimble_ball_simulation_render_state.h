@@ -0,0 +1,29 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_RENDER_STATE_H
+#define NIMBLE_BALL_SIMULATION_RENDER_STATE_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_spectator.h>
+
+/// What a presentation layer needs to draw a frame between two ticks. Stored as arrays per component so all the
+/// avatar slots are interpolated in one loop.
+typedef struct NlRenderState {
+    float avatarX[NL_MAX_PLAYERS];
+    float avatarY[NL_MAX_PLAYERS];
+    float avatarRotation[NL_MAX_PLAYERS]; ///< in the range -PI to PI
+    NlSlotMask activeMask;
+    BlVector2 ballPosition;
+} NlRenderState;
+
+/// Interpolates from `from` (alpha 0) to `to` (alpha 1). The states can point directly into published or
+/// ring-buffered snapshots. Avatars that spawned or changed slot since `from` are placed where they are in `to`.
+/// Rotations take the shortest way around, like blAngleMinimalDiff.
+void nlRenderStateInterpolate(NlRenderState* self, const NlGame* from, const NlGame* to, float alpha);
+/// Same as nlRenderStateInterpolate, for the spectator projection.
+void nlRenderStateInterpolateSpectator(NlRenderState* self, const NlSpectatorState* from, const NlSpectatorState* to,
+                                       float alpha);
+
+#endif
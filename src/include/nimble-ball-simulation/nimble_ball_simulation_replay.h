@@ -0,0 +1,94 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_REPLAY_H
+#define NIMBLE_BALL_SIMULATION_REPLAY_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_REPLAY_NO_MISMATCH (0xffffffffu)
+
+typedef struct NlReplayTick {
+    uint64_t stateHash; ///< nlReplayHashGame of the game after the tick
+    uint8_t inputCount;
+    NlPlayerInputWithParticipantInfo inputs[NL_MAX_PARTICIPANTS];
+} NlReplayTick;
+
+typedef struct NlReplayKeyframe {
+    uint32_t tickIndex; ///< `game` is the state before this tick was simulated
+    NlGame game;
+} NlReplayKeyframe;
+
+/// The inputs and resulting state hash of every tick of a match, and the full game state every few seconds. The
+/// first keyframe is at tick zero, a replay with ticks always has one. The arrays are not owned by the replay.
+typedef struct NlReplay {
+    const NlReplayTick* ticks;
+    size_t tickCount;
+    const NlReplayKeyframe* keyframes;
+    size_t keyframeCount;
+    NlRulesRef rules; ///< the keyframe games are played with these, not with the rules id stored in them
+} NlReplay;
+
+/// Leaves out the rules id, which is only valid in the process that registered the rules
+uint64_t nlReplayHashGame(const NlGame* game);
+
+/// Number of octets nlReplayWrite needs for the replay
+size_t nlReplayOctetCount(const NlReplay* self);
+/// Returns the number of octets written, or negative on error. The format is only readable on the same platform
+/// and with the same NlGame layout. The ruleset and tick duration are stored with the replay.
+int nlReplayWrite(const NlReplay* self, uint8_t* target, size_t maxOctetCount);
+/// Points `target` into `octets`, which must be aligned to eight octets (e.g. allocated) and outlive the replay.
+/// Registers the rules of the replay (nlRulesRegisterStored). Returns negative if the octets are not a valid replay
+/// or the rules could not be registered.
+int nlReplayRead(NlReplay* target, const uint8_t* octets, size_t octetCount);
+
+typedef struct NlReplayRecorder {
+    NlReplayTick* ticks;
+    size_t tickCapacity;
+    size_t tickCount;
+    NlReplayKeyframe* keyframes;
+    size_t keyframeCapacity;
+    size_t keyframeCount;
+    size_t keyframeInterval;
+    NlRulesRef rules; ///< of the recorded game
+} NlReplayRecorder;
+
+/// The arrays are owned by the caller. A keyframe is stored every `keyframeInterval` ticks.
+void nlReplayRecorderInit(NlReplayRecorder* self, NlReplayTick* ticks, size_t tickCapacity,
+                          NlReplayKeyframe* keyframes, size_t keyframeCapacity, size_t keyframeInterval);
+/// Ticks `game` with the inputs and records the tick. Returns false, without ticking, if the recorder is full.
+bool nlReplayRecorderTick(NlReplayRecorder* self, NlGame* game, const NlPlayerInputWithParticipantInfo* inputs,
+                          size_t inputCount);
+void nlReplayRecorderReplay(const NlReplayRecorder* self, NlReplay* target);
+
+typedef struct NlReplaySegment {
+    uint32_t replayIndex;
+    uint32_t keyframeIndex;
+    uint32_t firstMismatchTick; ///< NL_REPLAY_NO_MISMATCH until a tick did not match its recorded hash
+} NlReplaySegment;
+
+/// Resimulates replays and compares every tick with the recorded state hash. Each keyframe starts a segment that is
+/// verified on its own, so any number of worker threads can share the segments of a few long replays
+/// (nlReplayVerifierVerifyNext). A keyframe that does not match the hash of the tick before it counts as a mismatch.
+typedef struct NlReplayVerifier {
+    const NlReplay* replays;
+    size_t replayCount;
+    NlReplaySegment* segments;
+    size_t segmentCount;
+    volatile uint32_t claimIndex;
+    volatile uint32_t verifiedTickCount;
+} NlReplayVerifier;
+
+size_t nlReplayVerifierSegmentCount(const NlReplay* replays, size_t replayCount);
+/// `segments` must hold nlReplayVerifierSegmentCount() segments. Replays and segments are owned by the caller.
+void nlReplayVerifierInit(NlReplayVerifier* self, const NlReplay* replays, size_t replayCount,
+                          NlReplaySegment* segments, size_t segmentCapacity);
+/// Worker threads. Verifies the next segment not yet claimed by another worker. Returns false when all segments
+/// have been claimed.
+bool nlReplayVerifierVerifyNext(NlReplayVerifier* self);
+/// Returns the first tick of the replay that did not match, or NL_REPLAY_NO_MISMATCH. Only valid after all workers
+/// are done.
+uint32_t nlReplayVerifierFirstMismatch(const NlReplayVerifier* self, size_t replayIndex);
+
+#endif
@@ -0,0 +1,60 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_REPLAY_ANALYTICS_H
+#define NIMBLE_BALL_SIMULATION_REPLAY_ANALYTICS_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay.h>
+
+#define NL_REPLAY_ANALYTICS_EVENT_CAPACITY (32)
+
+/// Loads the replay, e.g. by reading its file. Returns false if it could not be loaded, the replay is then skipped.
+typedef bool (*NlReplayAnalyticsLoadFn)(void* userData, size_t replayIndex, NlReplay* target);
+/// Frees what the load function allocated for the replay
+typedef void (*NlReplayAnalyticsReleaseFn)(void* userData, size_t replayIndex, NlReplay* replay);
+/// Called after every tick with the resulting game and the events of the tick
+typedef void (*NlReplayAnalyticsTickFn)(void* userData, void* workerAggregate, size_t replayIndex, uint32_t tickIndex,
+                                        const NlGame* game, const NlGameEvents* events);
+/// Called after the last tick of a replay with the match stats
+typedef void (*NlReplayAnalyticsMatchFn)(void* userData, void* workerAggregate, size_t replayIndex,
+                                         const NlGame* game, const NlMatchStats* stats);
+
+/// Only `load` is required. All callbacks are called concurrently from the worker threads.
+typedef struct NlReplayAnalyticsCallbacks {
+    NlReplayAnalyticsLoadFn load;
+    NlReplayAnalyticsReleaseFn release;
+    NlReplayAnalyticsTickFn tick;
+    NlReplayAnalyticsMatchFn match;
+    void* userData;
+} NlReplayAnalyticsCallbacks;
+
+/// Resimulates recorded matches headless from their first keyframe and hands the ticks, events and match stats to
+/// user callbacks. Worker threads claim whole replays, so only one replay per worker is loaded at a time.
+/// Callbacks reduce into the aggregate of their worker, and the caller merges the worker aggregates when all
+/// workers are done, so no locks are needed. Configure the library with NL_LOG_DISABLED=ON to compile out all logging.
+typedef struct NlReplayAnalytics {
+    NlReplayAnalyticsCallbacks callbacks;
+    size_t replayCount;
+    volatile uint32_t claimIndex;
+    volatile uint32_t skippedCount;
+} NlReplayAnalytics;
+
+/// Owned by one worker thread
+typedef struct NlReplayAnalyticsWorker {
+    NlReplayAnalytics* analytics;
+    void* aggregate;
+    uint64_t simulatedTickCount;
+    size_t matchCount;
+    NlGameEvent eventBuffer[NL_REPLAY_ANALYTICS_EVENT_CAPACITY];
+} NlReplayAnalyticsWorker;
+
+void nlReplayAnalyticsInit(NlReplayAnalytics* self, size_t replayCount, NlReplayAnalyticsCallbacks callbacks);
+/// `aggregate` is passed to the callbacks and is owned by the caller
+void nlReplayAnalyticsWorkerInit(NlReplayAnalyticsWorker* self, NlReplayAnalytics* analytics, void* aggregate);
+/// Worker threads. Loads and resimulates the next replay not yet claimed by another worker. Returns false when all
+/// replays have been claimed.
+bool nlReplayAnalyticsWorkerProcessNext(NlReplayAnalyticsWorker* self);
+
+#endif
@@ -0,0 +1,24 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_SNAPSHOT_H
+#define NIMBLE_BALL_SIMULATION_SNAPSHOT_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_SNAPSHOT_MAX_OCTET_COUNT (1 + sizeof(NlGame))
+
+typedef enum NlSnapshotType {
+    NlSnapshotTypeFull,
+    NlSnapshotTypeDelta,
+    NlSnapshotTypeSpectator, ///< see nimble_ball_simulation_spectator.h
+} NlSnapshotType;
+
+/// Encodes `game` as a delta against `baseline`, or as a full snapshot if `baseline` is NULL or the delta would not
+/// be smaller. Returns the number of octets written, or negative on error.
+int nlSnapshotEncode(const NlGame* game, const NlGame* baseline, uint8_t* target, size_t maxOctetCount);
+/// `baseline` must be the same state that was used when encoding, it is ignored for full snapshots.
+int nlSnapshotDecode(const uint8_t* octets, size_t octetCount, const NlGame* baseline, NlGame* target);
+
+#endif
@@ -0,0 +1,58 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_SNAPSHOT_FAN_OUT_H
+#define NIMBLE_BALL_SIMULATION_SNAPSHOT_FAN_OUT_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot.h>
+
+#define NL_SNAPSHOT_FAN_OUT_CAPACITY (64)
+#define NL_SNAPSHOT_FAN_OUT_MAX_VARIANTS_PER_TICK (16)
+#define NL_SNAPSHOT_NO_BASELINE (0xffffffff)
+
+/// Returns the number of octets written to `target`, or negative on error. `baseline` is NULL for full snapshots.
+typedef int (*NlSnapshotFanOutEncodeFn)(void* userData, const NlGame* game, const NlGame* baseline,
+                                        uint8_t precisionTier, uint8_t* target, size_t maxOctetCount);
+
+/// Immutable once handed out. Shared by every subscriber that asked for the same tick, baseline and precision tier.
+typedef struct NlSharedSnapshot {
+    uint32_t tickId;
+    uint32_t baselineTickId;
+    uint8_t precisionTier;
+    uint8_t octets[NL_SNAPSHOT_MAX_OCTET_COUNT];
+    int octetCount;
+    volatile uint32_t refCount;
+} NlSharedSnapshot;
+
+typedef struct NlSnapshotFanOutStats {
+    size_t acquireCount;
+    size_t encodeCount;
+    size_t exhaustedCount;
+} NlSnapshotFanOutStats;
+
+/// Encodes each tick once per distinct baseline and precision tier, instead of once per connection.
+/// Snapshots are acquired from a single thread (the one that fans out to the connections), and can be released from
+/// any thread, for example after the send has completed.
+typedef struct NlSnapshotFanOut {
+    NlSharedSnapshot snapshots[NL_SNAPSHOT_FAN_OUT_CAPACITY];
+    size_t currentIndices[NL_SNAPSHOT_FAN_OUT_MAX_VARIANTS_PER_TICK];
+    size_t currentCount;
+    uint32_t currentTickId;
+    size_t nextFreeIndex;
+    NlSnapshotFanOutEncodeFn encode;
+    void* encodeUserData;
+    NlSnapshotFanOutStats stats;
+} NlSnapshotFanOut;
+
+/// Encodes with nlSnapshotEncode (ignoring the precision tier) until another encoder is set.
+void nlSnapshotFanOutInit(NlSnapshotFanOut* self);
+void nlSnapshotFanOutSetEncoder(NlSnapshotFanOut* self, NlSnapshotFanOutEncodeFn encode, void* userData);
+/// Returns a shared snapshot with one reference held by the caller, or NULL if every snapshot is still referenced.
+/// `baseline` is NULL (and `baselineTickId` NL_SNAPSHOT_NO_BASELINE) for a full snapshot.
+const NlSharedSnapshot* nlSnapshotFanOutAcquire(NlSnapshotFanOut* self, const NlGame* game, uint32_t tickId,
+                                                const NlGame* baseline, uint32_t baselineTickId,
+                                                uint8_t precisionTier);
+void nlSharedSnapshotRelease(const NlSharedSnapshot* snapshot);
+
+#endif
@@ -0,0 +1,61 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_SNAPSHOT_PIPELINE_H
+#define NIMBLE_BALL_SIMULATION_SNAPSHOT_PIPELINE_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot.h>
+
+#define NL_SNAPSHOT_PIPELINE_CAPACITY (16) // must be a power of two
+
+/// Returns the number of octets written to `target`, or negative on error.
+typedef int (*NlSnapshotPipelineEncodeFn)(void* userData, const NlGame* game, uint32_t tickId, uint8_t* target,
+                                          size_t maxOctetCount);
+
+typedef struct NlSnapshotPipelineSlot {
+    NlGame game;
+    uint32_t tickId;
+    uint8_t octets[NL_SNAPSHOT_MAX_OCTET_COUNT];
+    int octetCount; ///< negative if the encoder failed
+    volatile uint32_t isEncoded;
+} NlSnapshotPipelineSlot;
+
+/// Moves snapshot encoding off the thread that ticks. The ticking thread submits completed states into a bounded
+/// ring, any number of worker threads encode them (nlSnapshotPipelineEncodeNext) and a single consumer, usually the
+/// network thread, takes the encoded snapshots in tick order.
+/// Submitting never waits: if the encoders or the consumer fall behind and the ring is full, the snapshot is dropped
+/// and counted. Clients recover from a dropped snapshot with the next one.
+typedef struct NlSnapshotPipeline {
+    NlSnapshotPipelineSlot slots[NL_SNAPSHOT_PIPELINE_CAPACITY];
+    volatile uint32_t submitIndex;
+    volatile uint32_t claimIndex;
+    volatile uint32_t releaseIndex;
+    volatile uint32_t submittedCount;
+    volatile uint32_t droppedCount;
+    NlSnapshotPipelineEncodeFn encode;
+    void* encodeUserData;
+} NlSnapshotPipeline;
+
+/// Encodes full snapshots until another encoder is set.
+void nlSnapshotPipelineInit(NlSnapshotPipeline* self);
+/// Must be set before any snapshot is submitted. The encoder is called concurrently from all worker threads.
+void nlSnapshotPipelineSetEncoder(NlSnapshotPipeline* self, NlSnapshotPipelineEncodeFn encode, void* userData);
+/// Ticking thread. Returns the game of the next free slot to write the state into, or NULL if the snapshot has to
+/// be dropped. The slot is handed to the encoders with nlSnapshotPipelineCommit, which must be called before the next
+/// acquire. Lets a producer that assembles or decodes a state write it straight into the ring.
+NlGame* nlSnapshotPipelineAcquire(NlSnapshotPipeline* self);
+void nlSnapshotPipelineCommit(NlSnapshotPipeline* self, uint32_t tickId);
+/// Ticking thread. Copies `game` into the ring, returns false if it was dropped. The game is ticked in place, so the
+/// state must be copied out of it somewhere; the copy is about the size of one full snapshot and far cheaper than
+/// the encode it moves off the thread.
+bool nlSnapshotPipelineSubmit(NlSnapshotPipeline* self, const NlGame* game, uint32_t tickId);
+/// Worker threads. Encodes the oldest snapshot not yet claimed by another worker. Returns false if there was nothing
+/// to encode.
+bool nlSnapshotPipelineEncodeNext(NlSnapshotPipeline* self);
+/// Consumer thread. Returns the oldest snapshot if it has been encoded, otherwise NULL. The slot is valid until
+/// nlSnapshotPipelineRelease.
+const NlSnapshotPipelineSlot* nlSnapshotPipelinePeekEncoded(NlSnapshotPipeline* self);
+void nlSnapshotPipelineRelease(NlSnapshotPipeline* self);
+
+#endif
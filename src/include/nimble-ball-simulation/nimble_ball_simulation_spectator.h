@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_SPECTATOR_H
+#define NIMBLE_BALL_SIMULATION_SPECTATOR_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_SPECTATOR_AVATAR_OCTET_COUNT (6)
+#define NL_SPECTATOR_MAX_OCTET_COUNT (12 + NL_MAX_TEAMS + NL_MAX_PLAYERS * NL_SPECTATOR_AVATAR_OCTET_COUNT)
+
+typedef enum NlSnapshotPrecisionTier {
+    NlSnapshotPrecisionTierFull,
+    NlSnapshotPrecisionTierSpectator,
+} NlSnapshotPrecisionTier;
+
+typedef struct NlSpectatorAvatar {
+    BlVector2 position;
+    float visualRotation;
+    uint8_t teamIndex;
+} NlSpectatorAvatar;
+
+/// What spectators and replay viewers need to present a tick, no cooldowns, velocities or kick power.
+typedef struct NlSpectatorState {
+    NlSpectatorAvatar avatars[NL_MAX_PLAYERS];
+    NlSlotMask activeMask; ///< visible avatars
+    BlVector2 ballPosition;
+    uint8_t scores[NL_MAX_TEAMS];
+    uint8_t phase;
+    uint16_t matchClockLeftInTicks;
+} NlSpectatorState;
+
+typedef struct NlSpectatorLod {
+    float positionPrecision; ///< world units per quantization step
+    uint16_t rotationSteps;  ///< quantization steps for a full turn, at most 256
+    uint32_t tickInterval;   ///< only every Nth tick is emitted
+} NlSpectatorLod;
+
+void nlSpectatorLodInit(NlSpectatorLod* self, float positionPrecision, uint16_t rotationSteps, uint32_t tickInterval);
+bool nlSpectatorLodShouldEmit(const NlSpectatorLod* self, uint32_t tickId);
+void nlSpectatorStateFromGame(NlSpectatorState* self, const NlGame* game);
+/// Quantizes `state` according to `lod`. Returns the number of octets written, or negative on error.
+int nlSpectatorStateEncode(const NlSpectatorLod* lod, const NlSpectatorState* state, uint8_t* target,
+                           size_t maxOctetCount);
+int nlSpectatorStateDecode(const NlSpectatorLod* lod, const uint8_t* octets, size_t octetCount,
+                           NlSpectatorState* target);
+/// NlSnapshotFanOutEncodeFn that encodes NlSnapshotPrecisionTierSpectator with the NlSpectatorLod in `userData` and
+/// NlSnapshotPrecisionTierFull with nlSnapshotEncode.
+int nlSpectatorFanOutEncode(void* userData, const NlGame* game, const NlGame* baseline, uint8_t precisionTier,
+                            uint8_t* target, size_t maxOctetCount);
+
+#endif
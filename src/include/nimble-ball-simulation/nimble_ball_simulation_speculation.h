@@ -0,0 +1,58 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_SPECULATION_H
+#define NIMBLE_BALL_SIMULATION_SPECULATION_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation_vm.h>
+
+#define NL_SPECULATION_MAX_BRANCHES (3)
+#define NL_SPECULATION_MAX_TICKS (8)
+
+typedef enum NlSpeculationHypothesis {
+    NlSpeculationHypothesisRepeatLast,
+    NlSpeculationHypothesisReleaseKick,
+    NlSpeculationHypothesisNoInput,
+} NlSpeculationHypothesis;
+
+/// One guess of what a participant will do for the next ticks, simulated ahead of time.
+/// Branches do not share any memory, so different branches can be simulated on different threads.
+typedef struct NlSpeculationBranch {
+    NlSpeculationHypothesis hypothesis;
+    NlPlayerInputWithParticipantInfo inputs[NL_MAX_PARTICIPANTS];
+    size_t inputCount;
+    NlGame states[NL_SPECULATION_MAX_TICKS];
+    size_t simulatedTickCount;
+} NlSpeculationBranch;
+
+typedef struct NlSpeculationStats {
+    size_t adoptAttemptCount;
+    size_t hitCount;
+    size_t hypothesisHitCount[NlSpeculationHypothesisNoInput + 1];
+} NlSpeculationStats;
+
+/// Small pool of speculative branches for the inputs of a single (high latency) participant
+typedef struct NlSpeculation {
+    NlSpeculationBranch branches[NL_SPECULATION_MAX_BRANCHES];
+    size_t branchCount;
+    size_t tickCount;
+    NlGame baseState;
+    NlSpeculationStats stats;
+} NlSpeculation;
+
+void nlSpeculationInit(NlSpeculation* self);
+/// Creates the branches from the current vm state. `predictedInputs` are the inputs for all participants, the entry
+/// for `participantId` is replaced by each hypothesis derived from `lastInput`.
+void nlSpeculationBegin(NlSpeculation* self, const NlSimulationVm* vm, uint8_t participantId,
+                        const NlPlayerInput* lastInput, const NlPlayerInputWithParticipantInfo* predictedInputs,
+                        size_t inputCount, size_t tickCount);
+/// Can be called concurrently for different branches
+void nlSpeculationSimulateBranch(NlSpeculation* self, size_t branchIndex);
+/// `actualInputs` holds `inputCount` inputs for each of the `tickCount` ticks that are now known. If the vm is still at
+/// the state the speculation began from and a branch simulated exactly those inputs, its state is set on the vm and
+/// true is returned. Otherwise the caller must resimulate as usual.
+bool nlSpeculationAdopt(NlSpeculation* self, NlSimulationVm* vm, const NlPlayerInputWithParticipantInfo* actualInputs,
+                        size_t inputCount, size_t tickCount);
+
+#endif
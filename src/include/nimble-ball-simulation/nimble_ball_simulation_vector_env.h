@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_VECTOR_ENV_H
+#define NIMBLE_BALL_SIMULATION_VECTOR_ENV_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+/// Per agent: horizontal axis, vertical axis, buttons (bit 0 build kick power, bit 1 slide tackle)
+#define NL_VECTOR_ENV_ACTION_SIZE (3)
+/// Ball: x, y, velocity x, velocity y
+#define NL_VECTOR_ENV_BALL_OBSERVATION_SIZE (4)
+/// Per agent: has avatar, x, y, velocity x, velocity y, rotation cos, rotation sin, team
+#define NL_VECTOR_ENV_AVATAR_OBSERVATION_SIZE (8)
+/// Goal centers (x, y) for team 0 and 1, match clock left (0-1), score for team 0 and 1, is playing
+#define NL_VECTOR_ENV_GAME_OBSERVATION_SIZE (8)
+
+/// Steps many matches at once for training bots. Agent `i` of every match is participant `i` and plays for team
+/// `i % 2`. Actions, observations, rewards and dones are contiguous, match-major tensors owned by the caller, and
+/// nothing is allocated. Positions and velocities are scaled so the arena is roughly 0-1.
+/// Ranges of matches can be stepped from different threads as long as the ranges do not overlap.
+typedef struct NlVectorEnv {
+    NlGame* games;
+    size_t matchCount;
+    size_t agentCount;
+    size_t observationSize;
+} NlVectorEnv;
+
+/// `games` must hold `matchCount` games and is owned by the caller.
+void nlVectorEnvInit(NlVectorEnv* self, NlGame* games, size_t matchCount, size_t agentCount);
+/// Starts new matches, with all the agents on the pitch and the count down skipped, and writes their observations.
+void nlVectorEnvResetRange(NlVectorEnv* self, size_t firstMatch, size_t matchCount, float* observations);
+/// Ticks each match once. `actions` is [matches][agents][NL_VECTOR_ENV_ACTION_SIZE], `observations` is
+/// [matches][observationSize], `rewards` is [matches][agents] (+1 if the agent's team scored, -1 if it conceded)
+/// and `dones` is [matches]. A match is done after a goal or when the match clock runs out, and is reset in the same
+/// step so `observations` holds the first observation of the next episode. `rewards` and `dones` can be NULL.
+void nlVectorEnvStepRange(NlVectorEnv* self, size_t firstMatch, size_t matchCount, const int8_t* actions,
+                          float* observations, float* rewards, uint8_t* dones);
+void nlVectorEnvReset(NlVectorEnv* self, float* observations);
+void nlVectorEnvStep(NlVectorEnv* self, const int8_t* actions, float* observations, float* rewards, uint8_t* dones);
+
+#endif
@@ -6,14 +6,41 @@
 #define NIMBLE_BALL_SIMULATION_VM_H
 
 #include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_input_predictor.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_published_state.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vm_cache.h>
 #include <transmute/transmute.h>
 
 typedef struct NlSimulationVm {
     TransmuteVm transmuteVm;
     NlGame game;
     Clog log;
+    NlSimulationVmCache* cache;
+    NlPublishedState* publishedState;
+    NlInputPredictionPolicy noInputInTimePolicy;
+    uint16_t tickDurationMs;
 } NlSimulationVm;
 
 void nlSimulationVmInit(NlSimulationVm* self, Clog log);
+/// Same as nlSimulationVmInit, but ticking every `tickDurationMs`. Games set on the vm must be initialized with
+/// nlGameInitWithTickDuration using the same duration.
+void nlSimulationVmInitWithTickDuration(NlSimulationVm* self, uint16_t tickDurationMs, Clog log);
+/// Ticks the game once for each of the `tickCount` inputs, without going through the transmute vm.
+/// Set `isResimulation` when the ticks have already been simulated once (e.g. rollback) to suppress logging.
+void nlSimulationVmTickMany(NlSimulationVm* self, const TransmuteInput* inputs, size_t tickCount, bool isResimulation);
+
+/// Optional resimulation cache, set to NULL to disable. Only used by nlSimulationVmTickMany when `isResimulation`
+/// is set. The cache is owned by the caller.
+void nlSimulationVmSetCache(NlSimulationVm* self, NlSimulationVmCache* cache);
+
+/// Optional destination for nlSimulationVmPublish, set to NULL to disable. Owned by the caller.
+void nlSimulationVmSetPublishedState(NlSimulationVm* self, NlPublishedState* publishedState);
+/// Publishes the current game state for readers on other threads. Called automatically after every tick of the
+/// transmute vm and at the end of nlSimulationVmTickMany when it is not a resimulation.
+void nlSimulationVmPublish(NlSimulationVm* self);
+
+/// How inputs that did not arrive in time are filled in, derived from the previous input of the player.
+/// Must be the same on all peers. Defaults to NlInputPredictionPolicyForced.
+void nlSimulationVmSetNoInputInTimePolicy(NlSimulationVm* self, NlInputPredictionPolicy policy);
 
 #endif
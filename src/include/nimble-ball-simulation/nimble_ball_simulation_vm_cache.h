@@ -0,0 +1,50 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_VM_CACHE_H
+#define NIMBLE_BALL_SIMULATION_VM_CACHE_H
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+#define NL_SIMULATION_VM_CACHE_PROBE_COUNT (4)
+
+/// Keeps the complete key, so a hash collision can never return the result of another state or other inputs
+typedef struct NlSimulationVmCacheEntry {
+    uint64_t stateHash;
+    uint64_t inputHash;
+    NlGame keyState;
+    NlPlayerInputWithParticipantInfo keyInputs[NL_MAX_PARTICIPANTS];
+    size_t keyInputCount;
+    NlGame resultState;
+    size_t insertedAt;
+    bool isUsed;
+} NlSimulationVmCacheEntry;
+
+typedef struct NlSimulationVmCacheStats {
+    size_t lookupCount;
+    size_t hitCount;
+    size_t insertCount;
+    size_t evictCount;
+} NlSimulationVmCacheStats;
+
+/// Maps (state, inputs) to the resulting state of a tick, so resimulating a tick with unchanged inputs is a lookup
+/// and a copy. The hashes select the entry, which is only a hit if the stored state and inputs are equal.
+/// Open addressed with a short probe range, when the range is full the oldest entry is replaced.
+typedef struct NlSimulationVmCache {
+    NlSimulationVmCacheEntry* entries;
+    size_t capacity;
+    NlSimulationVmCacheStats stats;
+} NlSimulationVmCache;
+
+void nlSimulationVmCacheInit(NlSimulationVmCache* self, NlSimulationVmCacheEntry* entries, size_t capacity);
+void nlSimulationVmCacheClear(NlSimulationVmCache* self);
+const NlGame* nlSimulationVmCacheFind(NlSimulationVmCache* self, uint64_t stateHash, uint64_t inputHash,
+                                      const NlGame* state, const NlPlayerInputWithParticipantInfo* inputs,
+                                      size_t inputCount);
+void nlSimulationVmCacheInsert(NlSimulationVmCache* self, uint64_t stateHash, uint64_t inputHash,
+                               const NlGame* state, const NlPlayerInputWithParticipantInfo* inputs,
+                               size_t inputCount, const NlGame* resultState);
+uint64_t nlSimulationVmCacheHash(const void* data, size_t octetCount);
+
+#endif
@@ -2,9 +2,39 @@
  *  Copyright (c) Peter Bjorklund. All rights reserved.
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
 #include <basal/line_segment.h>
 #include <basal/math.h>
+#include <math.h>
 #include <nimble-ball-simulation/nimble_ball_simulation.h>
+#include <stddef.h>
+#include <tiny-libc/tiny_libc.h>
+
+// The log is optional, it is NULL when ticks are resimulated and have already been logged once. Define
+// NL_LOG_DISABLED to compile out all logging from the simulation, e.g. for headless replay processing.
+#if defined NL_LOG_DISABLED
+#define NL_LOG_C_VERBOSE(log, ...) (void) (log);
+#define NL_LOG_C_DEBUG(log, ...) (void) (log);
+#define NL_LOG_C_INFO(log, ...) (void) (log);
+#define NL_LOG_C_NOTICE(log, ...) (void) (log);
+#else
+#define NL_LOG_C_VERBOSE(log, ...)                                                                                     \
+    if ((log) != 0) {                                                                                                  \
+        CLOG_C_VERBOSE(log, __VA_ARGS__)                                                                               \
+    }
+#define NL_LOG_C_DEBUG(log, ...)                                                                                       \
+    if ((log) != 0) {                                                                                                  \
+        CLOG_C_DEBUG(log, __VA_ARGS__)                                                                                 \
+    }
+#define NL_LOG_C_INFO(log, ...)                                                                                        \
+    if ((log) != 0) {                                                                                                  \
+        CLOG_C_INFO(log, __VA_ARGS__)                                                                                  \
+    }
+#define NL_LOG_C_NOTICE(log, ...)                                                                                      \
+    if ((log) != 0) {                                                                                                  \
+        CLOG_C_NOTICE(log, __VA_ARGS__)                                                                                \
+    }
+#endif
 
 static const float goalSize = 90;
 static const float goalDetectWidth = 40;
@@ -21,83 +51,397 @@ static const float arenaLineTop = arenaLineBottom + arenaHeight;
 static const float arenaHeightMiddle = arenaLineBottom + arenaHeight / 2;
 static const float arenaRight = arenaLeft + arenaWidth - 1;
 
-const NlConstants g_nlConstants = {
-    // Goal 0
-    0, arenaLeft - goalDetectWidth, arenaHeightMiddle - goalSize / 2, goalDetectWidth, goalSize, false,
+#define DEFAULT_MATCH_DURATION_IN_TICKS ((int) (62.5f * 60.0f))
+
+#define DEFAULT_RULESET                                                                                                \
+    {                                                                                                                  \
+        .arenaLeft = arenaLeft, .arenaBottom = arenaLineBottom, .arenaWidth = arenaWidth, .arenaHeight = arenaHeight,  \
+        .goalSize = goalSize, .goalDetectWidth = goalDetectWidth, .ballRadius = 10.0f, .avatarRadius = 20.0f,          \
+        .dribbleReachExtra = -2.0f, .dribbleDistanceFromBody = 10.0f,                                                  \
+        .matchDurationInTicks = DEFAULT_MATCH_DURATION_IN_TICKS, .countDownTicks = 62 * 3, .afterGoalTicks = 62 * 4,   \
+        .postGameTicks = 62 * 6, .kickCooldownTicks = 14, .dribbleCooldownTicks = 12, .maxKickPowerTicks = 100,        \
+        .slideTackleDurationTicks = 20, .slideTackleCooldownTicks = 40,                                                \
+    }
+
+#define DEFAULT_CONSTANTS                                                                                              \
+    {                                                                                                                  \
+        .goals = {{0,                                                                                                  \
+                   {{arenaLeft - goalDetectWidth, arenaHeightMiddle - goalSize / 2}, {goalDetectWidth, goalSize}},     \
+                   false},                                                                                             \
+                  {1,                                                                                                  \
+                   {{arenaRight - goalDetectWidth, arenaHeightMiddle - goalSize / 2}, {goalDetectWidth, goalSize}},    \
+                   true}},                                                                                             \
+        .borderSegments =                                                                                              \
+            {                                                                                                          \
+                /* lower and upper line segments */                                                                    \
+                {{arenaLeft, arenaLineBottom}, {arenaRight - goalDetectWidth, arenaLineBottom}},                       \
+                {{arenaLeft, arenaLineTop}, {arenaRight - goalDetectWidth, arenaLineTop}},                             \
+                /* upper and lower left */                                                                             \
+                {{arenaLeft, arenaLineTop}, {arenaLeft, arenaHeightMiddle + goalSize / 2}},                            \
+                {{arenaLeft, arenaLineBottom}, {arenaLeft, arenaHeightMiddle - goalSize / 2}},                         \
+                /* upper and lower right */                                                                            \
+                {{arenaRight - goalDetectWidth, arenaLineTop},                                                         \
+                 {arenaRight - goalDetectWidth, arenaHeightMiddle + goalSize / 2}},                                    \
+                {{arenaRight - goalDetectWidth, arenaLineBottom},                                                      \
+                 {arenaRight - goalDetectWidth, arenaHeightMiddle - goalSize / 2}},                                    \
+            },                                                                                                         \
+        .matchDurationInTicks = DEFAULT_MATCH_DURATION_IN_TICKS,                                                       \
+    }
+
+/// What nlTickRateInit gives for the default ruleset at NL_DEFAULT_TICK_DURATION_MS
+#define DEFAULT_TICK_RATE                                                                                              \
+    {                                                                                                                  \
+        .tickDurationMs = NL_DEFAULT_TICK_DURATION_MS, .timeScale = 1.0f, .accelerationScale = 1.0f,                   \
+        .countDownTicks = 62 * 3, .afterGoalTicks = 62 * 4, .postGameTicks = 62 * 6,                                   \
+        .matchDurationInTicks = DEFAULT_MATCH_DURATION_IN_TICKS, .kickCooldownTicks = 14, .dribbleCooldownTicks = 12,  \
+        .maxKickPowerTicks = 100, .slideTackleDurationTicks = 20, .slideTackleCooldownTicks = 40,                      \
+        .ballDamping = 0.988f, .avatarDamping = 0.98f, .dribblePull = 0.2f, .rotationFollow = 0.1f,                    \
+    }
+
+const NlRuleset g_nlDefaultRuleset = DEFAULT_RULESET;
+
+const NlConstants g_nlConstants = DEFAULT_CONSTANTS;
+
+/// The rules of a game initialized with the default ruleset and tick duration. The tick functions are given a
+/// pointer to this instead of resolving the rules of the game, so the compiler can fold the values into the code.
+static const NlRules g_defaultRules = {DEFAULT_RULESET, DEFAULT_CONSTANTS, DEFAULT_TICK_RATE};
+
+/// Rules of the games that are not played with the default rules, an id is the index plus one. Registered rules never
+/// change, so they are found and resolved without the lock, it is only taken to append.
+typedef struct NlRulesRegistry {
+    NlRules rules[NL_MAX_REGISTERED_RULES];
+    volatile uint32_t count;
+    volatile uint32_t lock;
+} NlRulesRegistry;
+
+static NlRulesRegistry g_rulesRegistry;
+
+void nlConstantsInit(NlConstants* self, const NlRuleset* ruleset)
+{
+    float left = ruleset->arenaLeft;
+    float right = ruleset->arenaLeft + ruleset->arenaWidth - 1;
+    float bottom = ruleset->arenaBottom;
+    float top = ruleset->arenaBottom + ruleset->arenaHeight;
+    float middle = ruleset->arenaBottom + ruleset->arenaHeight / 2;
+    float detectWidth = ruleset->goalDetectWidth;
+    float goalHalfSize = ruleset->goalSize / 2;
+    float goalLineRight = right - detectWidth;
+
+    for (size_t i = 0; i < 2; ++i) {
+        NlGoal* goal = &self->goals[i];
+        goal->ownedByTeam = (int) i;
+        goal->rect.position.x = i == 0 ? left - detectWidth : goalLineRight;
+        goal->rect.position.y = middle - goalHalfSize;
+        goal->rect.size.x = detectWidth;
+        goal->rect.size.y = ruleset->goalSize;
+        goal->facingLeft = i == 1;
+    }
+
+    const BlLineSegment borderSegments[6] = {
+        {{left, bottom}, {goalLineRight, bottom}},                      // lower line segment
+        {{left, top}, {goalLineRight, top}},                            // upper line segment
+        {{left, top}, {left, middle + goalHalfSize}},                   // upper left
+        {{left, bottom}, {left, middle - goalHalfSize}},                // lower left
+        {{goalLineRight, top}, {goalLineRight, middle + goalHalfSize}}, // upper right
+        {{goalLineRight, bottom}, {goalLineRight, middle - goalHalfSize}},
+    };
+    for (size_t i = 0; i < 6; ++i) {
+        self->borderSegments[i] = borderSegments[i];
+    }
+
+    self->matchDurationInTicks = ruleset->matchDurationInTicks;
+}
+
+/// Converts a number of ticks at NL_DEFAULT_TICK_DURATION_MS to the same time at `tickDurationMs`
+static uint32_t scaleTicks(uint32_t ticksAtDefault, uint16_t tickDurationMs)
+{
+    uint32_t ticks = (ticksAtDefault * NL_DEFAULT_TICK_DURATION_MS + tickDurationMs / 2u) / tickDurationMs;
+    return ticks == 0 ? 1 : ticks;
+}
+
+/// Short tick durations need more ticks for the same time, more than a field can hold is clamped
+static uint32_t scaleTicksClamped(uint32_t ticksAtDefault, uint16_t tickDurationMs, uint32_t maxTicks)
+{
+    uint32_t ticks = scaleTicks(ticksAtDefault, tickDurationMs);
+    if (ticks > maxTicks) {
+        CLOG_SOFT_ERROR("%u ticks at %hu ms do not fit in %u ticks, clamped", ticksAtDefault, tickDurationMs, maxTicks)
+        return maxTicks;
+    }
+    return ticks;
+}
+
+static uint16_t scaleTicksUint16(uint16_t ticksAtDefault, uint16_t tickDurationMs)
+{
+    return (uint16_t) scaleTicksClamped(ticksAtDefault, tickDurationMs, UINT16_MAX);
+}
+
+static uint8_t scaleTicksUint8(uint8_t ticksAtDefault, uint16_t tickDurationMs)
+{
+    return (uint8_t) scaleTicksClamped(ticksAtDefault, tickDurationMs, UINT8_MAX);
+}
+
+/// Converts a fraction that is applied each tick (damping, smoothing) to the same effect per second
+static float scalePerTickFactor(float factorAtDefault, float timeScale)
+{
+    if (timeScale == 1.0f) {
+        return factorAtDefault;
+    }
+    return powf(factorAtDefault, timeScale);
+}
+
+void nlTickRateInit(NlTickRate* self, const NlRuleset* ruleset, uint16_t tickDurationMs)
+{
+    CLOG_ASSERT(tickDurationMs >= NL_MIN_TICK_DURATION_MS && tickDurationMs <= NL_MAX_TICK_DURATION_MS,
+                "unsupported tick duration %hu ms", tickDurationMs)
+
+    self->tickDurationMs = tickDurationMs;
+    self->timeScale = (float) tickDurationMs / (float) NL_DEFAULT_TICK_DURATION_MS;
+    self->accelerationScale = self->timeScale * self->timeScale;
+
+    self->countDownTicks = scaleTicksUint16(ruleset->countDownTicks, tickDurationMs);
+    self->afterGoalTicks = scaleTicksUint16(ruleset->afterGoalTicks, tickDurationMs);
+    self->postGameTicks = scaleTicksUint16(ruleset->postGameTicks, tickDurationMs);
+    self->matchDurationInTicks = scaleTicksUint16(ruleset->matchDurationInTicks, tickDurationMs);
+    self->kickCooldownTicks = scaleTicksUint8(ruleset->kickCooldownTicks, tickDurationMs);
+    self->dribbleCooldownTicks = scaleTicksUint8(ruleset->dribbleCooldownTicks, tickDurationMs);
+    self->maxKickPowerTicks = scaleTicksUint8(ruleset->maxKickPowerTicks, tickDurationMs);
+    self->slideTackleDurationTicks = scaleTicksUint8(ruleset->slideTackleDurationTicks, tickDurationMs);
+    self->slideTackleCooldownTicks = scaleTicksUint8(ruleset->slideTackleCooldownTicks, tickDurationMs);
+
+    self->ballDamping = scalePerTickFactor(0.988f, self->timeScale);
+    self->avatarDamping = scalePerTickFactor(0.98f, self->timeScale);
+    // Fractions of the remaining distance that are covered each tick
+    self->dribblePull = 1.0f - scalePerTickFactor(0.8f, self->timeScale);
+    self->rotationFollow = 1.0f - scalePerTickFactor(0.9f, self->timeScale);
+    if (self->timeScale == 1.0f) {
+        self->dribblePull = 0.2f;
+        self->rotationFollow = 0.1f;
+    }
+}
+
+void nlRulesInit(NlRules* self, const NlRuleset* ruleset, uint16_t tickDurationMs)
+{
+    self->ruleset = *ruleset;
+    nlConstantsInit(&self->constants, ruleset);
+    nlTickRateInit(&self->tickRate, ruleset, tickDurationMs);
+}
 
-    // Goal 1
-    1, arenaRight - goalDetectWidth, arenaHeightMiddle - goalSize / 2, goalDetectWidth, goalSize, true,
+/// The ruleset has no padding before its last field, so the fields can be compared as octets
+static bool isSameRuleset(const NlRuleset* a, const NlRuleset* b)
+{
+    return tc_memcmp(a, b, offsetof(NlRuleset, slideTackleCooldownTicks) + sizeof(a->slideTackleCooldownTicks)) == 0;
+}
+
+static uint8_t findRegisteredRules(const NlRuleset* ruleset, uint16_t tickDurationMs, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        const NlRules* rules = &g_rulesRegistry.rules[i];
+        if (rules->tickRate.tickDurationMs == tickDurationMs && isSameRuleset(&rules->ruleset, ruleset)) {
+            return (uint8_t) (i + 1);
+        }
+    }
+
+    return NL_INVALID_RULES_ID;
+}
+
+NlRulesRef nlRulesRegister(const NlRuleset* ruleset, uint16_t tickDurationMs)
+{
+    NlRulesRef ref;
+    ref.isDefault = ruleset == &g_nlDefaultRuleset && tickDurationMs == NL_DEFAULT_TICK_DURATION_MS;
+    ref.id = NL_DEFAULT_RULES_ID;
+    if (ref.isDefault) {
+        return ref;
+    }
+
+    ref.id = findRegisteredRules(ruleset, tickDurationMs, nlAtomicLoadAcquire(&g_rulesRegistry.count));
+    if (ref.id != NL_INVALID_RULES_ID) {
+        return ref;
+    }
+
+    while (!nlAtomicCompareExchange(&g_rulesRegistry.lock, 0, 1)) {
+    }
+    // Another thread can have registered the same rules since the search above
+    uint32_t count = nlAtomicLoadRelaxed(&g_rulesRegistry.count);
+    ref.id = findRegisteredRules(ruleset, tickDurationMs, count);
+    if (ref.id == NL_INVALID_RULES_ID && count < NL_MAX_REGISTERED_RULES) {
+        nlRulesInit(&g_rulesRegistry.rules[count], ruleset, tickDurationMs);
+        nlAtomicStoreRelease(&g_rulesRegistry.count, count + 1);
+        ref.id = (uint8_t) (count + 1);
+    }
+    nlAtomicStoreRelease(&g_rulesRegistry.lock, 0);
 
-    arenaLeft, arenaLineBottom, arenaRight - goalDetectWidth,
-    arenaLineBottom, // lower line segment
+    if (ref.id == NL_INVALID_RULES_ID) {
+        CLOG_SOFT_ERROR("can not register more than %d rules", NL_MAX_REGISTERED_RULES)
+    }
 
-    arenaLeft, arenaLineTop, arenaRight - goalDetectWidth,
-    arenaLineTop, // upper line segment
+    return ref;
+}
 
-    arenaLeft, arenaLineTop, arenaLeft,
-    arenaHeightMiddle + goalSize / 2, // upper left
+NlRulesRef nlRulesRegisterStored(const NlRuleset* ruleset, uint16_t tickDurationMs)
+{
+    if (isSameRuleset(ruleset, &g_nlDefaultRuleset)) {
+        ruleset = &g_nlDefaultRuleset;
+    }
 
-    arenaLeft, arenaLineBottom, arenaLeft,
-    arenaHeightMiddle - goalSize / 2, // lower left
+    return nlRulesRegister(ruleset, tickDurationMs);
+}
 
-    arenaRight - goalDetectWidth, arenaLineTop, arenaRight - goalDetectWidth,
-    arenaHeightMiddle + goalSize / 2, // upper right
+const NlRules* nlRulesResolve(NlRulesRef ref)
+{
+    if (ref.isDefault) {
+        return &g_defaultRules;
+    }
+    if (ref.id == NL_DEFAULT_RULES_ID || ref.id > nlAtomicLoadAcquire(&g_rulesRegistry.count)) {
+        return 0;
+    }
 
-    arenaRight - goalDetectWidth, arenaLineBottom, arenaRight - goalDetectWidth,
-    arenaHeightMiddle - goalSize / 2, //
+    return &g_rulesRegistry.rules[ref.id - 1];
+}
 
-    (int) (62.5f * 60.0f), // matchDuration
-};
+const NlRules* nlGameRules(const NlGame* self)
+{
+    const NlRules* rules = nlRulesResolve(self->rules);
+    CLOG_ASSERT(rules != 0, "the rules %d of the game are not registered", self->rules.id)
 
-#define SLIDE_TACKLE_DURATION (20)
-#define SLIDE_TACKLE_COOLDOWN (40)
+    return rules;
+}
 
-static void resetBallToMiddlePosition(NlBall* ball)
+static void resetBallToMiddlePosition(NlBall* ball, const NlRules* rules)
 {
-    ball->circle.center.x = arenaWidth / 2;
-    ball->circle.center.y = arenaHeight / 2;
+    ball->circle.center.x = rules->ruleset.arenaWidth / 2;
+    ball->circle.center.y = rules->ruleset.arenaHeight / 2;
     ball->velocity = blVector2Zero();
     ball->collideCounter = 0;
 }
 
+static bool isSlotActive(NlSlotMask activeMask, size_t index)
+{
+    return (activeMask & (1u << index)) != 0;
+}
+
+static size_t findFreeSlot(NlSlotMask activeMask)
+{
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(activeMask, i)) {
+            return i;
+        }
+    }
+
+    return NL_MAX_PLAYERS;
+}
+
+static uint8_t nextGeneration(uint8_t generation)
+{
+    // Generation zero is never used for an active slot, so a cleared handle is always stale
+    generation++;
+    return generation == 0 ? 1 : generation;
+}
+
+void nlGameEventsInit(NlGameEvents* self, NlGameEvent* events, size_t capacity)
+{
+    self->events = events;
+    self->capacity = capacity;
+    self->count = 0;
+    self->droppedCount = 0;
+}
+
+void nlGameEventsClear(NlGameEvents* self)
+{
+    self->count = 0;
+    self->droppedCount = 0;
+}
+
+/// Returns NULL if events are not requested (or compiled out) or the buffer is full
+static NlGameEvent* addEvent(NlGameEvents* events, NlGameEventType eventType)
+{
+#if defined NL_GAME_EVENTS_DISABLED
+    (void) events;
+    (void) eventType;
+    return 0;
+#else
+    if (events == 0) {
+        return 0;
+    }
+    if (events->count == events->capacity) {
+        events->droppedCount++;
+        return 0;
+    }
+
+    NlGameEvent* event = &events->events[events->count++];
+    event->eventType = (uint8_t) eventType;
+
+    return event;
+#endif
+}
+
 void nlGameInit(NlGame* self)
 {
+    nlGameInitWithTickDuration(self, NL_DEFAULT_TICK_DURATION_MS);
+}
+
+void nlGameInitWithTickDuration(NlGame* self, uint16_t tickDurationMs)
+{
+    nlGameInitWithRuleset(self, &g_nlDefaultRuleset, tickDurationMs);
+}
+
+void nlGameInitWithRuleset(NlGame* self, const NlRuleset* ruleset, uint16_t tickDurationMs)
+{
+    // Unused slots and padding are cleared, so equal games have equal octets (hashing, delta compression)
+    tc_mem_clear_type(self);
+
+    self->rules = nlRulesRegister(ruleset, tickDurationMs);
+    const NlRules* rules = nlRulesResolve(self->rules);
+    if (rules == 0) {
+        CLOG_ERROR("the game has no rules")
+        return;
+    }
+
     self->phase = NlGamePhaseWaitingForPlayers;
     self->players.playerCount = 0;
+    self->players.activeMask = 0;
     self->avatars.avatarCount = 0;
+    self->avatars.activeMask = 0;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        self->players.players[i].generation = 0;
+        self->avatars.avatars[i].generation = 0;
+    }
 
     for (size_t i = 0; i < NL_MAX_PARTICIPANTS; ++i) {
         self->participantLookup[i].isUsed = false;
     }
     self->lastParticipantLookupCount = 0;
 
-    self->ball.circle.radius = 10.0f;
-    resetBallToMiddlePosition(&self->ball);
+    self->ball.circle.radius = rules->ruleset.ballRadius;
+    resetBallToMiddlePosition(&self->ball, rules);
 
-    self->ball.velocity.x = 2.0f;
-    self->ball.velocity.y = 1.6f;
+    self->ball.velocity.x = 2.0f * rules->tickRate.timeScale;
+    self->ball.velocity.y = 1.6f * rules->tickRate.timeScale;
 
     self->teams.teamCount = 2;
     self->teams.teams[0].score = 0;
     self->teams.teams[1].score = 1;
 
     self->tickCount = 0;
-    self->matchClockLeftInTicks = g_nlConstants.matchDurationInTicks;
+    self->matchClockLeftInTicks = rules->tickRate.matchDurationInTicks;
     self->latestScoredTeamIndex = 0xff;
 }
 
-static NlAvatar* spawnAvatarForPlayer(NlAvatars* self, NlPlayer* player, BlVector2 spawnPosition)
+static NlAvatar* spawnAvatarForPlayer(NlAvatars* self, NlPlayer* player, BlVector2 spawnPosition, float radius)
 {
     if (player->preferredTeamId != 0 && player->preferredTeamId != 1) {
         CLOG_ERROR("test")
     }
-    size_t avatarIndex = self->avatarCount++;
-    CLOG_ASSERT(self->avatarCount <= NL_MAX_PLAYERS, "Wrong avatar count")
+    size_t avatarIndex = findFreeSlot(self->activeMask);
+    CLOG_ASSERT(avatarIndex < NL_MAX_PLAYERS, "Wrong avatar count")
+    self->activeMask |= (NlSlotMask) (1u << avatarIndex);
+    self->avatarCount++;
 
     NlAvatar* avatar = &self->avatars[avatarIndex];
     avatar->avatarIndex = (uint8_t) avatarIndex;
+    avatar->generation = nextGeneration(avatar->generation);
     avatar->circle.center = spawnPosition;
-    avatar->circle.radius = 20.0f;
+    avatar->circle.radius = radius;
     avatar->controlledByPlayerIndex = player->playerIndex;
     avatar->kickCooldown = 0u;
     avatar->dribbleCooldown = 0u;
@@ -121,19 +465,24 @@ static NlAvatar* spawnAvatarForPlayer(NlAvatars* self, NlPlayer* player, BlVecto
 
 static void spawnAvatarsForPlayers(NlGame* self, Clog* log)
 {
-    for (size_t playerIndex = 0u; playerIndex < self->players.playerCount; ++playerIndex) {
+    for (size_t playerIndex = 0u; playerIndex < NL_MAX_PLAYERS; ++playerIndex) {
+        if (!isSlotActive(self->players.activeMask, playerIndex)) {
+            continue;
+        }
         NlPlayer* player = &self->players.players[playerIndex];
         if (player->preferredTeamId == NL_TEAM_UNDEFINED) {
             continue;
         }
 
-        BlVector2 spawnPosition = {player->preferredTeamId == 1 ? arenaWidth - goalDetectWidth - 20.0f
-                                                                : goalDetectWidth + 40.0f,
-                                   (float) ((float) playerIndex * 40.0f + goalDetectWidth + 20.0f)};
+        const NlRuleset* ruleset = &nlGameRules(self)->ruleset;
+        BlVector2 spawnPosition = {player->preferredTeamId == 1
+                                       ? ruleset->arenaWidth - ruleset->goalDetectWidth - 20.0f
+                                       : ruleset->goalDetectWidth + 40.0f,
+                                   (float) ((float) playerIndex * 40.0f + ruleset->goalDetectWidth + 20.0f)};
 
-        NlAvatar* avatar = spawnAvatarForPlayer(&self->avatars, player, spawnPosition);
-#if defined CLOG_LOG_ENABLED
-        CLOG_C_DEBUG(log, "spawning avatar %hhu for player %zu (participant %d)", avatar->avatarIndex, playerIndex,
+        NlAvatar* avatar = spawnAvatarForPlayer(&self->avatars, player, spawnPosition, ruleset->avatarRadius);
+#if defined CLOG_LOG_ENABLED && !defined NL_LOG_DISABLED
+        NL_LOG_C_DEBUG(log, "spawning avatar %hhu for player %zu (participant %d)", avatar->avatarIndex, playerIndex,
                      player->assignedToParticipantIndex)
 #else
         (void) log;
@@ -143,25 +492,84 @@ static void spawnAvatarsForPlayers(NlGame* self, Clog* log)
     }
 }
 
-static int collideAgainstBorders(BlCircle* circle, BlVector2* velocity, float* biggestDepth, float safeDistance,
-                                 float dampening)
+/// Distance along the ray `origin + direction * s` until a circle of `radius` would touch the segment, or -1
+static double sweepCircleAgainstSegment(BlVector2 origin, BlVector2 direction, double radius, BlLineSegment segment)
+{
+    double ox = origin.x;
+    double oy = origin.y;
+    double dx = direction.x;
+    double dy = direction.y;
+    double ax = segment.a.x;
+    double ay = segment.a.y;
+    double ex = segment.b.x - segment.a.x;
+    double ey = segment.b.y - segment.a.y;
+    double length = sqrt(ex * ex + ey * ey);
+    double best = -1.0;
+
+    if (length > 0.0) {
+        // The sides of the capsule
+        double nx = -ey / length;
+        double ny = ex / length;
+        double height = (ox - ax) * nx + (oy - ay) * ny;
+        double rate = dx * nx + dy * ny;
+        if (fabs(height) <= radius) {
+            double along = ((ox - ax) * ex + (oy - ay) * ey) / length;
+            if (along >= 0.0 && along <= length) {
+                return 0.0;
+            }
+        } else if (rate != 0.0 && (height > 0.0) != (rate > 0.0)) {
+            double s = (fabs(height) - radius) / fabs(rate);
+            double along = ((ox + dx * s - ax) * ex + (oy + dy * s - ay) * ey) / length;
+            if (along >= 0.0 && along <= length) {
+                best = s;
+            }
+        }
+    }
+
+    // The rounded ends of the capsule
+    for (size_t i = 0; i < 2; ++i) {
+        double cx = i == 0 ? ax : ax + ex;
+        double cy = i == 0 ? ay : ay + ey;
+        double fx = ox - cx;
+        double fy = oy - cy;
+        double b = fx * dx + fy * dy;
+        double c = fx * fx + fy * fy - radius * radius;
+        if (c <= 0.0) {
+            return 0.0;
+        }
+        double discriminant = b * b - c;
+        if (b >= 0.0 || discriminant < 0.0) {
+            continue;
+        }
+        double s = -b - sqrt(discriminant);
+        if (best < 0.0 || s < best) {
+            best = s;
+        }
+    }
+
+    return best;
+}
+
+/// `biggestImpact` is set to the highest speed towards a border that was hit, not to the overlap depth
+static int collideAgainstBorders(const NlConstants* constants, BlCircle* circle, BlVector2* velocity,
+                                 float* biggestImpact, float safeDistance, float dampening)
 {
     BlCircle circleCheck = *circle;
     circleCheck.radius = circle->radius + safeDistance;
-    *biggestDepth = 0;
+    *biggestImpact = 0;
 
     int collisionCount = 0;
 
-    for (size_t i = 0; i < sizeof(g_nlConstants.borderSegments) / sizeof(g_nlConstants.borderSegments[0]); ++i) {
-        BlLineSegment lineSegmentToCheck = g_nlConstants.borderSegments[i];
+    for (size_t i = 0; i < sizeof(constants->borderSegments) / sizeof(constants->borderSegments[0]); ++i) {
+        BlLineSegment lineSegmentToCheck = constants->borderSegments[i];
         BlCollision collision = blLineSegmentCircleIntersect(lineSegmentToCheck, circleCheck);
         if (collision.depth > 0) {
             float reflectDot = blVector2Dot(*velocity, collision.normal);
             *velocity = blVector2Scale(blVector2Reflect(*velocity, collision.normal), dampening);
             circle->center = blVector2AddScale(circle->center, collision.normal, collision.depth + 0.1f);
             float impact = blFabs(reflectDot);
-            if (impact > *biggestDepth) {
-                *biggestDepth = impact;
+            if (impact > *biggestImpact) {
+                *biggestImpact = impact;
             }
             collisionCount++;
         }
@@ -172,7 +580,10 @@ static int collideAgainstBorders(BlCircle* circle, BlVector2* velocity, float* b
 
 static bool atLeastOnePlayerHasCommittedToATeam(const NlPlayers* players)
 {
-    for (size_t i = 0; i < players->playerCount; ++i) {
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(players->activeMask, i)) {
+            continue;
+        }
         const NlPlayer* player = &players->players[i];
         if (player->phase == NlPlayerPhaseCommittedToTeam) {
             return true;
@@ -185,35 +596,42 @@ static bool atLeastOnePlayerHasCommittedToATeam(const NlPlayers* players)
 static void tickWaitingForPlayers(NlGame* self, Clog* log)
 {
     if (self->players.playerCount > 0 && atLeastOnePlayerHasCommittedToATeam(&self->players)) {
-        CLOG_C_DEBUG(log, "start count down")
+        NL_LOG_C_DEBUG(log, "start count down")
         self->phase = NlGamePhaseCountDown;
-        self->phaseCountDown = 62 * 3;
+        self->phaseCountDown = nlGameRules(self)->tickRate.countDownTicks;
         spawnAvatarsForPlayers(self, log);
     }
 }
 
-static void removePlayer(NlParticipant* participants, NlPlayers* self, size_t indexToRemove)
+static void removePlayer(NlPlayers* self, size_t indexToRemove)
 {
-    self->players[indexToRemove] = self->players[--self->playerCount];
-    participants[self->players[indexToRemove].assignedToParticipantIndex].playerIndex = (uint8_t) indexToRemove;
+    CLOG_ASSERT(isSlotActive(self->activeMask, indexToRemove), "player index is corrupt")
+    self->activeMask &= (NlSlotMask) ~(1u << indexToRemove);
+    self->playerCount--;
 }
 
 static void despawnAvatar(NlPlayers* players, NlAvatars* avatars, size_t indexToRemove)
 {
-    CLOG_ASSERT(indexToRemove < avatars->avatarCount, "avatar index is corrupt")
+    CLOG_ASSERT(isSlotActive(avatars->activeMask, indexToRemove), "avatar index is corrupt")
     NlAvatar* avatarToRemove = &avatars->avatars[indexToRemove];
-    if (avatarToRemove->controlledByPlayerIndex != 0xff) {
-        players->players[avatarToRemove->controlledByPlayerIndex].controllingAvatarIndex = 0xff;
+    if (avatarToRemove->controlledByPlayerIndex != NL_PLAYER_INDEX_UNDEFINED) {
+        players->players[avatarToRemove->controlledByPlayerIndex].controllingAvatarIndex = NL_AVATAR_INDEX_UNDEFINED;
     }
 
-    avatars->avatars[indexToRemove] = avatars->avatars[--avatars->avatarCount];
+    avatars->activeMask &= (NlSlotMask) ~(1u << indexToRemove);
+    avatars->avatarCount--;
 }
 
 static NlPlayer* spawnPlayer(NlPlayers* players, uint8_t participantId)
 {
-    size_t playerIndex = players->playerCount++;
+    size_t playerIndex = findFreeSlot(players->activeMask);
+    CLOG_ASSERT(playerIndex < NL_MAX_PLAYERS, "Wrong player count")
+    players->activeMask |= (NlSlotMask) (1u << playerIndex);
+    players->playerCount++;
+
     NlPlayer* assignedPlayer = &players->players[playerIndex];
     assignedPlayer->playerIndex = (uint8_t) playerIndex;
+    assignedPlayer->generation = nextGeneration(assignedPlayer->generation);
     assignedPlayer->assignedToParticipantIndex = participantId;
     assignedPlayer->controllingAvatarIndex = NL_AVATAR_INDEX_UNDEFINED;
     assignedPlayer->preferredTeamId = NL_TEAM_UNDEFINED;
@@ -223,7 +641,10 @@ static NlPlayer* spawnPlayer(NlPlayers* players, uint8_t participantId)
 
 const NlPlayer* nlGameFindSimulationPlayerFromParticipantId(const NlGame* self, uint8_t participantId)
 {
-    for (size_t i = 0; i < self->players.playerCount; ++i) {
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(self->players.activeMask, i)) {
+            continue;
+        }
         const NlPlayer* simulationPlayer = &self->players.players[i];
         if (simulationPlayer->assignedToParticipantIndex == participantId) {
             return simulationPlayer;
@@ -232,12 +653,70 @@ const NlPlayer* nlGameFindSimulationPlayerFromParticipantId(const NlGame* self,
     return 0;
 }
 
+bool nlPlayerInputIsEqual(const NlPlayerInput* a, const NlPlayerInput* b)
+{
+    if (a->inputType != b->inputType) {
+        return false;
+    }
+
+    switch (a->inputType) {
+        case NlPlayerInputTypeInGame:
+            return a->input.inGameInput.horizontalAxis == b->input.inGameInput.horizontalAxis &&
+                   a->input.inGameInput.verticalAxis == b->input.inGameInput.verticalAxis &&
+                   a->input.inGameInput.buttons == b->input.inGameInput.buttons;
+        case NlPlayerInputTypeSelectTeam:
+            return a->input.selectTeam.preferredTeamToJoin == b->input.selectTeam.preferredTeamToJoin;
+        default:
+            return true;
+    }
+}
+
+NlPlayerHandle nlGamePlayerHandle(const NlGame* self, uint8_t playerIndex)
+{
+    NlPlayerHandle handle;
+    handle.index = playerIndex;
+    handle.generation = 0;
+    if (playerIndex < NL_MAX_PLAYERS && isSlotActive(self->players.activeMask, playerIndex)) {
+        handle.generation = self->players.players[playerIndex].generation;
+    }
+    return handle;
+}
+
+NlAvatarHandle nlGameAvatarHandle(const NlGame* self, uint8_t avatarIndex)
+{
+    NlAvatarHandle handle;
+    handle.index = avatarIndex;
+    handle.generation = 0;
+    if (avatarIndex < NL_MAX_PLAYERS && isSlotActive(self->avatars.activeMask, avatarIndex)) {
+        handle.generation = self->avatars.avatars[avatarIndex].generation;
+    }
+    return handle;
+}
+
+const NlPlayer* nlGameResolvePlayer(const NlGame* self, NlPlayerHandle handle)
+{
+    if (handle.index >= NL_MAX_PLAYERS || !isSlotActive(self->players.activeMask, handle.index)) {
+        return 0;
+    }
+    const NlPlayer* player = &self->players.players[handle.index];
+    return player->generation == handle.generation ? player : 0;
+}
+
+const NlAvatar* nlGameResolveAvatar(const NlGame* self, NlAvatarHandle handle)
+{
+    if (handle.index >= NL_MAX_PLAYERS || !isSlotActive(self->avatars.activeMask, handle.index)) {
+        return 0;
+    }
+    const NlAvatar* avatar = &self->avatars.avatars[handle.index];
+    return avatar->generation == handle.generation ? avatar : 0;
+}
+
 static NlPlayer* participantJoined(NlPlayers* players, NlParticipant* participant, Clog* log)
 {
     (void) log;
 
     NlPlayer* player = spawnPlayer(players, participant->participantId);
-    CLOG_C_INFO(log, "participant has joined. player count is %hhu. created player %d for participant %d",
+    NL_LOG_C_INFO(log, "participant has joined. player count is %hhu. created player %d for participant %d",
                 players->playerCount, player->playerIndex, participant->participantId)
 
     participant->playerIndex = player->playerIndex;
@@ -246,11 +725,11 @@ static NlPlayer* participantJoined(NlPlayers* players, NlParticipant* participan
     return player;
 }
 
-static BlVector2 findGoodSpawnPosition(NlPlayer* player)
+static BlVector2 findGoodSpawnPosition(NlPlayer* player, const NlRuleset* ruleset)
 {
-    BlVector2 spawnPosition = {player->preferredTeamId == 1 ? arenaWidth - goalDetectWidth - 20.0f
-                                                            : goalDetectWidth + 40.0f,
-                               (float) ((float) player->playerIndex * 40.0f + goalDetectWidth + 20.0f)};
+    BlVector2 spawnPosition = {player->preferredTeamId == 1 ? ruleset->arenaWidth - ruleset->goalDetectWidth - 20.0f
+                                                            : ruleset->goalDetectWidth + 40.0f,
+                               (float) ((float) player->playerIndex * 40.0f + ruleset->goalDetectWidth + 20.0f)};
     return spawnPosition;
 }
 
@@ -266,8 +745,7 @@ static void gameRulesForJoiningPlayer(NlGame* game, NlPlayer* player)
     player->phase = NlPlayerPhaseSelectTeam;
 }
 
-static void participantLeft(NlPlayers* players, NlAvatars* avatars, NlParticipant* participants,
-                            NlParticipant* participant, Clog* log)
+static void participantLeft(NlPlayers* players, NlAvatars* avatars, NlParticipant* participant, Clog* log)
 {
     (void) log;
     NlPlayer* assignedPlayer = &players->players[participant->playerIndex];
@@ -276,9 +754,9 @@ static void participantLeft(NlPlayers* players, NlAvatars* avatars, NlParticipan
         despawnAvatar(players, avatars, (size_t) assignedAvatarIndex);
     }
 
-    removePlayer(participants, players, participant->playerIndex);
+    removePlayer(players, participant->playerIndex);
 
-    CLOG_C_INFO(log, "someone has left releasing player %hhu previously assigned to participant %d",
+    NL_LOG_C_INFO(log, "someone has left releasing player %hhu previously assigned to participant %d",
                 participant->playerIndex, participant->participantId)
 
     participant->isUsed = false;
@@ -286,15 +764,17 @@ static void participantLeft(NlPlayers* players, NlAvatars* avatars, NlParticipan
 
 static void spawnAtFreePosition(NlGame* game, NlPlayer* player)
 {
-    BlVector2 spawnPosition = findGoodSpawnPosition(player);
+    const NlRuleset* ruleset = &nlGameRules(game)->ruleset;
+    BlVector2 spawnPosition = findGoodSpawnPosition(player, ruleset);
 
-    spawnAvatarForPlayer(&game->avatars, player, spawnPosition);
+    spawnAvatarForPlayer(&game->avatars, player, spawnPosition, ruleset->avatarRadius);
 }
 
-static void checkInputDiff(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount, Clog* log)
+static void checkInputDiff(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                           NlGameEvents* events, Clog* log)
 {
     if (inputCount != self->lastParticipantLookupCount) {
-        CLOG_C_INFO(log, "a participant has either been added or removed, count is different. was %hhu and is now %zu",
+        NL_LOG_C_INFO(log, "a participant has either been added or removed, count is different. was %hhu and is now %zu",
                     self->lastParticipantLookupCount, inputCount)
     }
 
@@ -309,6 +789,11 @@ static void checkInputDiff(NlGame* self, const NlPlayerInputWithParticipantInfo*
             participant->participantId = inputs[i].participantId;
             NlPlayer* player = participantJoined(&self->players, participant, log);
             gameRulesForJoiningPlayer(self, player);
+            NlGameEvent* event = addEvent(events, NlGameEventTypeJoined);
+            if (event != 0) {
+                event->data.joined.participantId = participant->participantId;
+                event->data.joined.playerIndex = player->playerIndex;
+            }
         }
         if (participant->playerIndex != 0xff) {
             self->players.players[participant->playerIndex].playerInput = inputs[i].playerInput;
@@ -320,7 +805,12 @@ static void checkInputDiff(NlGame* self, const NlPlayerInputWithParticipantInfo*
         NlParticipant* participant = &self->participantLookup[i];
         if (participant->isUsed && !participant->internalMarked) {
             // An active participants that is no longer in the provided inputs must be removed
-            participantLeft(&self->players, &self->avatars, self->participantLookup, participant, log);
+            NlGameEvent* event = addEvent(events, NlGameEventTypeLeft);
+            if (event != 0) {
+                event->data.left.participantId = participant->participantId;
+                event->data.left.playerIndex = participant->playerIndex;
+            }
+            participantLeft(&self->players, &self->avatars, participant, log);
         }
     }
 
@@ -338,58 +828,271 @@ static void tickCountDown(NlGame* self)
 
 #define MINIMAL_VELOCITY (0.1f)
 
-static void tickBall(NlBall* ball)
+#define BALL_BORDER_DAMPENING (0.91f)
+#define BALL_MAX_SWEEP_BOUNCES (4)
+
+static BlVector2 closestPointOnSegment(BlLineSegment segment, BlVector2 point)
+{
+    BlVector2 edge = blVector2Sub(segment.b, segment.a);
+    float squareLength = blVector2SquareLength(edge);
+    if (squareLength == 0.0f) {
+        return segment.a;
+    }
+    float t = blVector2Dot(blVector2Sub(point, segment.a), edge) / squareLength;
+    if (t < 0.0f) {
+        t = 0.0f;
+    } else if (t > 1.0f) {
+        t = 1.0f;
+    }
+
+    return blVector2AddScale(segment.a, edge, t);
+}
+
+/// Moves the ball along its velocity, bouncing on the borders at the time of impact instead of after the move. A
+/// fast ball can otherwise pass through a border in a single tick, which limits how long a tick can be.
+static int sweepBallAgainstBorders(const NlConstants* constants, BlCircle* circle, BlVector2* velocity,
+                                   float* biggestImpact, float dampening)
 {
-    ball->velocity = blVector2Scale(ball->velocity, 0.988f);
+    int collisionCount = 0;
+    float travel = blVector2Length(*velocity);
+
+    for (size_t bounce = 0; bounce < BALL_MAX_SWEEP_BOUNCES && travel > 0.0f; ++bounce) {
+        BlVector2 direction = blVector2Unit(*velocity);
+        double nearest = -1.0;
+        size_t nearestIndex = 0;
+        for (size_t i = 0; i < sizeof(constants->borderSegments) / sizeof(constants->borderSegments[0]); ++i) {
+            // Already overlapping borders are resolved by collideAgainstBorders after the move
+            double s = sweepCircleAgainstSegment(circle->center, direction, circle->radius,
+                                                 constants->borderSegments[i]);
+            if (s > 0.0 && (nearest < 0.0 || s < nearest)) {
+                nearest = s;
+                nearestIndex = i;
+            }
+        }
+
+        if (nearest < 0.0 || nearest >= travel) {
+            circle->center = bounce == 0 ? blVector2Add(circle->center, *velocity)
+                                         : blVector2AddScale(circle->center, direction, travel);
+            return collisionCount;
+        }
+
+        // Stop just short of the border, so the overlap check after the move does not reflect the ball back again
+        float toImpact = (float) nearest - 0.1f;
+        if (toImpact < 0.0f) {
+            toImpact = 0.0f;
+        }
+        circle->center = blVector2AddScale(circle->center, direction, toImpact);
+        BlVector2 contact = closestPointOnSegment(constants->borderSegments[nearestIndex], circle->center);
+        BlVector2 normal = blVector2Unit(blVector2Sub(circle->center, contact));
+
+        float impact = blFabs(blVector2Dot(*velocity, normal));
+        if (impact > *biggestImpact) {
+            *biggestImpact = impact;
+        }
+        *velocity = blVector2Scale(blVector2Reflect(*velocity, normal), dampening);
+        travel = (travel - toImpact) * dampening;
+        collisionCount++;
+    }
 
-    ball->circle.center = blVector2Add(ball->circle.center, ball->velocity);
+    return collisionCount;
+}
+
+/// Returns true if the ball collided with the borders
+static bool tickBall(NlBall* ball, const NlRules* rules)
+{
+    ball->velocity = blVector2Scale(ball->velocity, rules->tickRate.ballDamping);
+
+    // The borders are segments without thickness. A ball that moves at most its radius can not get its center past
+    // a border in one tick, so it keeps the original move and resolve, which replays and checkpoints depend on.
+    float biggestImpact = 0.0f;
+    int collided = 0;
+    if (blVector2Length(ball->velocity) > ball->circle.radius) {
+        collided = sweepBallAgainstBorders(&rules->constants, &ball->circle, &ball->velocity, &biggestImpact,
+                                           BALL_BORDER_DAMPENING);
+    } else {
+        ball->circle.center = blVector2Add(ball->circle.center, ball->velocity);
+    }
 
-    float biggestDepth;
-    int collided = collideAgainstBorders(&ball->circle, &ball->velocity, &biggestDepth, 0.f, 0.91f);
+    float overlapImpact;
+    collided += collideAgainstBorders(&rules->constants, &ball->circle, &ball->velocity, &overlapImpact, 0.f,
+                                      BALL_BORDER_DAMPENING);
+    if (overlapImpact > biggestImpact) {
+        biggestImpact = overlapImpact;
+    }
     if (collided > 0) {
-        if (biggestDepth > 0.8f && blVector2Length(ball->velocity) > 0.7f) {
+        float timeScale = rules->tickRate.timeScale;
+        if (biggestImpact > 0.8f * timeScale && blVector2Length(ball->velocity) > 0.7f * timeScale) {
             ball->collideCounter++;
         }
     }
-    if (blVector2SquareLength(ball->velocity) < MINIMAL_VELOCITY) {
+    if (blVector2SquareLength(ball->velocity) < MINIMAL_VELOCITY * rules->tickRate.accelerationScale) {
         ball->velocity = blVector2Zero();
     }
+
+    return collided > 0;
+}
+
+bool nlBallTick(NlBall* ball, const NlRules* rules)
+{
+    return tickBall(ball, rules);
+}
+
+// Extra distance added to the ball radius when looking for the next border hit, so the predictor always switches to
+// exact stepping before the hit, even with rounding errors in the closed form
+#define BALL_PREDICTION_MARGIN (1.0)
+
+/// Ticks until the ball first gets close to a border, assuming it travels in a straight line. 0 if never.
+static uint32_t ticksUntilNearBorder(const NlConstants* constants, const NlBall* ball, double speed, double damping)
+{
+    BlVector2 direction = blVector2Scale(ball->velocity, (float) (1.0 / speed));
+    double radius = ball->circle.radius + BALL_PREDICTION_MARGIN;
+    double nearest = -1.0;
+
+    for (size_t i = 0; i < sizeof(constants->borderSegments) / sizeof(constants->borderSegments[0]); ++i) {
+        double s = sweepCircleAgainstSegment(ball->circle.center, direction, radius, constants->borderSegments[i]);
+        if (s >= 0.0 && (nearest < 0.0 || s < nearest)) {
+            nearest = s;
+        }
+    }
+    if (nearest < 0.0) {
+        return 0;
+    }
+
+    // Distance after n ticks is speed * d * (1 - d^n) / (1 - d)
+    double remaining = 1.0 - nearest * (1.0 - damping) / (speed * damping);
+    if (remaining <= 0.0) {
+        return 0;
+    }
+    double ticks = ceil(log(remaining) / log(damping));
+
+    return ticks < 1.0 ? 1 : (uint32_t) ticks;
+}
+
+/// The tick that sets the velocity to zero (tickBall checks the speed after moving)
+static uint32_t ticksUntilStop(double speed, const NlRules* rules)
+{
+    double minimalSpeed = sqrt(MINIMAL_VELOCITY * rules->tickRate.accelerationScale);
+    double ticks = floor(log(minimalSpeed / speed) / log(rules->tickRate.ballDamping)) + 1.0;
+
+    return ticks < 1.0 ? 1 : (uint32_t) ticks;
+}
+
+static void advanceBallWithoutBorders(NlBall* ball, double damping, uint32_t tickCount)
+{
+    double dampingPower = pow(damping, (double) tickCount);
+    double distanceFactor = damping * (1.0 - dampingPower) / (1.0 - damping);
+
+    ball->circle.center.x = (float) (ball->circle.center.x + ball->velocity.x * distanceFactor);
+    ball->circle.center.y = (float) (ball->circle.center.y + ball->velocity.y * distanceFactor);
+    ball->velocity.x = (float) (ball->velocity.x * dampingPower);
+    ball->velocity.y = (float) (ball->velocity.y * dampingPower);
+}
+
+void nlBallPredict(const NlBall* ball, const NlRules* rules, uint32_t tickCount, NlBallPrediction* prediction)
+{
+    NlBall predicted = *ball;
+    uint32_t tick = 0;
+
+    prediction->wallHitCount = 0;
+    prediction->exactTickCount = 0;
+
+    while (tick < tickCount) {
+        double speed = blVector2Length(predicted.velocity);
+        if (speed == 0.0) {
+            break;
+        }
+
+        // Skip ahead in closed form, stopping short of the next border hit and of the tick the ball stops
+        uint32_t skipCount = tickCount - tick;
+        uint32_t nearBorderTicks = ticksUntilNearBorder(&rules->constants, &predicted, speed,
+                                                         rules->tickRate.ballDamping);
+        if (nearBorderTicks != 0 && nearBorderTicks - 1 < skipCount) {
+            skipCount = nearBorderTicks - 1;
+        }
+        uint32_t stopTicks = ticksUntilStop(speed, rules);
+        uint32_t beforeStop = stopTicks > 2 ? stopTicks - 2 : 0;
+        if (beforeStop < skipCount) {
+            skipCount = beforeStop;
+        }
+
+        if (skipCount > 0) {
+            advanceBallWithoutBorders(&predicted, rules->tickRate.ballDamping, skipCount);
+            tick += skipCount;
+            continue;
+        }
+
+        tick++;
+        prediction->exactTickCount++;
+        if (tickBall(&predicted, rules) && prediction->wallHitCount < NL_BALL_PREDICTION_MAX_WALL_HITS) {
+            prediction->wallHitTicks[prediction->wallHitCount++] = tick;
+        }
+    }
+
+    prediction->ball = predicted;
 }
+
 static bool isAllowedToJoinWithAvatar(NlGamePhase gamePhase)
 {
     return gamePhase == NlGamePhaseCountDown || gamePhase == NlGamePhaseAfterAGoal;
 }
 
-static void playerToAvatarControl(NlGame* game, NlPlayers* players, NlAvatars* avatars)
+static void inGameInputToAvatar(const NlPlayerInGameInput* inGameInput, NlAvatar* avatar)
+{
+    avatar->isInvisible = false;
+    BlVector2 requestVelocity;
+    requestVelocity.x = inGameInput->horizontalAxis;
+    requestVelocity.y = inGameInput->verticalAxis;
+    avatar->requestedVelocity = blVector2Scale(requestVelocity, 0.4f);
+    avatar->requestBuildKickPower = inGameInput->buttons & 0x01;
+    avatar->requestSlideTackle = inGameInput->buttons & 0x02;
+}
+
+/// Applies the player input that only affects the player and its avatar. `avatar` is NULL if the player has none.
+static void playerInputToAvatar(NlPlayer* player, NlAvatar* avatar)
+{
+    switch (player->playerInput.inputType) {
+        case NlPlayerInputTypeInGame: {
+            player->isWaitingForReconnect = false;
+
+            if (avatar == 0) {
+                return;
+            }
+            inGameInputToAvatar(&player->playerInput.input.inGameInput, avatar);
+        } break;
+        case NlPlayerInputTypeForced:
+            // Do nothing
+            break;
+        case NlPlayerInputTypeWaitingForReconnect:
+            if (avatar != 0) {
+                avatar->isInvisible = true;
+            }
+            player->isWaitingForReconnect = true;
+            break;
+    }
+}
+
+static void playerToAvatarControl(NlGame* game, NlPlayers* players, NlAvatars* avatars, Clog* log)
 {
-    for (size_t i = 0; i < players->playerCount; ++i) {
+    (void) log;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(players->activeMask, i)) {
+            continue;
+        }
         NlPlayer* player = &players->players[i];
 
-        switch (player->playerInput.inputType) {
-            case NlPlayerInputTypeInGame: {
-                player->isWaitingForReconnect = false;
+        NlAvatar* avatar = player->controllingAvatarIndex == NL_AVATAR_INDEX_UNDEFINED
+                               ? 0
+                               : &avatars->avatars[player->controllingAvatarIndex];
 
-                if (player->controllingAvatarIndex == NL_AVATAR_INDEX_UNDEFINED) {
-                    continue;
-                }
-                const NlPlayerInGameInput* inGameInput = &player->playerInput.input.inGameInput;
-                NlAvatar* avatar = &avatars->avatars[player->controllingAvatarIndex];
-                avatar->isInvisible = false;
-                BlVector2 requestVelocity;
-                requestVelocity.x = inGameInput->horizontalAxis;
-                requestVelocity.y = inGameInput->verticalAxis;
-                avatar->requestedVelocity = blVector2Scale(requestVelocity, 0.4f);
-                avatar->requestBuildKickPower = inGameInput->buttons & 0x01;
-                avatar->requestSlideTackle = inGameInput->buttons & 0x02;
-
-            } break;
+        switch (player->playerInput.inputType) {
             case NlPlayerInputTypeSelectTeam: {
                 if (player->phase == NlPlayerPhaseSelectTeam) {
                     NlPlayerSelectTeam* selectTeamInput = &player->playerInput.input.selectTeam;
-                    CLOG_INFO("player selected team %d", selectTeamInput->preferredTeamToJoin)
+                    NL_LOG_C_INFO(log, "player selected team %d", selectTeamInput->preferredTeamToJoin)
 
                     if (player->preferredTeamId != selectTeamInput->preferredTeamToJoin) {
-                        CLOG_NOTICE("player made a choice %d", selectTeamInput->preferredTeamToJoin)
+                        NL_LOG_C_NOTICE(log, "player made a choice %d", selectTeamInput->preferredTeamToJoin)
                     }
                     player->preferredTeamId = selectTeamInput->preferredTeamToJoin;
                     player->phase = NlPlayerPhaseCommittedToTeam;
@@ -402,122 +1105,180 @@ static void playerToAvatarControl(NlGame* game, NlPlayers* players, NlAvatars* a
                 }
                 break;
             }
-            case NlPlayerInputTypeForced:
-                // Do nothing
-                break;
-            case NlPlayerInputTypeWaitingForReconnect:
-                if (player->controllingAvatarIndex != NL_AVATAR_INDEX_UNDEFINED) {
-                    NlAvatar* avatar = &avatars->avatars[player->controllingAvatarIndex];
-                    avatar->isInvisible = true;
-                }
-                player->isWaitingForReconnect = true;
+            default:
+                playerInputToAvatar(player, avatar);
                 break;
         }
     }
 }
 
-static void tickAvatars(NlAvatars* avatars)
+/// Returns true if the avatar collided with the borders
+static bool tickAvatar(NlAvatar* avatar, const NlRules* rules)
 {
-    for (size_t i = 0; i < avatars->avatarCount; ++i) {
-        NlAvatar* avatar = &avatars->avatars[i];
-
-        if (avatar->slideTackleRemainingTicks > 0) {
-            BlVector2 slideUnitDirection = blVector2FromAngle(avatar->slideTackleRotation);
-            float normalizedDuration = (float) avatar->slideTackleRemainingTicks / (float) SLIDE_TACKLE_DURATION;
-            float slideFactor = normalizedDuration * normalizedDuration * 0.8f;
-            avatar->velocity = blVector2AddScale(avatar->velocity, slideUnitDirection, slideFactor);
-        } else {
-            float speedFactor = avatar->kickPower > 0 ? 0.05f : 0.2f;
-            if (avatar->slideTackleCooldown > 0) {
-                speedFactor *= 0.5f;
-            }
-
-            avatar->velocity = blVector2AddScale(avatar->velocity, avatar->requestedVelocity, speedFactor);
+    if (avatar->slideTackleRemainingTicks > 0) {
+        BlVector2 slideUnitDirection = blVector2FromAngle(avatar->slideTackleRotation);
+        float normalizedDuration = (float) avatar->slideTackleRemainingTicks /
+                                   (float) rules->tickRate.slideTackleDurationTicks;
+        float slideFactor = normalizedDuration * normalizedDuration * 0.8f * rules->tickRate.accelerationScale;
+        avatar->velocity = blVector2AddScale(avatar->velocity, slideUnitDirection, slideFactor);
+    } else {
+        float speedFactor = avatar->kickPower > 0 ? 0.05f : 0.2f;
+        if (avatar->slideTackleCooldown > 0) {
+            speedFactor *= 0.5f;
         }
+        speedFactor *= rules->tickRate.accelerationScale;
 
-        const float maxAvatarSpeed = 60.0f;
-        if (blVector2SquareLength(avatar->velocity) > maxAvatarSpeed * maxAvatarSpeed) {
-            avatar->velocity = blVector2Scale(blVector2Unit(avatar->velocity), maxAvatarSpeed);
+        avatar->velocity = blVector2AddScale(avatar->velocity, avatar->requestedVelocity, speedFactor);
+    }
+
+    const float maxAvatarSpeed = 60.0f * rules->tickRate.timeScale;
+    if (blVector2SquareLength(avatar->velocity) > maxAvatarSpeed * maxAvatarSpeed) {
+        avatar->velocity = blVector2Scale(blVector2Unit(avatar->velocity), maxAvatarSpeed);
+    }
+    avatar->velocity = blVector2Scale(avatar->velocity, rules->tickRate.avatarDamping);
+    avatar->circle.center = blVector2Add(avatar->circle.center, avatar->velocity);
+    float length = blVector2SquareLength(avatar->requestedVelocity);
+    if (length > 0.001f) {
+        float target = blVector2ToAngle(avatar->requestedVelocity);
+        float angleDiff = blAngleMinimalDiff(target, avatar->visualRotation);
+        avatar->visualRotation += angleDiff * rules->tickRate.rotationFollow;
+    }
+
+    float biggestImpact;
+    return collideAgainstBorders(&rules->constants, &avatar->circle, &avatar->velocity, &biggestImpact, 10.0f, 0) > 0;
+}
+
+static void tickAvatars(NlAvatars* avatars, const NlRules* rules, NlTickFootprint* footprint,
+                        NlMatchStats* stats)
+{
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
+            continue;
         }
-        avatar->velocity = blVector2Scale(avatar->velocity, 0.98f);
-        avatar->circle.center = blVector2Add(avatar->circle.center, avatar->velocity);
-        float length = blVector2SquareLength(avatar->requestedVelocity);
-        if (length > 0.001f) {
-            float target = blVector2ToAngle(avatar->requestedVelocity);
-            float angleDiff = blAngleMinimalDiff(target, avatar->visualRotation);
-            avatar->visualRotation += angleDiff * 0.1f;
+        NlAvatar* avatar = &avatars->avatars[i];
+        BlVector2 positionBefore = avatar->circle.center;
+        if (tickAvatar(avatar, rules)) {
+            footprint->borderHitMask |= (NlSlotMask) (1u << i);
         }
+        if (stats != 0) {
+            float distance = blVector2Length(blVector2Sub(avatar->circle.center, positionBefore));
+            stats->avatars[i].distanceCovered += distance;
+            stats->teams[avatar->teamIndex].distanceCovered += distance;
+        }
+    }
+}
 
-        float biggestDepth;
-        collideAgainstBorders(&avatar->circle, &avatar->velocity, &biggestDepth, 10.0f, 0);
+static bool isBallInDribbleReach(const NlAvatar* avatar, const BlCircle* ballCircle, const NlRules* rules)
+{
+    BlCircle dribbleReach = avatar->circle;
+    dribbleReach.radius = avatar->circle.radius + rules->ruleset.dribbleReachExtra;
+    return blCircleOverlap(dribbleReach, *ballCircle);
+}
+
+/// Returns true if the ball was in reach and got dribbled
+static bool dribbleBall(const NlAvatar* avatar, NlBall* ball, const NlRules* rules)
+{
+    if (!isBallInDribbleReach(avatar, &ball->circle, rules)) {
+        return false;
     }
+
+    BlVector2 avatarDirection = blVector2FromAngle(avatar->visualRotation);
+    BlVector2 targetDribblePosition = blVector2AddScale(avatar->circle.center, avatarDirection,
+                                                        rules->ruleset.dribbleDistanceFromBody);
+    BlVector2 diffFromTargetDribblePosition = blVector2Sub(targetDribblePosition, ball->circle.center);
+    ball->circle.center = blVector2AddScale(ball->circle.center, diffFromTargetDribblePosition,
+                                            rules->tickRate.dribblePull);
+    ball->velocity = blVector2Add(avatar->velocity, blVector2Scale(avatarDirection, 2.0f * rules->tickRate.timeScale));
+
+    return true;
 }
 
-#define DRIBBLE_REACH_EXTRA (-2.0f)
-#define DRIBBLE_DISTANCE_FROM_BODY (10.0f)
+/// Returns true if the avatar touched the ball
+static bool tickAvatarDribble(NlAvatar* avatar, NlBall* ball, const NlRules* rules)
+{
+    if (avatar->dribbleCooldown > 0) {
+        avatar->dribbleCooldown--;
+        return false;
+    }
+
+    return dribbleBall(avatar, ball, rules);
+}
 
-static void tickDribble(NlAvatars* avatars, NlBall* ball)
+static void tickDribble(NlAvatars* avatars, NlBall* ball, const NlRules* rules, NlTickFootprint* footprint)
 {
-    for (size_t i = 0; i < avatars->avatarCount; ++i) {
-        NlAvatar* avatar = &avatars->avatars[i];
-        if (avatar->dribbleCooldown > 0) {
-            avatar->dribbleCooldown--;
+    footprint->ballBeforeDribble = *ball;
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
             continue;
         }
-        BlCircle dribbleReach = avatar->circle;
-        dribbleReach.radius = avatar->circle.radius + DRIBBLE_REACH_EXTRA;
-        if (blCircleOverlap(dribbleReach, ball->circle)) {
-            BlVector2 avatarDirection = blVector2FromAngle(avatar->visualRotation);
-            BlVector2 targetDribblePosition = blVector2AddScale(avatar->circle.center, avatarDirection,
-                                                                DRIBBLE_DISTANCE_FROM_BODY);
-            BlVector2 diffFromTargetDribblePosition = blVector2Sub(targetDribblePosition, ball->circle.center);
-            ball->circle.center = blVector2AddScale(ball->circle.center, diffFromTargetDribblePosition, 0.2f);
-            ball->velocity = blVector2Add(avatar->velocity, blVector2Scale(avatarDirection, 2.0f));
+        if (tickAvatarDribble(&avatars->avatars[i], ball, rules)) {
+            footprint->dribbleTouchedMask |= (NlSlotMask) (1u << i);
         }
     }
 }
 
-#define MAX_KICK_POWER_TICKS (100)
-
-static void performKick(NlAvatar* avatar, NlBall* ball, uint8_t kickPowerTicks)
+static bool performKick(NlAvatar* avatar, NlBall* ball, uint8_t kickPowerTicks, const NlRules* rules)
 {
     BlCircle increasedReach = avatar->circle;
     increasedReach.radius = avatar->circle.radius * 2.0f;
 
     if (!blCircleOverlap(increasedReach, ball->circle)) {
         // Ball was not close, the avatar kicked air
-        return;
+        return false;
     }
     BlVector2 avatarDirection = blVector2FromAngle(avatar->visualRotation);
-    float normalizedKickPower = (float) kickPowerTicks / MAX_KICK_POWER_TICKS;
-    BlVector2 kickVelocity = blVector2Scale(avatarDirection, normalizedKickPower * 10.0f + 1.0f);
+    float normalizedKickPower = (float) kickPowerTicks / (float) rules->tickRate.maxKickPowerTicks;
+    float kickSpeed = (normalizedKickPower * 10.0f + 1.0f) * rules->tickRate.timeScale;
+    BlVector2 kickVelocity = blVector2Scale(avatarDirection, kickSpeed);
     ball->velocity = blVector2Add(avatar->velocity, kickVelocity);
-    float biggestDepth;
-    collideAgainstBorders(&ball->circle, &ball->velocity, &biggestDepth, 0.f, 0.9f);
-    avatar->kickCooldown = 14;
-    avatar->dribbleCooldown = 12;
+    float biggestImpact;
+    collideAgainstBorders(&rules->constants, &ball->circle, &ball->velocity, &biggestImpact, 0.f, 0.9f);
+    avatar->kickCooldown = rules->tickRate.kickCooldownTicks;
+    avatar->dribbleCooldown = rules->tickRate.dribbleCooldownTicks;
     avatar->kickedCounter++;
+
+    return true;
 }
 
-static bool checkGoal(const NlGoal* goal, const NlBall* ball, NlTeams* teams, uint8_t* latestTeamToScore)
+/// Checks if the ball center crossed the goal line between the goal posts during the tick. Catches fast balls that
+/// passed all the way through the goal rect, since there is no border behind the goals.
+static bool sweptBallCrossedGoalLine(const NlGoal* goal, const NlBall* ball, BlVector2 ballStartPosition)
 {
-    BlCollision collision = blRectCircleIntersect(goal->rect, ball->circle);
-    if (fabsf(collision.depth) < 0.001f) {
+    BlVector2 end = ball->circle.center;
+    float lineX = goal->facingLeft ? goal->rect.position.x + ball->circle.radius
+                                   : goal->rect.position.x + goal->rect.size.x - ball->circle.radius;
+    bool crossed = goal->facingLeft ? (ballStartPosition.x <= lineX && end.x > lineX)
+                                    : (ballStartPosition.x >= lineX && end.x < lineX);
+    if (!crossed) {
         return false;
     }
 
+    float t = (lineX - ballStartPosition.x) / (end.x - ballStartPosition.x);
+    float crossingY = ballStartPosition.y + (end.y - ballStartPosition.y) * t;
+
+    return crossingY >= goal->rect.position.y && crossingY <= goal->rect.position.y + goal->rect.size.y;
+}
+
+static bool checkGoal(const NlGoal* goal, const NlBall* ball, BlVector2 ballStartPosition, NlTeams* teams,
+                      uint8_t* latestTeamToScore, Clog* log)
+{
+    (void) log;
+
     bool isGoal = false;
-    if (goal->facingLeft) {
-        isGoal = (ball->circle.center.x - ball->circle.radius > goal->rect.position.x);
-    } else {
-        isGoal = (ball->circle.center.x + ball->circle.radius < goal->rect.position.x + goal->rect.size.x);
+    BlCollision collision = blRectCircleIntersect(goal->rect, ball->circle);
+    if (fabsf(collision.depth) >= 0.001f) {
+        if (goal->facingLeft) {
+            isGoal = (ball->circle.center.x - ball->circle.radius > goal->rect.position.x);
+        } else {
+            isGoal = (ball->circle.center.x + ball->circle.radius < goal->rect.position.x + goal->rect.size.x);
+        }
     }
 
-    if (!isGoal) {
+    if (!isGoal && !sweptBallCrossedGoalLine(goal, ball, ballStartPosition)) {
         return false;
     }
 
-    CLOG_VERBOSE("GOAL! for %d", goal->ownedByTeam)
+    NL_LOG_C_VERBOSE(log, "GOAL! for %d", goal->ownedByTeam)
 
     int opposingTeam = goal->ownedByTeam == 0 ? 1 : 0;
     teams->teams[opposingTeam].score++;
@@ -525,101 +1286,285 @@ static bool checkGoal(const NlGoal* goal, const NlBall* ball, NlTeams* teams, ui
     return true;
 }
 
-static bool checkGoals(const NlGoal* goals, size_t goalCount, const NlBall* ball, NlTeams* teams,
-                       uint8_t* latestScoredTeamIndex)
+static bool checkGoals(const NlGoal* goals, size_t goalCount, const NlBall* ball, BlVector2 ballStartPosition,
+                       NlTeams* teams, uint8_t* latestScoredTeamIndex, NlGameEvents* events, Clog* log)
 {
     bool someoneScored = false;
     for (size_t i = 0; i < goalCount; ++i) {
         const NlGoal* goal = &goals[i];
-        someoneScored |= checkGoal(goal, ball, teams, latestScoredTeamIndex);
+        if (!checkGoal(goal, ball, ballStartPosition, teams, latestScoredTeamIndex, log)) {
+            continue;
+        }
+        someoneScored = true;
+        NlGameEvent* event = addEvent(events, NlGameEventTypeGoal);
+        if (event != 0) {
+            event->data.goal.scoringTeamIndex = *latestScoredTeamIndex;
+            event->data.goal.score = teams->teams[*latestScoredTeamIndex].score;
+        }
     }
 
     return someoneScored;
 }
 
-static void tickGoalCheck(NlTeams* teams, NlBall* ball, uint8_t* phase, uint16_t* phaseCountDown,
-                          uint8_t* latestScoredTeamIndex)
+static void tickGoalCheck(NlTeams* teams, NlBall* ball, BlVector2 ballStartPosition, uint8_t* phase,
+                          uint16_t* phaseCountDown, uint8_t* latestScoredTeamIndex, const NlRules* rules,
+                          NlGameEvents* events, Clog* log)
 {
-    bool someoneScored = checkGoals(g_nlConstants.goals, 2, ball, teams, latestScoredTeamIndex);
+    bool someoneScored = checkGoals(rules->constants.goals, 2, ball, ballStartPosition, teams, latestScoredTeamIndex,
+                                    events, log);
     if (!someoneScored) {
         return;
     }
 
     *phase = NlGamePhaseAfterAGoal;
-    *phaseCountDown = 62 * 4;
+    *phaseCountDown = rules->tickRate.afterGoalTicks;
 }
 
-static void tickKick(NlAvatars* avatars, NlBall* ball)
+/// Returns true if the avatar released the kick button with built-up kick power
+static bool tickAvatarKickPower(NlAvatar* avatar, const NlRules* rules)
 {
-    for (size_t i = 0; i < avatars->avatarCount; ++i) {
-        NlAvatar* avatar = &avatars->avatars[i];
-        if (avatar->kickCooldown > 0) {
-            avatar->kickCooldown--;
+    if (avatar->kickCooldown > 0) {
+        avatar->kickCooldown--;
+        return false;
+    }
+    if (avatar->requestBuildKickPower) {
+        if (avatar->kickPower < rules->tickRate.maxKickPowerTicks) {
+            avatar->kickPower++;
+        }
+        return false;
+    }
+
+    // Button is released, use all the built-up kick power
+    return avatar->kickPower > 0;
+}
+
+/// Returns true if the avatar kicked the ball
+static bool tickAvatarKick(NlAvatar* avatar, NlBall* ball, const NlRules* rules)
+{
+    if (!tickAvatarKickPower(avatar, rules)) {
+        return false;
+    }
+    bool didKickBall = performKick(avatar, ball, avatar->kickPower, rules);
+    avatar->kickPower = 0;
+
+    return didKickBall;
+}
+
+static void tickKick(NlAvatars* avatars, NlBall* ball, const NlRules* rules, NlTickFootprint* footprint,
+                     NlGameEvents* events)
+{
+    footprint->ballBeforeKick = *ball;
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
             continue;
         }
-        if (avatar->requestBuildKickPower) {
-            if (avatar->kickPower < MAX_KICK_POWER_TICKS) {
-                avatar->kickPower++;
-            }
-        } else {
-            // Button is released, use all the built-up kick power
-            if (avatar->kickPower > 0) {
-                performKick(avatar, ball, avatar->kickPower);
-                avatar->kickPower = 0;
-            }
+        uint8_t kickPower = avatars->avatars[i].kickPower;
+        if (!tickAvatarKick(&avatars->avatars[i], ball, rules)) {
             continue;
         }
+        footprint->kickTouchedMask |= (NlSlotMask) (1u << i);
+        NlGameEvent* event = addEvent(events, NlGameEventTypeKick);
+        if (event != 0) {
+            event->data.kick.avatarIndex = (uint8_t) i;
+            event->data.kick.kickPower = kickPower;
+        }
     }
 }
 
-static void tickSlideTackle(NlAvatars* avatars)
+/// Returns true if the avatar started a slide tackle
+static bool tickAvatarSlideTackle(NlAvatar* avatar, const NlRules* rules)
 {
-    for (size_t i = 0; i < avatars->avatarCount; ++i) {
-        NlAvatar* avatar = &avatars->avatars[i];
-        if (avatar->slideTackleRemainingTicks > 0) {
-            avatar->slideTackleRemainingTicks--;
+    if (avatar->slideTackleRemainingTicks > 0) {
+        avatar->slideTackleRemainingTicks--;
+        return false;
+    }
+    if (avatar->slideTackleCooldown > 0) {
+        avatar->slideTackleCooldown--;
+        return false;
+    }
+    if (!avatar->requestSlideTackle) {
+        return false;
+    }
+
+    avatar->slideTackleCooldown = rules->tickRate.slideTackleCooldownTicks;
+    avatar->slideTackleRemainingTicks = rules->tickRate.slideTackleDurationTicks;
+    avatar->slideTackleRotation = avatar->visualRotation;
+
+    return true;
+}
+
+static void tickSlideTackle(NlAvatars* avatars, const NlRules* rules, NlGameEvents* events)
+{
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
             continue;
         }
-        if (avatar->slideTackleCooldown > 0) {
-            avatar->slideTackleCooldown--;
+        if (!tickAvatarSlideTackle(&avatars->avatars[i], rules)) {
             continue;
         }
-        if (avatar->requestSlideTackle) {
-            avatar->slideTackleCooldown = SLIDE_TACKLE_COOLDOWN;
-            avatar->slideTackleRemainingTicks = SLIDE_TACKLE_DURATION;
-            avatar->slideTackleRotation = avatar->visualRotation;
+        NlGameEvent* event = addEvent(events, NlGameEventTypeSlideTackle);
+        if (event != 0) {
+            event->data.slideTackle.avatarIndex = (uint8_t) i;
         }
     }
 }
 
-static void checkEndOfMatchTime(NlGame* self)
+static void checkEndOfMatchTime(uint16_t* matchClockLeftInTicks, uint8_t* phase, uint16_t* phaseCountDown,
+                                const NlRules* rules)
 {
-    if (self->matchClockLeftInTicks > 0) {
-        self->matchClockLeftInTicks--;
+    if (*matchClockLeftInTicks > 0) {
+        (*matchClockLeftInTicks)--;
         return;
     }
 
-    self->phase = NlGamePhasePostGame;
-    self->phaseCountDown = 62 * 6;
+    *phase = NlGamePhasePostGame;
+    *phaseCountDown = rules->tickRate.postGameTicks;
+}
+
+void nlMatchStatsInit(NlMatchStats* self)
+{
+    tc_mem_clear_type(self);
+    self->lastTouchedAvatarIndex = NL_AVATAR_INDEX_UNDEFINED;
+}
+
+/// A kick is a shot if the ball, going in a straight line, would cross the goal line of the opposing team
+static bool isShot(const NlConstants* constants, const NlBall* ball, uint8_t teamIndex)
+{
+    for (size_t i = 0; i < 2; ++i) {
+        const NlGoal* goal = &constants->goals[i];
+        if (goal->ownedByTeam == teamIndex) {
+            continue;
+        }
+        float goalLineX = goal->facingLeft ? goal->rect.position.x : goal->rect.position.x + goal->rect.size.x;
+        float distanceX = goalLineX - ball->circle.center.x;
+        if (fabsf(ball->velocity.x) < 0.001f || (distanceX > 0) != (ball->velocity.x > 0)) {
+            return false;
+        }
+        float yAtGoalLine = ball->circle.center.y + ball->velocity.y * (distanceX / ball->velocity.x);
+        return yAtGoalLine >= goal->rect.position.y && yAtGoalLine <= goal->rect.position.y + goal->rect.size.y;
+    }
+
+    return false;
 }
 
-static void tickPlaying(NlGame* self)
+/// Avatar stats are per slot, so a new avatar in a reused slot must not continue on the stats of the previous one
+static void resetStatsOfReusedSlots(NlMatchStats* stats, const NlAvatars* avatars)
 {
-    checkEndOfMatchTime(self);
-    tickAvatars(&self->avatars);
-    tickDribble(&self->avatars, &self->ball);
-    tickKick(&self->avatars, &self->ball);
-    tickSlideTackle(&self->avatars);
-    tickBall(&self->ball);
-    tickGoalCheck(&self->teams, &self->ball, &self->phase, &self->phaseCountDown, &self->latestScoredTeamIndex);
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
+            continue;
+        }
+        uint8_t generation = avatars->avatars[i].generation;
+        if (stats->avatars[i].generation == generation) {
+            continue;
+        }
+        tc_mem_clear_type(&stats->avatars[i]);
+        stats->avatars[i].generation = generation;
+        if (stats->lastTouchedAvatarIndex == i) {
+            stats->lastTouchedAvatarIndex = NL_AVATAR_INDEX_UNDEFINED;
+        }
+    }
+}
+
+static void recordTouches(NlMatchStats* stats, const NlRules* rules, const NlAvatars* avatars, const NlBall* ball,
+                          const NlTickFootprint* footprint)
+{
+    // Slot order is also the order the avatars touched the ball in, so the last one wins
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        NlSlotMask bit = (NlSlotMask) (1u << i);
+        if (((footprint->dribbleTouchedMask | footprint->kickTouchedMask) & bit) == 0) {
+            continue;
+        }
+        stats->lastTouchedAvatarIndex = (uint8_t) i;
+    }
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if ((footprint->kickTouchedMask & (1u << i)) == 0) {
+            continue;
+        }
+        uint8_t teamIndex = avatars->avatars[i].teamIndex;
+        stats->avatars[i].kickCount++;
+        stats->teams[teamIndex].kickCount++;
+        if (stats->lastTouchedAvatarIndex == i && isShot(&rules->constants, ball, teamIndex)) {
+            stats->avatars[i].shotCount++;
+            stats->teams[teamIndex].shotCount++;
+        }
+    }
 }
 
-static void resetAvatarsToStartPositions(NlAvatars* avatars)
+static void recordPlayingTick(NlMatchStats* stats, const NlGame* game, uint16_t scoreBefore)
+{
+    stats->playedTickCount++;
+
+    uint8_t lastTouched = stats->lastTouchedAvatarIndex;
+    bool hasPossession = lastTouched != NL_AVATAR_INDEX_UNDEFINED &&
+                         isSlotActive(game->avatars.activeMask, lastTouched);
+    if (hasPossession) {
+        stats->avatars[lastTouched].possessionTicks++;
+        stats->teams[game->avatars.avatars[lastTouched].teamIndex].possessionTicks++;
+    }
+
+    uint16_t score = (uint16_t) (game->teams.teams[0].score + game->teams.teams[1].score);
+    if (score != scoreBefore) {
+        uint8_t scoringTeamIndex = game->latestScoredTeamIndex;
+        stats->teams[scoringTeamIndex].goalCount++;
+        if (hasPossession && game->avatars.avatars[lastTouched].teamIndex == scoringTeamIndex) {
+            stats->avatars[lastTouched].goalCount++;
+        }
+        // Kick off after a goal, nobody has the ball
+        stats->lastTouchedAvatarIndex = NL_AVATAR_INDEX_UNDEFINED;
+    }
+
+    if (game->phase == NlGamePhasePostGame) {
+        stats->isMatchOver = true;
+    }
+}
+
+/// Inlined separately for the default rules and for any other rules, see g_defaultRules
+static inline void tickPlaying(NlGame* self, const NlRules* rules, NlTickFootprint* footprint, NlGameEvents* events,
+                               NlMatchStats* stats, Clog* log)
+{
+    uint16_t scoreBefore = (uint16_t) (self->teams.teams[0].score + self->teams.teams[1].score);
+    if (stats != 0) {
+        resetStatsOfReusedSlots(stats, &self->avatars);
+    }
+
+    checkEndOfMatchTime(&self->matchClockLeftInTicks, &self->phase, &self->phaseCountDown, rules);
+    tickAvatars(&self->avatars, rules, footprint, stats);
+    tickDribble(&self->avatars, &self->ball, rules, footprint);
+    tickKick(&self->avatars, &self->ball, rules, footprint, events);
+    if (stats != 0) {
+        recordTouches(stats, rules, &self->avatars, &self->ball, footprint);
+    }
+    tickSlideTackle(&self->avatars, rules, events);
+
+    uint8_t collideCounterBefore = self->ball.collideCounter;
+    BlVector2 ballStartPosition = self->ball.circle.center;
+    footprint->ballHitBorder = tickBall(&self->ball, rules);
+    if (self->ball.collideCounter != collideCounterBefore) {
+        NlGameEvent* event = addEvent(events, NlGameEventTypeBallHitBorder);
+        if (event != 0) {
+            event->data.ballHitBorder.position = self->ball.circle.center;
+        }
+    }
+
+    tickGoalCheck(&self->teams, &self->ball, ballStartPosition, &self->phase, &self->phaseCountDown,
+                  &self->latestScoredTeamIndex, rules, events, log);
+
+    if (stats != 0) {
+        recordPlayingTick(stats, self, scoreBefore);
+    }
+}
+
+static void resetAvatarsToStartPositions(NlAvatars* avatars, const NlRuleset* ruleset)
 {
     int placedInEachTeam[2] = {0, 0};
     const int avatarCountInEachRow = 4;
 
-    for (size_t i = 0; i < avatars->avatarCount; ++i) {
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
+            continue;
+        }
         NlAvatar* avatar = &avatars->avatars[i];
         int placed = placedInEachTeam[avatar->teamIndex]++;
 
@@ -631,7 +1576,7 @@ static void resetAvatarsToStartPositions(NlAvatars* avatars)
         int column = (20 + colIndex * 40) * columnFactor;
         int row = rowIndex * 40;
 
-        const int centerLine = (int) (arenaWidth / 2);
+        const int centerLine = (int) (ruleset->arenaWidth / 2);
         column = centerLine + column;
 
         const int rowOffset = 50;
@@ -655,7 +1600,10 @@ static void resetAvatarsToStartPositions(NlAvatars* avatars)
 static void spawnAvatarsForWaitingPlayers(NlGame* self)
 {
     for (size_t i = 0; i < self->players.playerCount; ++i) {
-        for (size_t playerIndex = 0u; playerIndex < self->players.playerCount; ++playerIndex) {
+        for (size_t playerIndex = 0u; playerIndex < NL_MAX_PLAYERS; ++playerIndex) {
+            if (!isSlotActive(self->players.activeMask, playerIndex)) {
+                continue;
+            }
             NlPlayer* player = &self->players.players[playerIndex];
             if (player->phase == NlPlayerPhaseCommittedToTeam &&
                 player->controllingAvatarIndex == NL_AVATAR_INDEX_UNDEFINED &&
@@ -671,10 +1619,11 @@ static void resetPitchAndStartCountdown(NlGame* self)
 {
     spawnAvatarsForWaitingPlayers(self);
 
-    resetAvatarsToStartPositions(&self->avatars);
-    resetBallToMiddlePosition(&self->ball);
+    const NlRules* rules = nlGameRules(self);
+    resetAvatarsToStartPositions(&self->avatars, &rules->ruleset);
+    resetBallToMiddlePosition(&self->ball, rules);
 
-    self->phaseCountDown = 62 * 3;
+    self->phaseCountDown = rules->tickRate.countDownTicks;
     self->phase = NlGamePhaseCountDown;
 }
 
@@ -694,7 +1643,7 @@ static void resetForNewMatch(NlGame* self)
         self->teams.teams[i].score = 0;
     }
 
-    self->matchClockLeftInTicks = g_nlConstants.matchDurationInTicks;
+    self->matchClockLeftInTicks = nlGameRules(self)->tickRate.matchDurationInTicks;
 
     resetPitchAndStartCountdown(self);
 }
@@ -711,8 +1660,27 @@ static void tickPostGame(NlGame* self)
 
 void nlGameTick(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount, Clog* log)
 {
-    checkInputDiff(self, inputs, inputCount, log);
-    playerToAvatarControl(self, &self->players, &self->avatars);
+    nlGameTickWithOutput(self, inputs, inputCount, 0, log);
+}
+
+void nlGameTickWithOutput(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                          const NlGameTickOutput* output, Clog* log)
+{
+    NlTickFootprint scratchFootprint;
+    NlTickFootprint* footprint = (output != 0 && output->footprint != 0) ? output->footprint : &scratchFootprint;
+    NlGameEvents* events = output != 0 ? output->events : 0;
+    NlMatchStats* stats = output != 0 ? output->stats : 0;
+    tc_mem_clear_type(footprint);
+
+    NlSlotMask playerMaskBefore = self->players.activeMask;
+    NlSlotMask avatarMaskBefore = self->avatars.activeMask;
+    uint8_t phaseBefore = self->phase;
+
+    checkInputDiff(self, inputs, inputCount, events, log);
+    playerToAvatarControl(self, &self->players, &self->avatars, log);
+
+    bool isRosterUnchanged = playerMaskBefore == self->players.activeMask &&
+                             avatarMaskBefore == self->avatars.activeMask;
 
     self->tickCount++;
     switch (self->phase) {
@@ -723,7 +1691,11 @@ void nlGameTick(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, si
             tickCountDown(self);
             break;
         case NlGamePhasePlaying:
-            tickPlaying(self);
+            if (self->rules.isDefault) {
+                tickPlaying(self, &g_defaultRules, footprint, events, stats, log);
+            } else {
+                tickPlaying(self, nlGameRules(self), footprint, events, stats, log);
+            }
             break;
         case NlGamePhaseAfterAGoal:
             tickAfterGoal(self);
@@ -732,4 +1704,457 @@ void nlGameTick(NlGame* self, const NlPlayerInputWithParticipantInfo* inputs, si
             tickPostGame(self);
             break;
     }
+
+    footprint->isPlayingWithSameRoster = isRosterUnchanged && phaseBefore == NlGamePhasePlaying &&
+                                         self->phase == NlGamePhasePlaying;
+
+    if (self->phase != phaseBefore) {
+        NlGameEvent* event = addEvent(events, NlGameEventTypePhaseChanged);
+        if (event != 0) {
+            event->data.phaseChanged.previousPhase = phaseBefore;
+            event->data.phaseChanged.phase = self->phase;
+        }
+    }
+}
+
+void nlGameFork(NlGameFork* self, const NlGame* game)
+{
+    uint8_t packedCount = 0;
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(game->avatars.activeMask, i)) {
+            continue;
+        }
+        self->avatars.avatars[packedCount++] = game->avatars.avatars[i];
+    }
+    self->avatars.avatarCount = packedCount;
+    self->avatars.activeMask = (NlSlotMask) ((1u << packedCount) - 1u);
+
+    self->ball = game->ball;
+    self->teams = game->teams;
+    self->phase = game->phase;
+    self->phaseCountDown = game->phaseCountDown;
+    self->matchClockLeftInTicks = game->matchClockLeftInTicks;
+    self->latestScoredTeamIndex = game->latestScoredTeamIndex;
+    self->rules = nlGameRules(game);
+}
+
+void nlGameForkCopy(NlGameFork* self, const NlGameFork* source)
+{
+    for (size_t i = 0; i < source->avatars.avatarCount; ++i) {
+        self->avatars.avatars[i] = source->avatars.avatars[i];
+    }
+    self->avatars.avatarCount = source->avatars.avatarCount;
+    self->avatars.activeMask = source->avatars.activeMask;
+
+    self->ball = source->ball;
+    self->teams = source->teams;
+    self->phase = source->phase;
+    self->phaseCountDown = source->phaseCountDown;
+    self->matchClockLeftInTicks = source->matchClockLeftInTicks;
+    self->latestScoredTeamIndex = source->latestScoredTeamIndex;
+    self->rules = source->rules;
+}
+
+static inline void tickForkPlaying(NlGameFork* self, const NlRules* rules)
+{
+    // Same stages as tickPlaying. The avatars are packed in slot order, so they touch the ball in the same order
+    NlTickFootprint footprint;
+    checkEndOfMatchTime(&self->matchClockLeftInTicks, &self->phase, &self->phaseCountDown, rules);
+    tickAvatars(&self->avatars, rules, &footprint, 0);
+    tickDribble(&self->avatars, &self->ball, rules, &footprint);
+    tickKick(&self->avatars, &self->ball, rules, &footprint, 0);
+    tickSlideTackle(&self->avatars, rules, 0);
+    BlVector2 ballStartPosition = self->ball.circle.center;
+    tickBall(&self->ball, rules);
+    tickGoalCheck(&self->teams, &self->ball, ballStartPosition, &self->phase, &self->phaseCountDown,
+                  &self->latestScoredTeamIndex, rules, 0, 0);
+}
+
+void nlGameForkTick(NlGameFork* self, const NlPlayerInGameInput* inputs)
+{
+    for (size_t i = 0; i < self->avatars.avatarCount; ++i) {
+        inGameInputToAvatar(&inputs[i], &self->avatars.avatars[i]);
+    }
+
+    if (self->phase != NlGamePhasePlaying) {
+        return;
+    }
+
+    if (self->rules == &g_defaultRules) {
+        tickForkPlaying(self, &g_defaultRules);
+    } else {
+        tickForkPlaying(self, self->rules);
+    }
+}
+
+/// The ball the avatar at `avatarIndex` saw in a stage of the predicted tick is only known to be the ball from
+/// before the stage if no avatar before it (in slot order) touched the ball in that stage.
+static bool isBallBeforeStageSeenByAvatar(NlSlotMask touchedMask, size_t avatarIndex)
+{
+    NlSlotMask avatarsBefore = (NlSlotMask) ((1u << avatarIndex) - 1u);
+    return (touchedMask & avatarsBefore) == 0;
+}
+
+bool nlGameResimulateParticipant(NlGame* predictedState, const NlGame* rollbackState,
+                                 const NlTickFootprint* footprints, const NlPlayerInput* correctedInputs,
+                                 size_t tickCount, uint8_t participantId)
+{
+    const NlPlayer* rollbackPlayer = nlGameFindSimulationPlayerFromParticipantId(rollbackState, participantId);
+    if (rollbackPlayer == 0 || rollbackPlayer->controllingAvatarIndex == NL_AVATAR_INDEX_UNDEFINED) {
+        return false;
+    }
+
+    NlPlayerHandle playerHandle = nlGamePlayerHandle(rollbackState, rollbackPlayer->playerIndex);
+    NlAvatarHandle avatarHandle = nlGameAvatarHandle(rollbackState, rollbackPlayer->controllingAvatarIndex);
+    if (nlGameResolvePlayer(predictedState, playerHandle) == 0 ||
+        nlGameResolveAvatar(predictedState, avatarHandle) == 0) {
+        return false;
+    }
+
+    size_t avatarIndex = avatarHandle.index;
+    NlSlotMask avatarBit = (NlSlotMask) (1u << avatarIndex);
+    NlPlayer player = *rollbackPlayer;
+    NlAvatar avatar = rollbackState->avatars.avatars[avatarIndex];
+    const NlRules* rules = nlGameRules(rollbackState);
+
+    for (size_t tickIndex = 0; tickIndex < tickCount; ++tickIndex) {
+        const NlTickFootprint* footprint = &footprints[tickIndex];
+        if (!footprint->isPlayingWithSameRoster) {
+            return false;
+        }
+
+        if (((footprint->dribbleTouchedMask | footprint->kickTouchedMask) & avatarBit) != 0) {
+            // The predicted avatar changed the ball, so everything that came after depends on it
+            return false;
+        }
+
+        player.playerInput = correctedInputs[tickIndex];
+        if (player.playerInput.inputType == NlPlayerInputTypeSelectTeam) {
+            return false;
+        }
+        playerInputToAvatar(&player, &avatar);
+
+        tickAvatar(&avatar, rules);
+
+        // The avatar works on copies of the ball, if it touches it the resimulation must include everything
+        NlBall seenBall = footprint->ballBeforeDribble;
+        if (avatar.dribbleCooldown == 0 &&
+            !isBallBeforeStageSeenByAvatar(footprint->dribbleTouchedMask, avatarIndex)) {
+            return false;
+        }
+        if (tickAvatarDribble(&avatar, &seenBall, rules)) {
+            return false;
+        }
+
+        seenBall = footprint->ballBeforeKick;
+        if (avatar.kickCooldown == 0 && !avatar.requestBuildKickPower && avatar.kickPower > 0 &&
+            !isBallBeforeStageSeenByAvatar(footprint->kickTouchedMask, avatarIndex)) {
+            return false;
+        }
+        if (tickAvatarKick(&avatar, &seenBall, rules)) {
+            return false;
+        }
+
+        tickAvatarSlideTackle(&avatar, rules);
+    }
+
+    predictedState->players.players[player.playerIndex] = player;
+    predictedState->avatars.avatars[avatarIndex] = avatar;
+
+    return true;
+}
+
+void nlDrillInit(NlDrill* self, const NlGame* game, size_t ballCount)
+{
+    CLOG_ASSERT(ballCount <= NL_DRILL_MAX_BALLS, "too many drill balls %zu", ballCount)
+
+    tc_mem_clear_type(self);
+
+    const NlRuleset* ruleset = &nlGameRules(game)->ruleset;
+    NlDrillBalls* balls = &self->balls;
+    balls->count = (uint16_t) ballCount;
+    balls->radius = ruleset->ballRadius;
+    if (ballCount == 0) {
+        return;
+    }
+
+    float border = balls->radius * 2.0f;
+    float width = ruleset->arenaWidth - ruleset->goalDetectWidth - border * 2.0f;
+    float height = ruleset->arenaHeight - border * 2.0f;
+    size_t columnCount = (size_t) ceilf(sqrtf((float) ballCount * width / height));
+    size_t rowCount = (ballCount + columnCount - 1) / columnCount;
+    float spacingX = width / (float) columnCount;
+    float spacingY = height / (float) rowCount;
+
+    for (size_t i = 0; i < ballCount; ++i) {
+        balls->positionX[i] = ruleset->arenaLeft + border + spacingX * ((float) (i % columnCount) + 0.5f);
+        balls->positionY[i] = ruleset->arenaBottom + border + spacingY * ((float) (i / columnCount) + 0.5f);
+    }
+}
+
+void nlDrillBall(const NlDrill* self, size_t index, NlBall* target)
+{
+    const NlDrillBalls* balls = &self->balls;
+    CLOG_ASSERT(index < balls->count, "illegal drill ball index %zu", index)
+
+    target->circle.center.x = balls->positionX[index];
+    target->circle.center.y = balls->positionY[index];
+    target->circle.radius = balls->radius;
+    target->velocity.x = balls->velocityX[index];
+    target->velocity.y = balls->velocityY[index];
+    target->collideCounter = balls->collideCounter[index];
+}
+
+void nlDrillSetBall(NlDrill* self, size_t index, const NlBall* ball)
+{
+    NlDrillBalls* balls = &self->balls;
+    CLOG_ASSERT(index < balls->count, "illegal drill ball index %zu", index)
+
+    balls->positionX[index] = ball->circle.center.x;
+    balls->positionY[index] = ball->circle.center.y;
+    balls->velocityX[index] = ball->velocity.x;
+    balls->velocityY[index] = ball->velocity.y;
+    balls->collideCounter[index] = ball->collideCounter;
+}
+
+static size_t drillGridColumn(const NlDrillBroadphase* self, float x)
+{
+    float column = floorf((x - self->originX) * self->inverseCellWidth);
+    if (column < 0.0f) {
+        return 0;
+    }
+    return column >= (float) NL_DRILL_GRID_COLUMNS ? NL_DRILL_GRID_COLUMNS - 1 : (size_t) column;
+}
+
+static size_t drillGridRow(const NlDrillBroadphase* self, float y)
+{
+    float row = floorf((y - self->originY) * self->inverseCellHeight);
+    if (row < 0.0f) {
+        return 0;
+    }
+    return row >= (float) NL_DRILL_GRID_ROWS ? NL_DRILL_GRID_ROWS - 1 : (size_t) row;
+}
+
+/// Counting sort of the balls into the grid cells. Balls outside the arena end up in the closest edge cell.
+static void buildDrillBroadphase(NlDrillBroadphase* self, const NlDrillBalls* balls, const NlRuleset* ruleset)
+{
+    self->originX = ruleset->arenaLeft - ruleset->goalDetectWidth;
+    self->originY = ruleset->arenaBottom;
+    self->inverseCellWidth = (float) NL_DRILL_GRID_COLUMNS / (ruleset->arenaWidth + ruleset->goalDetectWidth);
+    self->inverseCellHeight = (float) NL_DRILL_GRID_ROWS / ruleset->arenaHeight;
+
+    uint8_t ballCells[NL_DRILL_MAX_BALLS];
+    uint16_t cellCounts[NL_DRILL_GRID_COLUMNS * NL_DRILL_GRID_ROWS];
+    tc_mem_clear_type_n(cellCounts, NL_DRILL_GRID_COLUMNS * NL_DRILL_GRID_ROWS);
+
+    for (size_t i = 0; i < balls->count; ++i) {
+        size_t cell = drillGridRow(self, balls->positionY[i]) * NL_DRILL_GRID_COLUMNS +
+                      drillGridColumn(self, balls->positionX[i]);
+        ballCells[i] = (uint8_t) cell;
+        cellCounts[cell]++;
+    }
+
+    uint16_t start = 0;
+    for (size_t cell = 0; cell < NL_DRILL_GRID_COLUMNS * NL_DRILL_GRID_ROWS; ++cell) {
+        self->cellStart[cell] = start;
+        start = (uint16_t) (start + cellCounts[cell]);
+        cellCounts[cell] = 0;
+    }
+    self->cellStart[NL_DRILL_GRID_COLUMNS * NL_DRILL_GRID_ROWS] = start;
+
+    for (size_t i = 0; i < balls->count; ++i) {
+        size_t cell = ballCells[i];
+        self->ballIndices[self->cellStart[cell] + cellCounts[cell]++] = (uint16_t) i;
+    }
+}
+
+/// Returns the index of the closest ball overlapping `reach`, or NL_DRILL_MAX_BALLS if there is none. Balls can have
+/// moved a bit since the broadphase was built, so `queryMargin` is added when looking up the cells.
+static size_t findClosestDrillBall(const NlDrill* self, BlCircle reach, float queryMargin)
+{
+    const NlDrillBalls* balls = &self->balls;
+    const NlDrillBroadphase* broadphase = &self->broadphase;
+    float queryDistance = reach.radius + balls->radius + queryMargin;
+    size_t firstColumn = drillGridColumn(broadphase, reach.center.x - queryDistance);
+    size_t lastColumn = drillGridColumn(broadphase, reach.center.x + queryDistance);
+    size_t firstRow = drillGridRow(broadphase, reach.center.y - queryDistance);
+    size_t lastRow = drillGridRow(broadphase, reach.center.y + queryDistance);
+
+    size_t closestIndex = NL_DRILL_MAX_BALLS;
+    float closestSquareDistance = 0.0f;
+    for (size_t row = firstRow; row <= lastRow; ++row) {
+        for (size_t column = firstColumn; column <= lastColumn; ++column) {
+            size_t cell = row * NL_DRILL_GRID_COLUMNS + column;
+            for (size_t i = broadphase->cellStart[cell]; i < broadphase->cellStart[cell + 1]; ++i) {
+                size_t ballIndex = broadphase->ballIndices[i];
+                BlCircle ballCircle = {{balls->positionX[ballIndex], balls->positionY[ballIndex]}, balls->radius};
+                if (!blCircleOverlap(reach, ballCircle)) {
+                    continue;
+                }
+                float squareDistance = blVector2SquareLength(blVector2Sub(ballCircle.center, reach.center));
+                bool isCloser = closestIndex == NL_DRILL_MAX_BALLS || squareDistance < closestSquareDistance ||
+                                (squareDistance == closestSquareDistance && ballIndex < closestIndex);
+                if (isCloser) {
+                    closestIndex = ballIndex;
+                    closestSquareDistance = squareDistance;
+                }
+            }
+        }
+    }
+
+    return closestIndex;
+}
+
+/// Same as tickDribble, each avatar dribbles the closest ball in reach
+static void tickDrillDribble(NlAvatars* avatars, NlDrill* drill, const NlRules* rules, float queryMargin)
+{
+    buildDrillBroadphase(&drill->broadphase, &drill->balls, &rules->ruleset);
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
+            continue;
+        }
+        NlAvatar* avatar = &avatars->avatars[i];
+        if (avatar->dribbleCooldown > 0) {
+            avatar->dribbleCooldown--;
+            continue;
+        }
+        BlCircle dribbleReach = avatar->circle;
+        dribbleReach.radius = avatar->circle.radius + rules->ruleset.dribbleReachExtra;
+        size_t ballIndex = findClosestDrillBall(drill, dribbleReach, queryMargin);
+        if (ballIndex == NL_DRILL_MAX_BALLS) {
+            continue;
+        }
+        NlBall ball;
+        nlDrillBall(drill, ballIndex, &ball);
+        dribbleBall(avatar, &ball, rules);
+        nlDrillSetBall(drill, ballIndex, &ball);
+    }
+}
+
+/// Same as tickKick, each avatar kicks the closest ball in reach
+static void tickDrillKick(NlAvatars* avatars, NlDrill* drill, const NlRules* rules)
+{
+    buildDrillBroadphase(&drill->broadphase, &drill->balls, &rules->ruleset);
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (!isSlotActive(avatars->activeMask, i)) {
+            continue;
+        }
+        NlAvatar* avatar = &avatars->avatars[i];
+        if (!tickAvatarKickPower(avatar, rules)) {
+            continue;
+        }
+        BlCircle kickReach = avatar->circle;
+        kickReach.radius = avatar->circle.radius * 2.0f;
+        // Kicks only change the velocity, apart from small pushes out of the borders
+        size_t ballIndex = findClosestDrillBall(drill, kickReach, 1.0f);
+        if (ballIndex != NL_DRILL_MAX_BALLS) {
+            NlBall ball;
+            nlDrillBall(drill, ballIndex, &ball);
+            performKick(avatar, &ball, avatar->kickPower, rules);
+            nlDrillSetBall(drill, ballIndex, &ball);
+        }
+        avatar->kickPower = 0;
+    }
+}
+
+/// Moves the balls that stay clear of the borders and goals in a loop without branches on the ball, and runs the
+/// rest through tickBall and the goal check, one by one. Both give the same result for a ball that is clear.
+static void tickDrillBalls(NlDrill* drill, NlTeams* teams, uint8_t* latestScoredTeamIndex, const NlRules* rules)
+{
+    NlDrillBalls* balls = &drill->balls;
+    const NlRuleset* ruleset = &rules->ruleset;
+    const float damping = rules->tickRate.ballDamping;
+    const float minimalSquareSpeed = MINIMAL_VELOCITY * rules->tickRate.accelerationScale;
+    const float clearance = balls->radius + 1.0f;
+    const float clearLeft = ruleset->arenaLeft + clearance;
+    const float clearRight = ruleset->arenaLeft + ruleset->arenaWidth - 1 - ruleset->goalDetectWidth - clearance;
+    const float clearBottom = ruleset->arenaBottom + clearance;
+    const float clearTop = ruleset->arenaBottom + ruleset->arenaHeight - clearance;
+
+    uint8_t isClear[NL_DRILL_MAX_BALLS];
+    size_t count = balls->count;
+    for (size_t i = 0; i < count; ++i) {
+        float x = balls->positionX[i];
+        float y = balls->positionY[i];
+        float velocityX = balls->velocityX[i] * damping;
+        float velocityY = balls->velocityY[i] * damping;
+        float nextX = x + velocityX;
+        float nextY = y + velocityY;
+        // The arena is convex, so the whole move is clear if the start and end are
+        uint8_t clear = (uint8_t) ((x > clearLeft) & (x < clearRight) & (y > clearBottom) & (y < clearTop) &
+                                   (nextX > clearLeft) & (nextX < clearRight) & (nextY > clearBottom) &
+                                   (nextY < clearTop));
+        float keep = (velocityX * velocityX + velocityY * velocityY) < minimalSquareSpeed ? 0.0f : 1.0f;
+        isClear[i] = clear;
+        if (clear) {
+            balls->positionX[i] = nextX;
+            balls->positionY[i] = nextY;
+            balls->velocityX[i] = velocityX * keep;
+            balls->velocityY[i] = velocityY * keep;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (isClear[i]) {
+            continue;
+        }
+        NlBall ball;
+        nlDrillBall(drill, i, &ball);
+        BlVector2 ballStartPosition = ball.circle.center;
+        tickBall(&ball, rules);
+        for (size_t goalIndex = 0; goalIndex < 2; ++goalIndex) {
+            if (checkGoal(&rules->constants.goals[goalIndex], &ball, ballStartPosition, teams, latestScoredTeamIndex,
+                          0)) {
+                resetBallToMiddlePosition(&ball, rules);
+                break;
+            }
+        }
+        nlDrillSetBall(drill, i, &ball);
+    }
+}
+
+/// Inlined separately for the default rules and for any other rules, see g_defaultRules
+static inline void tickDrillPlaying(NlGame* self, NlDrill* drill, const NlRules* rules)
+{
+    NlTickFootprint footprint;
+    tc_mem_clear_type(&footprint);
+
+    // A dribble moves a ball at most this far, so the broadphase finds it for the avatars later in slot order
+    float dribbleMargin = rules->ruleset.avatarRadius + rules->ruleset.dribbleDistanceFromBody +
+                          rules->ruleset.ballRadius;
+
+    tickAvatars(&self->avatars, rules, &footprint, 0);
+    tickDrillDribble(&self->avatars, drill, rules, dribbleMargin);
+    tickDrillKick(&self->avatars, drill, rules);
+    tickSlideTackle(&self->avatars, rules, 0);
+    tickDrillBalls(drill, &self->teams, &self->latestScoredTeamIndex, rules);
+}
+
+void nlGameTickDrill(NlGame* self, NlDrill* drill, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                     Clog* log)
+{
+    checkInputDiff(self, inputs, inputCount, 0, log);
+    playerToAvatarControl(self, &self->players, &self->avatars, log);
+
+    self->tickCount++;
+    switch (self->phase) {
+        case NlGamePhaseWaitingForPlayers:
+            tickWaitingForPlayers(self, log);
+            break;
+        case NlGamePhaseCountDown:
+            tickCountDown(self);
+            break;
+        case NlGamePhasePlaying:
+            if (self->rules.isDefault) {
+                tickDrillPlaying(self, drill, &g_defaultRules);
+            } else {
+                tickDrillPlaying(self, drill, nlGameRules(self));
+            }
+            break;
+        default:
+            // Goals do not pause a drill and it has no match clock
+            break;
+    }
 }
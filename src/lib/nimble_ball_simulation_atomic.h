@@ -0,0 +1,106 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_ATOMIC_H
+#define NIMBLE_BALL_SIMULATION_ATOMIC_H
+
+// The library is C99, so the few atomic operations needed for the lock-free structures are wrapped here
+// instead of using <stdatomic.h>.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined _MSC_VER
+#include <intrin.h>
+
+// MSVC volatile accesses have acquire / release semantics (/volatile:ms, the default on x86 and x64)
+static inline uint32_t nlAtomicLoadAcquire(const volatile uint32_t* target)
+{
+    uint32_t value = *target;
+    _ReadWriteBarrier();
+    return value;
+}
+
+static inline uint32_t nlAtomicLoadRelaxed(const volatile uint32_t* target)
+{
+    return *target;
+}
+
+static inline void nlAtomicStoreRelease(volatile uint32_t* target, uint32_t value)
+{
+    _ReadWriteBarrier();
+    *target = value;
+}
+
+static inline void nlAtomicStoreRelaxed(volatile uint32_t* target, uint32_t value)
+{
+    *target = value;
+}
+
+static inline uint32_t nlAtomicFetchAdd(volatile uint32_t* target, uint32_t value)
+{
+    return (uint32_t) _InterlockedExchangeAdd((volatile long*) target, (long) value);
+}
+
+static inline bool nlAtomicCompareExchange(volatile uint32_t* target, uint32_t expected, uint32_t desired)
+{
+    return (uint32_t) _InterlockedCompareExchange((volatile long*) target, (long) desired, (long) expected) ==
+           expected;
+}
+
+static inline void nlAtomicFenceAcquire(void)
+{
+    _ReadWriteBarrier();
+}
+
+static inline void nlAtomicFenceRelease(void)
+{
+    _ReadWriteBarrier();
+}
+
+#else
+
+static inline uint32_t nlAtomicLoadAcquire(const volatile uint32_t* target)
+{
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t nlAtomicLoadRelaxed(const volatile uint32_t* target)
+{
+    return __atomic_load_n(target, __ATOMIC_RELAXED);
+}
+
+static inline void nlAtomicStoreRelease(volatile uint32_t* target, uint32_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+static inline void nlAtomicStoreRelaxed(volatile uint32_t* target, uint32_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t nlAtomicFetchAdd(volatile uint32_t* target, uint32_t value)
+{
+    return __atomic_fetch_add(target, value, __ATOMIC_ACQ_REL);
+}
+
+static inline bool nlAtomicCompareExchange(volatile uint32_t* target, uint32_t expected, uint32_t desired)
+{
+    return __atomic_compare_exchange_n(target, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline void nlAtomicFenceAcquire(void)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static inline void nlAtomicFenceRelease(void)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_baseline_manager.h>
+#include <tiny-libc/tiny_libc.h>
+
+void nlBaselineManagerInit(NlBaselineManager* self)
+{
+    tc_mem_clear_type(self);
+}
+
+static NlBaselineEntry* findEntry(NlBaselineManager* self, uint32_t tickId)
+{
+    for (size_t i = 0; i < NL_BASELINE_MANAGER_CAPACITY; ++i) {
+        NlBaselineEntry* entry = &self->entries[i];
+        if (entry->isUsed && entry->tickId == tickId) {
+            return entry;
+        }
+    }
+
+    return 0;
+}
+
+static NlBaselineEntry* findEntryToReplace(NlBaselineManager* self)
+{
+    NlBaselineEntry* oldestWithoutClients = 0;
+    NlBaselineEntry* oldest = 0;
+
+    for (size_t i = 0; i < NL_BASELINE_MANAGER_CAPACITY; ++i) {
+        NlBaselineEntry* entry = &self->entries[i];
+        if (!entry->isUsed) {
+            return entry;
+        }
+        if (entry->clientCount == 0 && (oldestWithoutClients == 0 || entry->tickId < oldestWithoutClients->tickId)) {
+            oldestWithoutClients = entry;
+        }
+        if (oldest == 0 || entry->tickId < oldest->tickId) {
+            oldest = entry;
+        }
+    }
+
+    self->stats.evictCount++;
+    if (oldestWithoutClients != 0) {
+        return oldestWithoutClients;
+    }
+
+    self->stats.evictedWithClientsCount++;
+
+    return oldest;
+}
+
+void nlBaselineManagerStore(NlBaselineManager* self, uint32_t tickId, const NlGame* game)
+{
+    if (findEntry(self, tickId) != 0) {
+        return;
+    }
+
+    NlBaselineEntry* entry = findEntryToReplace(self);
+
+    // Bumping the generation detaches any clients still pointing to the evicted state
+    entry->generation++;
+    if (entry->generation == 0) {
+        entry->generation = 1;
+    }
+    entry->game = *game;
+    entry->tickId = tickId;
+    entry->clientCount = 0;
+    entry->isUsed = true;
+
+    self->stats.storeCount++;
+}
+
+void nlBaselineClientInit(NlBaselineClient* client)
+{
+    client->ackedTickId = 0;
+    client->entryIndex = 0;
+    client->generation = 0;
+    client->hasBaseline = false;
+}
+
+static NlBaselineEntry* resolve(NlBaselineManager* self, const NlBaselineClient* client)
+{
+    if (!client->hasBaseline) {
+        return 0;
+    }
+
+    NlBaselineEntry* entry = &self->entries[client->entryIndex];
+    if (!entry->isUsed || entry->generation != client->generation) {
+        return 0;
+    }
+
+    return entry;
+}
+
+void nlBaselineManagerRemoveClient(NlBaselineManager* self, NlBaselineClient* client)
+{
+    NlBaselineEntry* entry = resolve(self, client);
+    if (entry != 0) {
+        CLOG_ASSERT(entry->clientCount > 0, "baseline client count is corrupt")
+        entry->clientCount--;
+    }
+    client->hasBaseline = false;
+}
+
+void nlBaselineManagerAck(NlBaselineManager* self, NlBaselineClient* client, uint32_t tickId)
+{
+    if (client->hasBaseline && tickId <= client->ackedTickId) {
+        return;
+    }
+
+    NlBaselineEntry* entry = findEntry(self, tickId);
+    if (entry == 0) {
+        return;
+    }
+
+    nlBaselineManagerRemoveClient(self, client);
+
+    entry->clientCount++;
+    client->ackedTickId = tickId;
+    client->entryIndex = (uint16_t) (entry - self->entries);
+    client->generation = entry->generation;
+    client->hasBaseline = true;
+}
+
+const NlGame* nlBaselineManagerBaseline(NlBaselineManager* self, const NlBaselineClient* client,
+                                        uint32_t* baselineTickId)
+{
+    const NlBaselineEntry* entry = resolve(self, client);
+    if (entry == 0) {
+        self->stats.fallbackCount++;
+        return 0;
+    }
+
+    *baselineTickId = entry->tickId;
+
+    return &entry->game;
+}
@@ -0,0 +1,320 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#if defined TORNADO_OS_LINUX || defined TORNADO_OS_MACOS
+#define NL_CHECKPOINT_USE_MMAP
+#if !defined _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <nimble-ball-simulation/nimble_ball_simulation_checkpoint.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vm_cache.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define CHECKPOINT_MAGIC (0x4E4C4350u) // "NLCP"
+#define CHECKPOINT_VERSION (1u)
+#define CHECKPOINT_HEADER_OCTET_COUNT (64)
+
+typedef struct NlCheckpointFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t slotCount;
+    uint64_t gameOctetCount;
+    uint64_t copyOctetCount;
+} NlCheckpointFileHeader;
+
+/// One of the two copies in a slot. The hash covers all octets of `match`, so a copy that was only partly written
+/// back when the machine went down is ignored.
+typedef struct NlCheckpointCopy {
+    uint64_t hash;
+    NlCheckpointMatch match;
+} NlCheckpointCopy;
+
+void nlCheckpointInputsInit(NlCheckpointInputs* self)
+{
+    tc_mem_clear_type(self);
+}
+
+void nlCheckpointInputsAdd(NlCheckpointInputs* self, uint32_t tickId, const NlPlayerInputWithParticipantInfo* inputs,
+                           size_t inputCount)
+{
+    CLOG_ASSERT(inputCount <= NL_MAX_PARTICIPANTS, "too many inputs %zu", inputCount)
+
+    NlCheckpointTickInputs* tickInputs = &self->ticks[self->addedCount % NL_CHECKPOINT_INPUT_COUNT];
+    tc_mem_clear_type(tickInputs);
+    tickInputs->tickId = tickId;
+    tickInputs->inputCount = (uint8_t) inputCount;
+    tc_memcpy_type_n(tickInputs->inputs, inputs, inputCount);
+    self->addedCount++;
+}
+
+const NlCheckpointTickInputs* nlCheckpointInputsGet(const NlCheckpointInputs* self, size_t ticksAgo)
+{
+    if (ticksAgo >= NL_CHECKPOINT_INPUT_COUNT || ticksAgo >= self->addedCount) {
+        return 0;
+    }
+
+    return &self->ticks[(self->addedCount - 1 - ticksAgo) % NL_CHECKPOINT_INPUT_COUNT];
+}
+
+static NlCheckpointCopy* slotCopies(const NlCheckpointFile* self, size_t slotIndex)
+{
+    CLOG_ASSERT(slotIndex < self->slotCount, "illegal checkpoint slot %zu", slotIndex)
+
+    return (NlCheckpointCopy*) (void*) (self->octets + CHECKPOINT_HEADER_OCTET_COUNT +
+                                        slotIndex * 2 * sizeof(NlCheckpointCopy));
+}
+
+static uint64_t matchHash(const NlCheckpointMatch* match)
+{
+    return nlSimulationVmCacheHash(match, sizeof(*match));
+}
+
+static bool isCopyIntact(const NlCheckpointCopy* copy)
+{
+    return copy->match.sequence != 0 && matchHash(&copy->match) == copy->hash;
+}
+
+/// Index of the newest copy that passes its hash, or -1 if neither does
+static int newestIntactCopyIndex(const NlCheckpointCopy* copies, size_t slotIndex)
+{
+    (void) slotIndex; // only logged
+    size_t newestIndex = copies[0].match.sequence >= copies[1].match.sequence ? 0 : 1;
+    size_t order[2] = {newestIndex, 1 - newestIndex};
+
+    for (size_t i = 0; i < 2; ++i) {
+        const NlCheckpointCopy* copy = &copies[order[i]];
+        if (copy->match.sequence == 0) {
+            continue;
+        }
+        if (isCopyIntact(copy)) {
+            return (int) order[i];
+        }
+        CLOG_WARN("checkpoint slot %zu has a broken copy with sequence %u", slotIndex, copy->match.sequence)
+    }
+
+    return -1;
+}
+
+#if defined NL_CHECKPOINT_USE_MMAP
+
+static size_t checkpointFileOctetCount(size_t slotCount)
+{
+    return CHECKPOINT_HEADER_OCTET_COUNT + slotCount * 2 * sizeof(NlCheckpointCopy);
+}
+
+/// Starts the write back of the pages covering the range, without waiting for it
+static void flushAsync(const NlCheckpointFile* self, const void* start, size_t octetCount)
+{
+    size_t offset = (size_t) ((const uint8_t*) start - self->octets);
+    size_t pageStart = offset - offset % self->pageOctetCount;
+    size_t end = offset + octetCount;
+
+    if (msync(self->octets + pageStart, end - pageStart, MS_ASYNC) != 0) {
+        CLOG_SOFT_ERROR("could not start writing back checkpoint")
+    }
+}
+
+static bool isHeaderValid(const NlCheckpointFileHeader* header, size_t slotCount)
+{
+    return header->magic == CHECKPOINT_MAGIC && header->version == CHECKPOINT_VERSION &&
+           header->slotCount == slotCount && header->gameOctetCount == sizeof(NlGame) &&
+           header->copyOctetCount == sizeof(NlCheckpointCopy);
+}
+
+int nlCheckpointFileOpen(NlCheckpointFile* self, const char* path, size_t slotCount)
+{
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+
+    int fileDescriptor = open(path, O_RDWR | O_CREAT, 0644);
+    if (fileDescriptor < 0) {
+        CLOG_SOFT_ERROR("could not open checkpoint file '%s'", path)
+        return -1;
+    }
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0) {
+        close(fileDescriptor);
+        return -2;
+    }
+
+    size_t octetCount = checkpointFileOctetCount(slotCount);
+    bool isNewFile = fileStat.st_size == 0;
+    if (isNewFile) {
+        // The file is sparse until the slots are written
+        if (ftruncate(fileDescriptor, (off_t) octetCount) != 0) {
+            CLOG_SOFT_ERROR("could not size checkpoint file '%s' to %zu octets", path, octetCount)
+            close(fileDescriptor);
+            return -3;
+        }
+    } else if ((size_t) fileStat.st_size != octetCount) {
+        CLOG_SOFT_ERROR("checkpoint file '%s' has the wrong size for %zu slots", path, slotCount)
+        close(fileDescriptor);
+        return -4;
+    }
+
+    void* mapping = mmap(0, octetCount, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        CLOG_SOFT_ERROR("could not map checkpoint file '%s'", path)
+        close(fileDescriptor);
+        return -5;
+    }
+
+    self->octets = (uint8_t*) mapping;
+    self->octetCount = octetCount;
+    self->slotCount = slotCount;
+    self->pageOctetCount = (size_t) sysconf(_SC_PAGESIZE);
+    self->fileDescriptor = fileDescriptor;
+
+    NlCheckpointFileHeader* header = (NlCheckpointFileHeader*) mapping;
+    if (isNewFile) {
+        header->magic = CHECKPOINT_MAGIC;
+        header->version = CHECKPOINT_VERSION;
+        header->slotCount = slotCount;
+        header->gameOctetCount = sizeof(NlGame);
+        header->copyOctetCount = sizeof(NlCheckpointCopy);
+        flushAsync(self, header, sizeof(*header));
+    } else if (!isHeaderValid(header, slotCount)) {
+        CLOG_SOFT_ERROR("checkpoint file '%s' was written by an incompatible version", path)
+        nlCheckpointFileClose(self);
+        return -6;
+    }
+
+    return 0;
+}
+
+void nlCheckpointFileClose(NlCheckpointFile* self)
+{
+    if (self->octets == 0) {
+        return;
+    }
+
+    msync(self->octets, self->octetCount, MS_SYNC);
+    munmap(self->octets, self->octetCount);
+    close(self->fileDescriptor);
+    self->octets = 0;
+    self->fileDescriptor = -1;
+}
+
+#else
+
+static void flushAsync(const NlCheckpointFile* self, const void* start, size_t octetCount)
+{
+    (void) self;
+    (void) start;
+    (void) octetCount;
+}
+
+int nlCheckpointFileOpen(NlCheckpointFile* self, const char* path, size_t slotCount)
+{
+    (void) path;
+    (void) slotCount;
+
+    tc_mem_clear_type(self);
+    self->fileDescriptor = -1;
+    CLOG_SOFT_ERROR("checkpoint files are not supported on this platform")
+
+    return -1;
+}
+
+void nlCheckpointFileClose(NlCheckpointFile* self)
+{
+    self->octets = 0;
+}
+
+#endif
+
+int nlCheckpointFileWrite(NlCheckpointFile* self, size_t slotIndex, uint64_t matchId, const NlSimulationVm* vm,
+                          const NlCheckpointInputs* inputs)
+{
+    if (self->octets == 0) {
+        return -1;
+    }
+
+    const NlRules* rules = nlRulesResolve(vm->game.rules);
+    if (rules == 0 || rules->tickRate.tickDurationMs != vm->tickDurationMs) {
+        CLOG_SOFT_ERROR("the game in slot %zu does not have registered rules for the vm", slotIndex)
+        return -2;
+    }
+
+    // Never overwrite the copy a crash recovery would read, even if the other copy has a higher sequence
+    NlCheckpointCopy* copies = slotCopies(self, slotIndex);
+    int intactIndex = newestIntactCopyIndex(copies, slotIndex);
+    uint32_t sequence0 = copies[0].match.sequence;
+    uint32_t sequence1 = copies[1].match.sequence;
+    NlCheckpointCopy* target;
+    if (intactIndex < 0) {
+        target = sequence0 <= sequence1 ? &copies[0] : &copies[1];
+    } else {
+        target = &copies[1 - intactIndex];
+    }
+
+    // Assembled and hashed locally, so the padding octets are the same in the hash and in the file
+    NlCheckpointMatch match;
+    tc_mem_clear_type(&match);
+    match.matchId = matchId;
+    match.sequence = (sequence0 > sequence1 ? sequence0 : sequence1) + 1;
+    match.tickDurationMs = vm->tickDurationMs;
+    match.ruleset = rules->ruleset;
+    match.game = vm->game;
+    match.inputs = *inputs;
+
+    uint64_t hash = matchHash(&match);
+    tc_memcpy_octets(&target->match, &match, sizeof(match));
+    target->hash = hash;
+    flushAsync(self, target, sizeof(*target));
+
+    return 0;
+}
+
+void nlCheckpointFileClearSlot(NlCheckpointFile* self, size_t slotIndex)
+{
+    if (self->octets == 0) {
+        return;
+    }
+
+    NlCheckpointCopy* copies = slotCopies(self, slotIndex);
+    for (size_t i = 0; i < 2; ++i) {
+        copies[i].match.sequence = 0;
+        flushAsync(self, &copies[i].match.sequence, sizeof(copies[i].match.sequence));
+    }
+}
+
+bool nlCheckpointFileRead(const NlCheckpointFile* self, size_t slotIndex, NlCheckpointMatch* target)
+{
+    if (self->octets == 0) {
+        return false;
+    }
+
+    const NlCheckpointCopy* copies = slotCopies(self, slotIndex);
+    int intactIndex = newestIntactCopyIndex(copies, slotIndex);
+    if (intactIndex < 0) {
+        return false;
+    }
+
+    tc_memcpy_octets(target, &copies[intactIndex].match, sizeof(*target));
+
+    return true;
+}
+
+int nlCheckpointMatchRestoreVm(const NlCheckpointMatch* self, NlSimulationVm* vm, Clog log)
+{
+    NlRulesRef rules = nlRulesRegisterStored(&self->ruleset, self->tickDurationMs);
+    if (nlRulesResolve(rules) == 0) {
+        CLOG_SOFT_ERROR("the rules of match %llu could not be registered", (unsigned long long) self->matchId)
+        return -1;
+    }
+
+    nlSimulationVmInitWithTickDuration(vm, self->tickDurationMs, log);
+    vm->game = self->game;
+    vm->game.rules = rules;
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <nimble-ball-simulation/nimble_ball_simulation_input_predictor.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define NL_BUTTON_KICK (0x01)
+#define NL_BUTTON_SLIDE_TACKLE (0x02)
+
+static int8_t decayAxis(int8_t axis)
+{
+    return (int8_t) ((axis * 3) / 4);
+}
+
+NlPlayerInput nlInputPredictionStep(NlInputPredictionPolicy policy, const NlPlayerInput* previous)
+{
+    NlPlayerInput predicted;
+
+    if (policy == NlInputPredictionPolicyForced || previous->inputType != NlPlayerInputTypeInGame) {
+        tc_mem_clear_type(&predicted);
+        predicted.inputType = NlPlayerInputTypeForced;
+        return predicted;
+    }
+
+    predicted = *previous;
+    NlPlayerInGameInput* inGameInput = &predicted.input.inGameInput;
+
+    switch (policy) {
+        case NlInputPredictionPolicyHoldLast:
+        case NlInputPredictionPolicyForced:
+            break;
+        case NlInputPredictionPolicyDecayToNeutral:
+            inGameInput->horizontalAxis = decayAxis(inGameInput->horizontalAxis);
+            inGameInput->verticalAxis = decayAxis(inGameInput->verticalAxis);
+            inGameInput->buttons &= (uint8_t) ~NL_BUTTON_SLIDE_TACKLE;
+            break;
+        case NlInputPredictionPolicyReleaseSlideTackle:
+            // Releasing the kick button performs the kick, so keep charging.
+            // A slide tackle is triggered on press, repeating it is almost always wrong.
+            inGameInput->buttons &= (uint8_t) ~NL_BUTTON_SLIDE_TACKLE;
+            break;
+    }
+
+    return predicted;
+}
+
+void nlInputPredictorInit(NlInputPredictor* self, NlInputPredictionPolicy policy)
+{
+    tc_mem_clear_type(self);
+    self->policy = policy;
+}
+
+/// Participant ids come from the network, returns NULL for illegal ones
+static NlInputPredictorParticipant* participantFromId(NlInputPredictor* self, uint8_t participantId)
+{
+    if (participantId >= NL_MAX_PARTICIPANTS) {
+        CLOG_SOFT_ERROR("illegal participant id %hhu", participantId)
+        return 0;
+    }
+    return &self->participants[participantId];
+}
+
+NlPlayerInput nlInputPredictorPredict(NlInputPredictor* self, uint8_t participantId, uint32_t tickId)
+{
+    NlInputPredictorParticipant* participant = participantFromId(self, participantId);
+
+    NlPlayerInput predicted;
+    if (participant == 0 || !participant->hasConfirmedInput) {
+        tc_mem_clear_type(&predicted);
+        predicted.inputType = NlPlayerInputTypeForced;
+        if (participant == 0) {
+            return predicted;
+        }
+    } else {
+        predicted = participant->lastConfirmedInput;
+        uint32_t stepCount = tickId > participant->lastConfirmedTickId ? tickId - participant->lastConfirmedTickId : 0;
+        if (stepCount > NL_INPUT_PREDICTOR_WINDOW) {
+            stepCount = NL_INPUT_PREDICTOR_WINDOW;
+        }
+        for (uint32_t i = 0; i < stepCount; ++i) {
+            predicted = nlInputPredictionStep(self->policy, &predicted);
+        }
+    }
+
+    NlInputPrediction* prediction = &participant->predictions[tickId % NL_INPUT_PREDICTOR_WINDOW];
+    prediction->tickId = tickId;
+    prediction->input = predicted;
+    prediction->isValid = true;
+
+    if (participant->stats.predictionCount == 0 || tickId > participant->latestPredictedTickId) {
+        participant->latestPredictedTickId = tickId;
+    }
+    participant->stats.predictionCount++;
+
+    return predicted;
+}
+
+bool nlInputPredictorConfirm(NlInputPredictor* self, uint8_t participantId, uint32_t tickId,
+                             const NlPlayerInput* actualInput)
+{
+    NlInputPredictorParticipant* participant = participantFromId(self, participantId);
+    if (participant == 0) {
+        return false;
+    }
+
+    if (!participant->hasConfirmedInput || tickId >= participant->lastConfirmedTickId) {
+        participant->lastConfirmedInput = *actualInput;
+        participant->lastConfirmedTickId = tickId;
+        participant->hasConfirmedInput = true;
+    }
+
+    NlInputPrediction* prediction = &participant->predictions[tickId % NL_INPUT_PREDICTOR_WINDOW];
+    if (!prediction->isValid || prediction->tickId != tickId) {
+        return false;
+    }
+    prediction->isValid = false;
+    participant->stats.confirmedCount++;
+
+    if (nlPlayerInputIsEqual(&prediction->input, actualInput)) {
+        return false;
+    }
+
+    // Everything from the mispredicted tick up to the latest predicted tick must be resimulated
+    size_t rollbackDepth = participant->latestPredictedTickId - tickId + 1;
+    participant->stats.mispredictionCount++;
+    participant->stats.rollbackDepthSum += rollbackDepth;
+    if (rollbackDepth > participant->stats.maxRollbackDepth) {
+        participant->stats.maxRollbackDepth = rollbackDepth;
+    }
+
+    return true;
+}
+
+float nlInputPredictorMispredictionRate(const NlInputPredictor* self, uint8_t participantId)
+{
+    if (participantId >= NL_MAX_PARTICIPANTS) {
+        return 0.0f;
+    }
+
+    const NlInputPredictorStats* stats = &self->participants[participantId].stats;
+    if (stats->confirmedCount == 0) {
+        return 0.0f;
+    }
+
+    return (float) stats->mispredictionCount / (float) stats->confirmedCount;
+}
@@ -0,0 +1,133 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <nimble-ball-simulation/nimble_ball_simulation_input_queue.h>
+
+void nlInputQueueInit(NlInputQueue* self)
+{
+    self->writeIndex = 0;
+    self->readIndex = 0;
+    self->droppedCount = 0;
+}
+
+bool nlInputQueuePush(NlInputQueue* self, const NlInputQueueEntry* entry)
+{
+    uint32_t writeIndex = nlAtomicLoadRelaxed(&self->writeIndex);
+    uint32_t readIndex = nlAtomicLoadAcquire(&self->readIndex);
+    if (writeIndex - readIndex >= NL_INPUT_QUEUE_CAPACITY) {
+        nlAtomicFetchAdd(&self->droppedCount, 1);
+        return false;
+    }
+
+    self->entries[writeIndex % NL_INPUT_QUEUE_CAPACITY] = *entry;
+    nlAtomicStoreRelease(&self->writeIndex, writeIndex + 1);
+
+    return true;
+}
+
+bool nlInputQueuePop(NlInputQueue* self, NlInputQueueEntry* entry)
+{
+    uint32_t readIndex = nlAtomicLoadRelaxed(&self->readIndex);
+    uint32_t writeIndex = nlAtomicLoadAcquire(&self->writeIndex);
+    if (readIndex == writeIndex) {
+        return false;
+    }
+
+    *entry = self->entries[readIndex % NL_INPUT_QUEUE_CAPACITY];
+    nlAtomicStoreRelease(&self->readIndex, readIndex + 1);
+
+    return true;
+}
+
+void nlInputAssemblyInit(NlInputAssembly* self, uint32_t firstTickId)
+{
+    tc_mem_clear_type(self);
+    self->nextTickId = firstTickId;
+}
+
+static void receiveEntry(NlInputAssembly* self, const NlInputQueueEntry* entry)
+{
+    if (entry->participantId >= NL_MAX_PARTICIPANTS) {
+        CLOG_SOFT_ERROR("illegal participant id %hhu", entry->participantId)
+        return;
+    }
+
+    NlInputAssemblyParticipant* participant = &self->participants[entry->participantId];
+
+    switch (entry->entryType) {
+        case NlInputQueueEntryTypeLeft:
+            participant->isUsed = false;
+            return;
+        case NlInputQueueEntryTypeWaitingForReconnect:
+            participant->isUsed = true;
+            participant->isWaitingForReconnect = true;
+            return;
+        default:
+            break;
+    }
+
+    if (entry->tickId < self->nextTickId) {
+        // The tick has already been assembled without it
+        self->stats.lateCount++;
+        return;
+    }
+
+    if (entry->tickId - self->nextTickId >= NL_INPUT_ASSEMBLY_WINDOW) {
+        self->stats.tooEarlyCount++;
+        return;
+    }
+
+    size_t slotIndex = entry->tickId % NL_INPUT_ASSEMBLY_WINDOW;
+    participant->isUsed = true;
+    participant->isWaitingForReconnect = false;
+    participant->inputs[slotIndex] = entry->playerInput;
+    participant->tickIds[slotIndex] = entry->tickId;
+    participant->hasInput[slotIndex] = true;
+}
+
+uint32_t nlInputAssemblyNextTick(NlInputAssembly* self, NlInputQueue* queue, TransmuteInput* target)
+{
+    NlInputQueueEntry entry;
+    while (nlInputQueuePop(queue, &entry)) {
+        receiveEntry(self, &entry);
+    }
+
+    uint32_t tickId = self->nextTickId++;
+    size_t slotIndex = tickId % NL_INPUT_ASSEMBLY_WINDOW;
+    size_t participantCount = 0;
+
+    for (size_t i = 0; i < NL_MAX_PARTICIPANTS; ++i) {
+        NlInputAssemblyParticipant* participant = &self->participants[i];
+        if (!participant->isUsed) {
+            continue;
+        }
+
+        TransmuteParticipantInput* participantInput = &self->participantInputs[participantCount++];
+        participantInput->participantId = (uint8_t) i;
+
+        if (participant->hasInput[slotIndex] && participant->tickIds[slotIndex] == tickId) {
+            participant->hasInput[slotIndex] = false;
+            participantInput->inputType = TransmuteParticipantInputTypeNormal;
+            participantInput->input = &participant->inputs[slotIndex];
+            participantInput->octetSize = sizeof(NlPlayerInput);
+            continue;
+        }
+
+        participantInput->input = 0;
+        participantInput->octetSize = 0;
+        if (participant->isWaitingForReconnect) {
+            participantInput->inputType = TransmuteParticipantInputTypeWaitingForReconnect;
+        } else {
+            participantInput->inputType = TransmuteParticipantInputTypeNoInputInTime;
+            self->stats.missingCount++;
+        }
+    }
+
+    target->participantInputs = self->participantInputs;
+    target->participantCount = participantCount;
+    self->stats.assembledTickCount++;
+
+    return tickId;
+}
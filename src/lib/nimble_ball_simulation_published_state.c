@@ -0,0 +1,87 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <nimble-ball-simulation/nimble_ball_simulation_published_state.h>
+#include <tiny-libc/tiny_libc.h>
+
+void nlPublishedStateInit(NlPublishedState* self)
+{
+    for (size_t i = 0; i < NL_PUBLISHED_STATE_BUFFER_COUNT; ++i) {
+        self->buffers[i].sequence = 0;
+    }
+    self->latestIndex = 0;
+    self->publishCount = 0;
+}
+
+// The words are accessed with relaxed atomics since readers race with the writer on purpose,
+// the sequence counter tells the reader if the copy is torn.
+
+static void writeWords(NlPublishedStateBuffer* buffer, const NlGame* game)
+{
+    const uint8_t* source = (const uint8_t*) game;
+    size_t octetsLeft = sizeof(NlGame);
+
+    for (size_t i = 0; i < NL_PUBLISHED_STATE_WORD_COUNT; ++i) {
+        uint32_t word = 0;
+        size_t octetCount = octetsLeft < sizeof(word) ? octetsLeft : sizeof(word);
+        tc_memcpy_octets(&word, &source[i * sizeof(word)], octetCount);
+        nlAtomicStoreRelaxed(&buffer->words[i], word);
+        octetsLeft -= octetCount;
+    }
+}
+
+static void readWords(const NlPublishedStateBuffer* buffer, NlGame* game)
+{
+    uint8_t* target = (uint8_t*) game;
+    size_t octetsLeft = sizeof(NlGame);
+
+    for (size_t i = 0; i < NL_PUBLISHED_STATE_WORD_COUNT; ++i) {
+        uint32_t word = nlAtomicLoadRelaxed(&buffer->words[i]);
+        size_t octetCount = octetsLeft < sizeof(word) ? octetsLeft : sizeof(word);
+        tc_memcpy_octets(&target[i * sizeof(word)], &word, octetCount);
+        octetsLeft -= octetCount;
+    }
+}
+
+void nlPublishedStatePublish(NlPublishedState* self, const NlGame* game)
+{
+    // Write to the buffer after the latest one, readers of the latest buffer are not disturbed
+    uint32_t index = (nlAtomicLoadRelaxed(&self->latestIndex) + 1) % NL_PUBLISHED_STATE_BUFFER_COUNT;
+    NlPublishedStateBuffer* buffer = &self->buffers[index];
+
+    uint32_t sequence = nlAtomicLoadRelaxed(&buffer->sequence);
+    nlAtomicStoreRelaxed(&buffer->sequence, sequence + 1);
+    nlAtomicFenceRelease();
+
+    writeWords(buffer, game);
+
+    nlAtomicStoreRelease(&buffer->sequence, sequence + 2);
+    nlAtomicStoreRelease(&self->latestIndex, index);
+    nlAtomicStoreRelease(&self->publishCount, nlAtomicLoadRelaxed(&self->publishCount) + 1);
+}
+
+bool nlPublishedStateRead(NlPublishedState* self, NlGame* target)
+{
+    if (nlAtomicLoadAcquire(&self->publishCount) == 0) {
+        return false;
+    }
+
+    for (;;) {
+        uint32_t index = nlAtomicLoadAcquire(&self->latestIndex);
+        const NlPublishedStateBuffer* buffer = &self->buffers[index];
+
+        uint32_t sequenceBefore = nlAtomicLoadAcquire(&buffer->sequence);
+        if ((sequenceBefore & 1u) != 0) {
+            continue;
+        }
+
+        readWords(buffer, target);
+
+        nlAtomicFenceAcquire();
+        if (nlAtomicLoadRelaxed(&buffer->sequence) == sequenceBefore) {
+            return true;
+        }
+    }
+}
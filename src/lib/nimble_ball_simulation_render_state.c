@@ -0,0 +1,96 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <basal/math.h>
+#include <math.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_render_state.h>
+
+typedef struct NlRenderInterpolation {
+    float fromX[NL_MAX_PLAYERS];
+    float fromY[NL_MAX_PLAYERS];
+    float fromRotation[NL_MAX_PLAYERS];
+    float toX[NL_MAX_PLAYERS];
+    float toY[NL_MAX_PLAYERS];
+    float toRotation[NL_MAX_PLAYERS];
+    float alpha[NL_MAX_PLAYERS]; ///< 1 for avatars that should snap to `to`
+} NlRenderInterpolation;
+
+static float lerp(float a, float b, float alpha)
+{
+    return a + (b - a) * alpha;
+}
+
+// Branch free, so the compiler can vectorize the loop over all the slots. Inactive slots are interpolated as well,
+// the active mask tells the caller which ones to use.
+static void interpolate(NlRenderState* self, const NlRenderInterpolation* interpolation)
+{
+    const float fullTurn = 2.0f * BL_PI;
+    const float inverseFullTurn = 1.0f / fullTurn;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        float alpha = interpolation->alpha[i];
+        self->avatarX[i] = lerp(interpolation->fromX[i], interpolation->toX[i], alpha);
+        self->avatarY[i] = lerp(interpolation->fromY[i], interpolation->toY[i], alpha);
+
+        float diff = interpolation->toRotation[i] - interpolation->fromRotation[i];
+        diff -= fullTurn * floorf(diff * inverseFullTurn + 0.5f);
+        float rotation = interpolation->fromRotation[i] + diff * alpha;
+        self->avatarRotation[i] = rotation - fullTurn * floorf(rotation * inverseFullTurn + 0.5f);
+    }
+}
+
+void nlRenderStateInterpolate(NlRenderState* self, const NlGame* from, const NlGame* to, float alpha)
+{
+    NlRenderInterpolation interpolation;
+    NlSlotMask sameAvatarMask = from->avatars.activeMask & to->avatars.activeMask;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        const NlAvatar* fromAvatar = &from->avatars.avatars[i];
+        const NlAvatar* toAvatar = &to->avatars.avatars[i];
+        bool isSameAvatar = (sameAvatarMask & (1u << i)) != 0 && fromAvatar->generation == toAvatar->generation;
+
+        interpolation.fromX[i] = fromAvatar->circle.center.x;
+        interpolation.fromY[i] = fromAvatar->circle.center.y;
+        interpolation.fromRotation[i] = fromAvatar->visualRotation;
+        interpolation.toX[i] = toAvatar->circle.center.x;
+        interpolation.toY[i] = toAvatar->circle.center.y;
+        interpolation.toRotation[i] = toAvatar->visualRotation;
+        interpolation.alpha[i] = isSameAvatar ? alpha : 1.0f;
+    }
+
+    interpolate(self, &interpolation);
+
+    self->activeMask = to->avatars.activeMask;
+    self->ballPosition.x = lerp(from->ball.circle.center.x, to->ball.circle.center.x, alpha);
+    self->ballPosition.y = lerp(from->ball.circle.center.y, to->ball.circle.center.y, alpha);
+}
+
+void nlRenderStateInterpolateSpectator(NlRenderState* self, const NlSpectatorState* from, const NlSpectatorState* to,
+                                       float alpha)
+{
+    NlRenderInterpolation interpolation;
+    NlSlotMask sameAvatarMask = from->activeMask & to->activeMask;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        bool isActive = (to->activeMask & (1u << i)) != 0;
+        bool isSameAvatar = (sameAvatarMask & (1u << i)) != 0;
+        // Inactive slots in the spectator state are not initialized
+        const NlSpectatorAvatar* toAvatar = &to->avatars[i];
+        const NlSpectatorAvatar* fromAvatar = isSameAvatar ? &from->avatars[i] : toAvatar;
+
+        interpolation.fromX[i] = isActive ? fromAvatar->position.x : 0.0f;
+        interpolation.fromY[i] = isActive ? fromAvatar->position.y : 0.0f;
+        interpolation.fromRotation[i] = isActive ? fromAvatar->visualRotation : 0.0f;
+        interpolation.toX[i] = isActive ? toAvatar->position.x : 0.0f;
+        interpolation.toY[i] = isActive ? toAvatar->position.y : 0.0f;
+        interpolation.toRotation[i] = isActive ? toAvatar->visualRotation : 0.0f;
+        interpolation.alpha[i] = isSameAvatar ? alpha : 1.0f;
+    }
+
+    interpolate(self, &interpolation);
+
+    self->activeMask = to->activeMask;
+    self->ballPosition.x = lerp(from->ballPosition.x, to->ballPosition.x, alpha);
+    self->ballPosition.y = lerp(from->ballPosition.y, to->ballPosition.y, alpha);
+}
@@ -0,0 +1,286 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vm_cache.h>
+#include <stddef.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define REPLAY_MAGIC (0x4E4C5250u) // "NLRP"
+#define REPLAY_VERSION (2u)
+#define REPLAY_HEADER_OCTET_COUNT (128)
+
+typedef struct NlReplayHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t gameOctetCount;
+    uint64_t tickOctetCount;
+    uint64_t tickCount;
+    uint64_t keyframeCount;
+    uint16_t tickDurationMs;
+    NlRuleset ruleset;
+} NlReplayHeader;
+
+uint64_t nlReplayHashGame(const NlGame* game)
+{
+    // The rules id is local to the process, the rules themselves are in the replay header. It is the last field.
+    return nlSimulationVmCacheHash(game, offsetof(NlGame, rules));
+}
+
+size_t nlReplayOctetCount(const NlReplay* self)
+{
+    return REPLAY_HEADER_OCTET_COUNT + self->tickCount * sizeof(NlReplayTick) +
+           self->keyframeCount * sizeof(NlReplayKeyframe);
+}
+
+int nlReplayWrite(const NlReplay* self, uint8_t* target, size_t maxOctetCount)
+{
+    size_t octetCount = nlReplayOctetCount(self);
+    if (octetCount > maxOctetCount) {
+        CLOG_SOFT_ERROR("replay target is too small %zu, needs %zu", maxOctetCount, octetCount)
+        return -1;
+    }
+
+    const NlRules* rules = nlRulesResolve(self->rules);
+    if (rules == 0) {
+        CLOG_SOFT_ERROR("replay has rules %d that are not registered", self->rules.id)
+        return -2;
+    }
+
+    NlReplayHeader header;
+    tc_mem_clear_type(&header);
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.gameOctetCount = sizeof(NlGame);
+    header.tickOctetCount = sizeof(NlReplayTick);
+    header.tickCount = self->tickCount;
+    header.keyframeCount = self->keyframeCount;
+    header.tickDurationMs = rules->tickRate.tickDurationMs;
+    header.ruleset = rules->ruleset;
+
+    tc_mem_clear(target, REPLAY_HEADER_OCTET_COUNT);
+    tc_memcpy_octets(target, &header, sizeof(header));
+    size_t pos = REPLAY_HEADER_OCTET_COUNT;
+    tc_memcpy_octets(&target[pos], self->ticks, self->tickCount * sizeof(NlReplayTick));
+    pos += self->tickCount * sizeof(NlReplayTick);
+    tc_memcpy_octets(&target[pos], self->keyframes, self->keyframeCount * sizeof(NlReplayKeyframe));
+
+    return (int) octetCount;
+}
+
+int nlReplayRead(NlReplay* target, const uint8_t* octets, size_t octetCount)
+{
+    if (octetCount < REPLAY_HEADER_OCTET_COUNT) {
+        CLOG_SOFT_ERROR("replay is too short %zu", octetCount)
+        return -1;
+    }
+
+    NlReplayHeader header;
+    tc_memcpy_octets(&header, octets, sizeof(header));
+    if (header.magic != REPLAY_MAGIC || header.version != REPLAY_VERSION || header.gameOctetCount != sizeof(NlGame) ||
+        header.tickOctetCount != sizeof(NlReplayTick)) {
+        CLOG_SOFT_ERROR("replay was written by an incompatible version")
+        return -2;
+    }
+
+    if (header.tickDurationMs < NL_MIN_TICK_DURATION_MS || header.tickDurationMs > NL_MAX_TICK_DURATION_MS) {
+        CLOG_SOFT_ERROR("replay has an unsupported tick duration %hu ms", header.tickDurationMs)
+        return -6;
+    }
+    // Keyframes keep the rules id of the recording process, they are played with these rules instead
+    target->rules = nlRulesRegisterStored(&header.ruleset, header.tickDurationMs);
+    if (nlRulesResolve(target->rules) == 0) {
+        CLOG_SOFT_ERROR("replay rules could not be registered")
+        return -6;
+    }
+
+    target->tickCount = (size_t) header.tickCount;
+    target->keyframeCount = (size_t) header.keyframeCount;
+    if (nlReplayOctetCount(target) != octetCount) {
+        CLOG_SOFT_ERROR("replay has the wrong size %zu", octetCount)
+        return -3;
+    }
+
+    target->ticks = (const NlReplayTick*) (const void*) &octets[REPLAY_HEADER_OCTET_COUNT];
+    target->keyframes = (const NlReplayKeyframe*) (const void*) &octets[REPLAY_HEADER_OCTET_COUNT +
+                                                                        target->tickCount * sizeof(NlReplayTick)];
+
+    // Verification and analytics resimulate from keyframe zero
+    if (target->tickCount > 0 && target->keyframeCount == 0) {
+        CLOG_SOFT_ERROR("replay has %zu ticks, but no keyframe to start from", target->tickCount)
+        return -4;
+    }
+
+    uint32_t nextTickIndex = 0;
+    for (size_t i = 0; i < target->keyframeCount; ++i) {
+        uint32_t tickIndex = target->keyframes[i].tickIndex;
+        if (tickIndex < nextTickIndex || tickIndex >= target->tickCount || (i == 0 && tickIndex != 0)) {
+            CLOG_SOFT_ERROR("replay keyframe %zu has an illegal tick %u", i, tickIndex)
+            return -4;
+        }
+        nextTickIndex = tickIndex + 1;
+    }
+
+    for (size_t i = 0; i < target->tickCount; ++i) {
+        if (target->ticks[i].inputCount > NL_MAX_PARTICIPANTS) {
+            CLOG_SOFT_ERROR("replay tick %zu has too many inputs", i)
+            return -5;
+        }
+    }
+
+    return 0;
+}
+
+void nlReplayRecorderInit(NlReplayRecorder* self, NlReplayTick* ticks, size_t tickCapacity,
+                          NlReplayKeyframe* keyframes, size_t keyframeCapacity, size_t keyframeInterval)
+{
+    CLOG_ASSERT(keyframeInterval > 0, "keyframe interval must be at least one tick")
+
+    self->ticks = ticks;
+    self->tickCapacity = tickCapacity;
+    self->tickCount = 0;
+    self->keyframes = keyframes;
+    self->keyframeCapacity = keyframeCapacity;
+    self->keyframeCount = 0;
+    self->keyframeInterval = keyframeInterval;
+    self->rules = nlRulesRegister(&g_nlDefaultRuleset, NL_DEFAULT_TICK_DURATION_MS);
+}
+
+bool nlReplayRecorderTick(NlReplayRecorder* self, NlGame* game, const NlPlayerInputWithParticipantInfo* inputs,
+                          size_t inputCount)
+{
+    CLOG_ASSERT(inputCount <= NL_MAX_PARTICIPANTS, "too many inputs %zu", inputCount)
+
+    bool needsKeyframe = self->tickCount % self->keyframeInterval == 0;
+    if (self->tickCount == self->tickCapacity || (needsKeyframe && self->keyframeCount == self->keyframeCapacity)) {
+        return false;
+    }
+
+    self->rules = game->rules;
+    if (needsKeyframe) {
+        NlReplayKeyframe* keyframe = &self->keyframes[self->keyframeCount++];
+        tc_mem_clear_type(keyframe);
+        keyframe->tickIndex = (uint32_t) self->tickCount;
+        keyframe->game = *game;
+    }
+
+    nlGameTick(game, inputs, inputCount, 0);
+
+    NlReplayTick* tick = &self->ticks[self->tickCount++];
+    tc_mem_clear_type(tick);
+    tick->stateHash = nlReplayHashGame(game);
+    tick->inputCount = (uint8_t) inputCount;
+    tc_memcpy_type_n(tick->inputs, inputs, inputCount);
+
+    return true;
+}
+
+void nlReplayRecorderReplay(const NlReplayRecorder* self, NlReplay* target)
+{
+    target->ticks = self->ticks;
+    target->tickCount = self->tickCount;
+    target->keyframes = self->keyframes;
+    target->keyframeCount = self->keyframeCount;
+    target->rules = self->rules;
+}
+
+size_t nlReplayVerifierSegmentCount(const NlReplay* replays, size_t replayCount)
+{
+    size_t segmentCount = 0;
+    for (size_t i = 0; i < replayCount; ++i) {
+        segmentCount += replays[i].keyframeCount;
+    }
+
+    return segmentCount;
+}
+
+void nlReplayVerifierInit(NlReplayVerifier* self, const NlReplay* replays, size_t replayCount,
+                          NlReplaySegment* segments, size_t segmentCapacity)
+{
+    size_t segmentCount = nlReplayVerifierSegmentCount(replays, replayCount);
+    CLOG_ASSERT(segmentCount <= segmentCapacity, "replay verifier needs %zu segments", segmentCount)
+    (void) segmentCapacity;
+
+    size_t segmentIndex = 0;
+    for (size_t replayIndex = 0; replayIndex < replayCount; ++replayIndex) {
+        for (size_t keyframeIndex = 0; keyframeIndex < replays[replayIndex].keyframeCount; ++keyframeIndex) {
+            NlReplaySegment* segment = &segments[segmentIndex++];
+            segment->replayIndex = (uint32_t) replayIndex;
+            segment->keyframeIndex = (uint32_t) keyframeIndex;
+            segment->firstMismatchTick = NL_REPLAY_NO_MISMATCH;
+        }
+    }
+
+    self->replays = replays;
+    self->replayCount = replayCount;
+    self->segments = segments;
+    self->segmentCount = segmentCount;
+    self->claimIndex = 0;
+    self->verifiedTickCount = 0;
+}
+
+static size_t segmentEndTick(const NlReplay* replay, size_t keyframeIndex)
+{
+    return keyframeIndex + 1 < replay->keyframeCount ? replay->keyframes[keyframeIndex + 1].tickIndex
+                                                     : replay->tickCount;
+}
+
+static uint32_t verifySegment(const NlReplay* replay, size_t keyframeIndex)
+{
+    const NlReplayKeyframe* keyframe = &replay->keyframes[keyframeIndex];
+    size_t firstTick = keyframe->tickIndex;
+    size_t endTick = segmentEndTick(replay, keyframeIndex);
+
+    if (firstTick > 0 && nlReplayHashGame(&keyframe->game) != replay->ticks[firstTick - 1].stateHash) {
+        return (uint32_t) firstTick;
+    }
+
+    NlGame game = keyframe->game;
+    game.rules = replay->rules;
+    for (size_t tickIndex = firstTick; tickIndex < endTick; ++tickIndex) {
+        const NlReplayTick* tick = &replay->ticks[tickIndex];
+        nlGameTick(&game, tick->inputs, tick->inputCount, 0);
+        if (nlReplayHashGame(&game) != tick->stateHash) {
+            return (uint32_t) tickIndex;
+        }
+    }
+
+    return NL_REPLAY_NO_MISMATCH;
+}
+
+bool nlReplayVerifierVerifyNext(NlReplayVerifier* self)
+{
+    uint32_t claimIndex = nlAtomicFetchAdd(&self->claimIndex, 1);
+    if (claimIndex >= self->segmentCount) {
+        return false;
+    }
+
+    NlReplaySegment* segment = &self->segments[claimIndex];
+    const NlReplay* replay = &self->replays[segment->replayIndex];
+    segment->firstMismatchTick = verifySegment(replay, segment->keyframeIndex);
+
+    size_t firstTick = replay->keyframes[segment->keyframeIndex].tickIndex;
+    size_t endTick = segmentEndTick(replay, segment->keyframeIndex);
+    if (segment->firstMismatchTick != NL_REPLAY_NO_MISMATCH) {
+        endTick = segment->firstMismatchTick + 1u;
+    }
+    nlAtomicFetchAdd(&self->verifiedTickCount, (uint32_t) (endTick - firstTick));
+
+    return true;
+}
+
+uint32_t nlReplayVerifierFirstMismatch(const NlReplayVerifier* self, size_t replayIndex)
+{
+    // Segments are in tick order within a replay, so the first mismatching segment has the first mismatch
+    for (size_t i = 0; i < self->segmentCount; ++i) {
+        const NlReplaySegment* segment = &self->segments[i];
+        if (segment->replayIndex == replayIndex && segment->firstMismatchTick != NL_REPLAY_NO_MISMATCH) {
+            return segment->firstMismatchTick;
+        }
+    }
+
+    return NL_REPLAY_NO_MISMATCH;
+}
@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay_analytics.h>
+#include <tiny-libc/tiny_libc.h>
+
+void nlReplayAnalyticsInit(NlReplayAnalytics* self, size_t replayCount, NlReplayAnalyticsCallbacks callbacks)
+{
+    CLOG_ASSERT(callbacks.load != 0, "replay analytics needs a load function")
+
+    self->callbacks = callbacks;
+    self->replayCount = replayCount;
+    self->claimIndex = 0;
+    self->skippedCount = 0;
+}
+
+void nlReplayAnalyticsWorkerInit(NlReplayAnalyticsWorker* self, NlReplayAnalytics* analytics, void* aggregate)
+{
+    self->analytics = analytics;
+    self->aggregate = aggregate;
+    self->simulatedTickCount = 0;
+    self->matchCount = 0;
+}
+
+static void simulateReplay(NlReplayAnalyticsWorker* self, size_t replayIndex, const NlReplay* replay)
+{
+    const NlReplayAnalyticsCallbacks* callbacks = &self->analytics->callbacks;
+
+    NlGameEvents events;
+    nlGameEventsInit(&events, self->eventBuffer, NL_REPLAY_ANALYTICS_EVENT_CAPACITY);
+    NlMatchStats stats;
+    nlMatchStatsInit(&stats);
+
+    NlGameTickOutput output;
+    tc_mem_clear_type(&output);
+    output.events = &events;
+    output.stats = &stats;
+
+    NlGame game = replay->keyframes[0].game;
+    game.rules = replay->rules;
+    for (size_t tickIndex = 0; tickIndex < replay->tickCount; ++tickIndex) {
+        const NlReplayTick* tick = &replay->ticks[tickIndex];
+        nlGameEventsClear(&events);
+        nlGameTickWithOutput(&game, tick->inputs, tick->inputCount, &output, 0);
+        if (callbacks->tick != 0) {
+            callbacks->tick(callbacks->userData, self->aggregate, replayIndex, (uint32_t) tickIndex, &game, &events);
+        }
+    }
+
+    if (callbacks->match != 0) {
+        callbacks->match(callbacks->userData, self->aggregate, replayIndex, &game, &stats);
+    }
+
+    self->simulatedTickCount += replay->tickCount;
+    self->matchCount++;
+}
+
+bool nlReplayAnalyticsWorkerProcessNext(NlReplayAnalyticsWorker* self)
+{
+    NlReplayAnalytics* analytics = self->analytics;
+    uint32_t replayIndex = nlAtomicFetchAdd(&analytics->claimIndex, 1);
+    if (replayIndex >= analytics->replayCount) {
+        return false;
+    }
+
+    const NlReplayAnalyticsCallbacks* callbacks = &analytics->callbacks;
+    NlReplay replay;
+    tc_mem_clear_type(&replay);
+    if (!callbacks->load(callbacks->userData, replayIndex, &replay)) {
+        nlAtomicFetchAdd(&analytics->skippedCount, 1);
+        return true;
+    }
+
+    // The match is resimulated from the start, so it needs the keyframe at tick zero
+    if (replay.keyframeCount == 0) {
+        CLOG_SOFT_ERROR("replay %u has no keyframe to start from", replayIndex)
+        nlAtomicFetchAdd(&analytics->skippedCount, 1);
+    } else {
+        simulateReplay(self, replayIndex, &replay);
+    }
+
+    if (callbacks->release != 0) {
+        callbacks->release(callbacks->userData, replayIndex, &replay);
+    }
+
+    return true;
+}
@@ -0,0 +1,129 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot.h>
+#include <tiny-libc/tiny_libc.h>
+
+static int encodeFull(const NlGame* game, uint8_t* target, size_t maxOctetCount)
+{
+    if (maxOctetCount < NL_SNAPSHOT_MAX_OCTET_COUNT) {
+        CLOG_SOFT_ERROR("snapshot target is too small %zu", maxOctetCount)
+        return -1;
+    }
+
+    target[0] = NlSnapshotTypeFull;
+    tc_memcpy_octets(&target[1], game, sizeof(NlGame));
+
+    return (int) NL_SNAPSHOT_MAX_OCTET_COUNT;
+}
+
+// Delta is a sequence of [skip count][changed count][changed octets...] against the baseline. Trailing unchanged
+// octets are not written.
+static int encodeDelta(const NlGame* game, const NlGame* baseline, uint8_t* target, size_t maxOctetCount)
+{
+    const uint8_t* source = (const uint8_t*) game;
+    const uint8_t* base = (const uint8_t*) baseline;
+    size_t pos = 0;
+    size_t targetPos = 1;
+
+    if (maxOctetCount < 1) {
+        return -1;
+    }
+
+    target[0] = NlSnapshotTypeDelta;
+
+    while (pos < sizeof(NlGame)) {
+        size_t skipCount = 0;
+        while (pos + skipCount < sizeof(NlGame) && skipCount < 255 && source[pos + skipCount] == base[pos + skipCount]) {
+            skipCount++;
+        }
+        if (pos + skipCount == sizeof(NlGame)) {
+            break;
+        }
+
+        size_t changedStart = pos + skipCount;
+        size_t changedCount = 0;
+        while (changedStart + changedCount < sizeof(NlGame) && changedCount < 255 &&
+               source[changedStart + changedCount] != base[changedStart + changedCount]) {
+            changedCount++;
+        }
+
+        if (targetPos + 2 + changedCount > maxOctetCount) {
+            return -1;
+        }
+
+        target[targetPos++] = (uint8_t) skipCount;
+        target[targetPos++] = (uint8_t) changedCount;
+        tc_memcpy_octets(&target[targetPos], &source[changedStart], changedCount);
+        targetPos += changedCount;
+        pos = changedStart + changedCount;
+    }
+
+    return (int) targetPos;
+}
+
+int nlSnapshotEncode(const NlGame* game, const NlGame* baseline, uint8_t* target, size_t maxOctetCount)
+{
+    if (baseline != 0) {
+        size_t deltaMax = maxOctetCount < NL_SNAPSHOT_MAX_OCTET_COUNT ? maxOctetCount : NL_SNAPSHOT_MAX_OCTET_COUNT - 1;
+        int octetCount = encodeDelta(game, baseline, target, deltaMax);
+        if (octetCount >= 0) {
+            return octetCount;
+        }
+    }
+
+    return encodeFull(game, target, maxOctetCount);
+}
+
+int nlSnapshotDecode(const uint8_t* octets, size_t octetCount, const NlGame* baseline, NlGame* target)
+{
+    if (octetCount < 1) {
+        return -1;
+    }
+
+    switch (octets[0]) {
+        case NlSnapshotTypeFull:
+            if (octetCount != NL_SNAPSHOT_MAX_OCTET_COUNT) {
+                CLOG_SOFT_ERROR("wrong full snapshot size %zu", octetCount)
+                return -2;
+            }
+            tc_memcpy_octets(target, &octets[1], sizeof(NlGame));
+            return 0;
+        case NlSnapshotTypeDelta:
+            break;
+        default:
+            CLOG_SOFT_ERROR("unknown snapshot type %hhu", octets[0])
+            return -3;
+    }
+
+    if (baseline == 0) {
+        CLOG_SOFT_ERROR("delta snapshot needs a baseline")
+        return -4;
+    }
+
+    uint8_t* targetOctets = (uint8_t*) target;
+    size_t pos = 0;
+    size_t readPos = 1;
+
+    *target = *baseline;
+
+    while (readPos < octetCount) {
+        if (readPos + 2 > octetCount) {
+            return -5;
+        }
+        size_t skipCount = octets[readPos++];
+        size_t changedCount = octets[readPos++];
+        if (readPos + changedCount > octetCount || pos + skipCount + changedCount > sizeof(NlGame)) {
+            CLOG_SOFT_ERROR("delta snapshot is corrupt")
+            return -6;
+        }
+        pos += skipCount;
+        tc_memcpy_octets(&targetOctets[pos], &octets[readPos], changedCount);
+        pos += changedCount;
+        readPos += changedCount;
+    }
+
+    return 0;
+}
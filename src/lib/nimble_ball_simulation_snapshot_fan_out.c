@@ -0,0 +1,121 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_fan_out.h>
+
+static int encodeWithoutTiers(void* userData, const NlGame* game, const NlGame* baseline, uint8_t precisionTier,
+                              uint8_t* target, size_t maxOctetCount)
+{
+    (void) userData;
+    (void) precisionTier;
+
+    return nlSnapshotEncode(game, baseline, target, maxOctetCount);
+}
+
+void nlSnapshotFanOutInit(NlSnapshotFanOut* self)
+{
+    for (size_t i = 0; i < NL_SNAPSHOT_FAN_OUT_CAPACITY; ++i) {
+        self->snapshots[i].refCount = 0;
+    }
+    self->currentCount = 0;
+    self->currentTickId = 0;
+    self->nextFreeIndex = 0;
+    self->encode = encodeWithoutTiers;
+    self->encodeUserData = 0;
+    self->stats.acquireCount = 0;
+    self->stats.encodeCount = 0;
+    self->stats.exhaustedCount = 0;
+}
+
+void nlSnapshotFanOutSetEncoder(NlSnapshotFanOut* self, NlSnapshotFanOutEncodeFn encode, void* userData)
+{
+    self->encode = encode;
+    self->encodeUserData = userData;
+}
+
+void nlSharedSnapshotRelease(const NlSharedSnapshot* snapshot)
+{
+    NlSharedSnapshot* mutableSnapshot = (NlSharedSnapshot*) snapshot;
+    uint32_t previousCount = nlAtomicFetchAdd(&mutableSnapshot->refCount, 0xffffffff);
+
+    CLOG_ASSERT(previousCount > 0, "shared snapshot released too many times")
+    (void) previousCount;
+}
+
+/// The fan out holds one reference to each snapshot of the current tick, so later subscribers can share them
+static void releaseCurrentTick(NlSnapshotFanOut* self)
+{
+    for (size_t i = 0; i < self->currentCount; ++i) {
+        nlSharedSnapshotRelease(&self->snapshots[self->currentIndices[i]]);
+    }
+    self->currentCount = 0;
+}
+
+static NlSharedSnapshot* findFree(NlSnapshotFanOut* self)
+{
+    for (size_t i = 0; i < NL_SNAPSHOT_FAN_OUT_CAPACITY; ++i) {
+        size_t index = (self->nextFreeIndex + i) % NL_SNAPSHOT_FAN_OUT_CAPACITY;
+        NlSharedSnapshot* snapshot = &self->snapshots[index];
+        if (nlAtomicLoadAcquire(&snapshot->refCount) == 0) {
+            self->nextFreeIndex = (index + 1) % NL_SNAPSHOT_FAN_OUT_CAPACITY;
+            return snapshot;
+        }
+    }
+
+    return 0;
+}
+
+const NlSharedSnapshot* nlSnapshotFanOutAcquire(NlSnapshotFanOut* self, const NlGame* game, uint32_t tickId,
+                                                const NlGame* baseline, uint32_t baselineTickId,
+                                                uint8_t precisionTier)
+{
+    self->stats.acquireCount++;
+
+    if (baseline == 0) {
+        baselineTickId = NL_SNAPSHOT_NO_BASELINE;
+    }
+
+    if (tickId != self->currentTickId) {
+        releaseCurrentTick(self);
+        self->currentTickId = tickId;
+    }
+
+    for (size_t i = 0; i < self->currentCount; ++i) {
+        NlSharedSnapshot* snapshot = &self->snapshots[self->currentIndices[i]];
+        if (snapshot->baselineTickId == baselineTickId && snapshot->precisionTier == precisionTier) {
+            nlAtomicFetchAdd(&snapshot->refCount, 1);
+            return snapshot;
+        }
+    }
+
+    if (self->currentCount == NL_SNAPSHOT_FAN_OUT_MAX_VARIANTS_PER_TICK) {
+        self->stats.exhaustedCount++;
+        return 0;
+    }
+
+    NlSharedSnapshot* snapshot = findFree(self);
+    if (snapshot == 0) {
+        self->stats.exhaustedCount++;
+        return 0;
+    }
+
+    snapshot->tickId = tickId;
+    snapshot->baselineTickId = baselineTickId;
+    snapshot->precisionTier = precisionTier;
+    snapshot->octetCount = self->encode(self->encodeUserData, game, baseline, precisionTier, snapshot->octets,
+                                        NL_SNAPSHOT_MAX_OCTET_COUNT);
+    if (snapshot->octetCount < 0) {
+        CLOG_SOFT_ERROR("could not encode snapshot for tick %u", tickId)
+        return 0;
+    }
+    self->stats.encodeCount++;
+
+    // One reference for the fan out and one for the caller
+    nlAtomicStoreRelease(&snapshot->refCount, 2);
+    self->currentIndices[self->currentCount++] = (size_t) (snapshot - self->snapshots);
+
+    return snapshot;
+}
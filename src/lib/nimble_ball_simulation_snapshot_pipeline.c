@@ -0,0 +1,127 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble_ball_simulation_atomic.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_pipeline.h>
+
+#define NL_SNAPSHOT_PIPELINE_MASK (NL_SNAPSHOT_PIPELINE_CAPACITY - 1)
+
+static int encodeFull(void* userData, const NlGame* game, uint32_t tickId, uint8_t* target, size_t maxOctetCount)
+{
+    (void) userData;
+    (void) tickId;
+
+    return nlSnapshotEncode(game, 0, target, maxOctetCount);
+}
+
+void nlSnapshotPipelineInit(NlSnapshotPipeline* self)
+{
+    for (size_t i = 0; i < NL_SNAPSHOT_PIPELINE_CAPACITY; ++i) {
+        self->slots[i].isEncoded = 0;
+    }
+    self->submitIndex = 0;
+    self->claimIndex = 0;
+    self->releaseIndex = 0;
+    self->submittedCount = 0;
+    self->droppedCount = 0;
+    self->encode = encodeFull;
+    self->encodeUserData = 0;
+}
+
+void nlSnapshotPipelineSetEncoder(NlSnapshotPipeline* self, NlSnapshotPipelineEncodeFn encode, void* userData)
+{
+    self->encode = encode;
+    self->encodeUserData = userData;
+}
+
+NlGame* nlSnapshotPipelineAcquire(NlSnapshotPipeline* self)
+{
+    uint32_t submitIndex = nlAtomicLoadRelaxed(&self->submitIndex);
+    uint32_t releaseIndex = nlAtomicLoadAcquire(&self->releaseIndex);
+
+    nlAtomicStoreRelaxed(&self->submittedCount, nlAtomicLoadRelaxed(&self->submittedCount) + 1);
+
+    if (submitIndex - releaseIndex >= NL_SNAPSHOT_PIPELINE_CAPACITY) {
+        nlAtomicStoreRelaxed(&self->droppedCount, nlAtomicLoadRelaxed(&self->droppedCount) + 1);
+        return 0;
+    }
+
+    return &self->slots[submitIndex & NL_SNAPSHOT_PIPELINE_MASK].game;
+}
+
+void nlSnapshotPipelineCommit(NlSnapshotPipeline* self, uint32_t tickId)
+{
+    uint32_t submitIndex = nlAtomicLoadRelaxed(&self->submitIndex);
+    NlSnapshotPipelineSlot* slot = &self->slots[submitIndex & NL_SNAPSHOT_PIPELINE_MASK];
+    slot->tickId = tickId;
+
+    nlAtomicStoreRelease(&self->submitIndex, submitIndex + 1);
+}
+
+bool nlSnapshotPipelineSubmit(NlSnapshotPipeline* self, const NlGame* game, uint32_t tickId)
+{
+    NlGame* target = nlSnapshotPipelineAcquire(self);
+    if (target == 0) {
+        return false;
+    }
+
+    *target = *game;
+    nlSnapshotPipelineCommit(self, tickId);
+
+    return true;
+}
+
+bool nlSnapshotPipelineEncodeNext(NlSnapshotPipeline* self)
+{
+    uint32_t claimIndex;
+
+    for (;;) {
+        claimIndex = nlAtomicLoadAcquire(&self->claimIndex);
+        if (claimIndex == nlAtomicLoadAcquire(&self->submitIndex)) {
+            return false;
+        }
+        if (nlAtomicCompareExchange(&self->claimIndex, claimIndex, claimIndex + 1)) {
+            break;
+        }
+    }
+
+    NlSnapshotPipelineSlot* slot = &self->slots[claimIndex & NL_SNAPSHOT_PIPELINE_MASK];
+
+    slot->octetCount = self->encode(self->encodeUserData, &slot->game, slot->tickId, slot->octets,
+                                    NL_SNAPSHOT_MAX_OCTET_COUNT);
+    if (slot->octetCount < 0) {
+        CLOG_SOFT_ERROR("could not encode snapshot for tick %u", slot->tickId)
+    }
+
+    nlAtomicStoreRelease(&slot->isEncoded, 1);
+
+    return true;
+}
+
+const NlSnapshotPipelineSlot* nlSnapshotPipelinePeekEncoded(NlSnapshotPipeline* self)
+{
+    uint32_t releaseIndex = nlAtomicLoadRelaxed(&self->releaseIndex);
+    if (releaseIndex == nlAtomicLoadAcquire(&self->submitIndex)) {
+        return 0;
+    }
+
+    const NlSnapshotPipelineSlot* slot = &self->slots[releaseIndex & NL_SNAPSHOT_PIPELINE_MASK];
+    if (!nlAtomicLoadAcquire(&slot->isEncoded)) {
+        return 0;
+    }
+
+    return slot;
+}
+
+void nlSnapshotPipelineRelease(NlSnapshotPipeline* self)
+{
+    uint32_t releaseIndex = nlAtomicLoadRelaxed(&self->releaseIndex);
+    NlSnapshotPipelineSlot* slot = &self->slots[releaseIndex & NL_SNAPSHOT_PIPELINE_MASK];
+
+    CLOG_ASSERT(slot->isEncoded, "releasing a snapshot that is not encoded")
+
+    nlAtomicStoreRelaxed(&slot->isEncoded, 0);
+    nlAtomicStoreRelease(&self->releaseIndex, releaseIndex + 1);
+}
@@ -0,0 +1,195 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <basal/math.h>
+#include <clog/clog.h>
+#include <math.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_spectator.h>
+
+void nlSpectatorLodInit(NlSpectatorLod* self, float positionPrecision, uint16_t rotationSteps, uint32_t tickInterval)
+{
+    CLOG_ASSERT(positionPrecision > 0.0f, "position precision must be positive")
+    CLOG_ASSERT(rotationSteps > 0 && rotationSteps <= 256, "rotation steps must be 1-256")
+    CLOG_ASSERT(tickInterval > 0, "tick interval must be at least one")
+
+    self->positionPrecision = positionPrecision;
+    self->rotationSteps = rotationSteps;
+    self->tickInterval = tickInterval;
+}
+
+bool nlSpectatorLodShouldEmit(const NlSpectatorLod* self, uint32_t tickId)
+{
+    return (tickId % self->tickInterval) == 0;
+}
+
+void nlSpectatorStateFromGame(NlSpectatorState* self, const NlGame* game)
+{
+    self->activeMask = 0;
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        const NlAvatar* avatar = &game->avatars.avatars[i];
+        if ((game->avatars.activeMask & (1u << i)) == 0 || avatar->isInvisible) {
+            continue;
+        }
+        self->activeMask |= (NlSlotMask) (1u << i);
+        self->avatars[i].position = avatar->circle.center;
+        self->avatars[i].visualRotation = avatar->visualRotation;
+        self->avatars[i].teamIndex = avatar->teamIndex;
+    }
+
+    for (size_t i = 0; i < NL_MAX_TEAMS; ++i) {
+        self->scores[i] = game->teams.teams[i].score;
+    }
+
+    self->ballPosition = game->ball.circle.center;
+    self->phase = game->phase;
+    self->matchClockLeftInTicks = game->matchClockLeftInTicks;
+}
+
+static int16_t quantizePosition(const NlSpectatorLod* lod, float value)
+{
+    float steps = roundf(value / lod->positionPrecision);
+    if (steps > 32767.0f) {
+        return 32767;
+    }
+    if (steps < -32768.0f) {
+        return -32768;
+    }
+    return (int16_t) steps;
+}
+
+static float dequantizePosition(const NlSpectatorLod* lod, int16_t steps)
+{
+    return (float) steps * lod->positionPrecision;
+}
+
+static uint8_t quantizeRotation(const NlSpectatorLod* lod, float rotation)
+{
+    // visualRotation is not kept in range by the simulation
+    float turns = fmodf(rotation / (2.0f * BL_PI), 1.0f);
+    if (turns < 0.0f) {
+        turns += 1.0f;
+    }
+    return (uint8_t) ((uint32_t) roundf(turns * (float) lod->rotationSteps) % lod->rotationSteps);
+}
+
+static float dequantizeRotation(const NlSpectatorLod* lod, uint8_t steps)
+{
+    float rotation = (float) steps / (float) lod->rotationSteps * 2.0f * BL_PI;
+    return rotation > BL_PI ? rotation - 2.0f * BL_PI : rotation;
+}
+
+static void writeUint16(uint8_t* target, uint16_t value)
+{
+    target[0] = (uint8_t) (value >> 8);
+    target[1] = (uint8_t) (value & 0xff);
+}
+
+static uint16_t readUint16(const uint8_t* source)
+{
+    return (uint16_t) ((source[0] << 8) | source[1]);
+}
+
+static void writePosition(const NlSpectatorLod* lod, uint8_t* target, BlVector2 position)
+{
+    writeUint16(&target[0], (uint16_t) quantizePosition(lod, position.x));
+    writeUint16(&target[2], (uint16_t) quantizePosition(lod, position.y));
+}
+
+static BlVector2 readPosition(const NlSpectatorLod* lod, const uint8_t* source)
+{
+    BlVector2 position;
+    position.x = dequantizePosition(lod, (int16_t) readUint16(&source[0]));
+    position.y = dequantizePosition(lod, (int16_t) readUint16(&source[2]));
+    return position;
+}
+
+int nlSpectatorStateEncode(const NlSpectatorLod* lod, const NlSpectatorState* state, uint8_t* target,
+                           size_t maxOctetCount)
+{
+    if (maxOctetCount < NL_SPECTATOR_MAX_OCTET_COUNT) {
+        CLOG_SOFT_ERROR("spectator target is too small %zu", maxOctetCount)
+        return -1;
+    }
+
+    size_t pos = 0;
+    target[pos++] = NlSnapshotTypeSpectator;
+    target[pos++] = state->phase;
+    writeUint16(&target[pos], state->matchClockLeftInTicks);
+    pos += 2;
+    for (size_t i = 0; i < NL_MAX_TEAMS; ++i) {
+        target[pos++] = state->scores[i];
+    }
+    writePosition(lod, &target[pos], state->ballPosition);
+    pos += 4;
+    writeUint16(&target[pos], state->activeMask);
+    pos += 2;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if ((state->activeMask & (1u << i)) == 0) {
+            continue;
+        }
+        const NlSpectatorAvatar* avatar = &state->avatars[i];
+        writePosition(lod, &target[pos], avatar->position);
+        target[pos + 4] = quantizeRotation(lod, avatar->visualRotation);
+        target[pos + 5] = avatar->teamIndex;
+        pos += NL_SPECTATOR_AVATAR_OCTET_COUNT;
+    }
+
+    return (int) pos;
+}
+
+int nlSpectatorStateDecode(const NlSpectatorLod* lod, const uint8_t* octets, size_t octetCount,
+                           NlSpectatorState* target)
+{
+    const size_t headerOctetCount = 10 + NL_MAX_TEAMS;
+
+    if (octetCount < headerOctetCount || octets[0] != NlSnapshotTypeSpectator) {
+        CLOG_SOFT_ERROR("not a spectator snapshot")
+        return -1;
+    }
+
+    size_t pos = 1;
+    target->phase = octets[pos++];
+    target->matchClockLeftInTicks = readUint16(&octets[pos]);
+    pos += 2;
+    for (size_t i = 0; i < NL_MAX_TEAMS; ++i) {
+        target->scores[i] = octets[pos++];
+    }
+    target->ballPosition = readPosition(lod, &octets[pos]);
+    pos += 4;
+    target->activeMask = readUint16(&octets[pos]);
+    pos += 2;
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if ((target->activeMask & (1u << i)) == 0) {
+            continue;
+        }
+        if (pos + NL_SPECTATOR_AVATAR_OCTET_COUNT > octetCount) {
+            CLOG_SOFT_ERROR("spectator snapshot is truncated")
+            return -2;
+        }
+        NlSpectatorAvatar* avatar = &target->avatars[i];
+        avatar->position = readPosition(lod, &octets[pos]);
+        avatar->visualRotation = dequantizeRotation(lod, octets[pos + 4]);
+        avatar->teamIndex = octets[pos + 5];
+        pos += NL_SPECTATOR_AVATAR_OCTET_COUNT;
+    }
+
+    return 0;
+}
+
+int nlSpectatorFanOutEncode(void* userData, const NlGame* game, const NlGame* baseline, uint8_t precisionTier,
+                            uint8_t* target, size_t maxOctetCount)
+{
+    if (precisionTier != NlSnapshotPrecisionTierSpectator) {
+        return nlSnapshotEncode(game, baseline, target, maxOctetCount);
+    }
+
+    const NlSpectatorLod* lod = (const NlSpectatorLod*) userData;
+    NlSpectatorState state;
+    nlSpectatorStateFromGame(&state, game);
+
+    return nlSpectatorStateEncode(lod, &state, target, maxOctetCount);
+}
@@ -0,0 +1,154 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <nimble-ball-simulation/nimble_ball_simulation_speculation.h>
+
+void nlSpeculationInit(NlSpeculation* self)
+{
+    tc_mem_clear_type(self);
+}
+
+static NlPlayerInput hypothesisInput(NlSpeculationHypothesis hypothesis, const NlPlayerInput* lastInput)
+{
+    NlPlayerInput input = *lastInput;
+
+    switch (hypothesis) {
+        case NlSpeculationHypothesisRepeatLast:
+            break;
+        case NlSpeculationHypothesisReleaseKick:
+            input.input.inGameInput.buttons &= (uint8_t) ~0x01u;
+            break;
+        case NlSpeculationHypothesisNoInput:
+            tc_mem_clear_type(&input);
+            input.inputType = NlPlayerInputTypeInGame;
+            break;
+    }
+
+    return input;
+}
+
+static bool hasBranchWithInput(const NlSpeculation* self, size_t inputIndex, const NlPlayerInput* input)
+{
+    for (size_t i = 0; i < self->branchCount; ++i) {
+        if (nlPlayerInputIsEqual(&self->branches[i].inputs[inputIndex].playerInput, input)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void nlSpeculationBegin(NlSpeculation* self, const NlSimulationVm* vm, uint8_t participantId,
+                        const NlPlayerInput* lastInput, const NlPlayerInputWithParticipantInfo* predictedInputs,
+                        size_t inputCount, size_t tickCount)
+{
+    CLOG_ASSERT(tickCount <= NL_SPECULATION_MAX_TICKS, "too many ticks to speculate %zu", tickCount)
+    CLOG_ASSERT(inputCount <= NL_MAX_PARTICIPANTS, "too many inputs %zu", inputCount)
+
+    TransmuteState state = transmuteVmGetState(&vm->transmuteVm);
+    CLOG_ASSERT(state.octetSize == sizeof(NlGame), "wrong state size")
+    self->baseState = *(const NlGame*) state.state;
+    self->tickCount = tickCount;
+    self->branchCount = 0;
+
+    size_t participantInputIndex = inputCount;
+    for (size_t i = 0; i < inputCount; ++i) {
+        if (predictedInputs[i].participantId == participantId) {
+            participantInputIndex = i;
+        }
+    }
+    if (participantInputIndex == inputCount) {
+        CLOG_C_NOTICE(&vm->log, "participant %hhu has no input to speculate on", participantId)
+        return;
+    }
+
+    for (size_t i = 0; i <= NlSpeculationHypothesisNoInput; ++i) {
+        NlSpeculationHypothesis hypothesis = (NlSpeculationHypothesis) i;
+        NlPlayerInput input = hypothesisInput(hypothesis, lastInput);
+        if (hasBranchWithInput(self, participantInputIndex, &input)) {
+            // e.g. releasing the kick button when it was not pressed is the same as repeating the last input
+            continue;
+        }
+
+        NlSpeculationBranch* branch = &self->branches[self->branchCount++];
+        branch->hypothesis = hypothesis;
+        branch->inputCount = inputCount;
+        branch->simulatedTickCount = 0;
+        tc_memcpy_octets(branch->inputs, predictedInputs, sizeof(predictedInputs[0]) * inputCount);
+        branch->inputs[participantInputIndex].playerInput = input;
+    }
+}
+
+void nlSpeculationSimulateBranch(NlSpeculation* self, size_t branchIndex)
+{
+    CLOG_ASSERT(branchIndex < self->branchCount, "illegal branch index %zu", branchIndex)
+    NlSpeculationBranch* branch = &self->branches[branchIndex];
+
+    const NlGame* previousState = &self->baseState;
+    for (size_t tickIndex = 0; tickIndex < self->tickCount; ++tickIndex) {
+        NlGame* state = &branch->states[tickIndex];
+        *state = *previousState;
+        nlGameTick(state, branch->inputs, branch->inputCount, 0);
+        previousState = state;
+    }
+
+    branch->simulatedTickCount = self->tickCount;
+}
+
+static bool branchMatches(const NlSpeculationBranch* branch, const NlPlayerInputWithParticipantInfo* actualInputs,
+                          size_t inputCount, size_t tickCount)
+{
+    if (branch->simulatedTickCount < tickCount || branch->inputCount != inputCount) {
+        return false;
+    }
+
+    for (size_t tickIndex = 0; tickIndex < tickCount; ++tickIndex) {
+        const NlPlayerInputWithParticipantInfo* tickInputs = &actualInputs[tickIndex * inputCount];
+        for (size_t i = 0; i < inputCount; ++i) {
+            if (tickInputs[i].participantId != branch->inputs[i].participantId ||
+                !nlPlayerInputIsEqual(&tickInputs[i].playerInput, &branch->inputs[i].playerInput)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool nlSpeculationAdopt(NlSpeculation* self, NlSimulationVm* vm, const NlPlayerInputWithParticipantInfo* actualInputs,
+                        size_t inputCount, size_t tickCount)
+{
+    if (tickCount == 0) {
+        return false;
+    }
+
+    self->stats.adoptAttemptCount++;
+
+    // The branches are only valid continuations of the state they were started from
+    TransmuteState currentState = transmuteVmGetState(&vm->transmuteVm);
+    if (currentState.octetSize != sizeof(NlGame) ||
+        tc_memcmp(currentState.state, &self->baseState, sizeof(NlGame)) != 0) {
+        CLOG_C_NOTICE(&vm->log, "vm has moved on from the speculation base state, can not adopt")
+        return false;
+    }
+
+    for (size_t i = 0; i < self->branchCount; ++i) {
+        const NlSpeculationBranch* branch = &self->branches[i];
+        if (!branchMatches(branch, actualInputs, inputCount, tickCount)) {
+            continue;
+        }
+
+        TransmuteState state;
+        state.state = &branch->states[tickCount - 1];
+        state.octetSize = sizeof(NlGame);
+        transmuteVmSetState(&vm->transmuteVm, &state);
+
+        self->stats.hitCount++;
+        self->stats.hypothesisHitCount[branch->hypothesis]++;
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,161 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <math.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vector_env.h>
+
+#define NL_VECTOR_ENV_POSITION_SCALE (1.0f / 640.0f)
+
+void nlVectorEnvInit(NlVectorEnv* self, NlGame* games, size_t matchCount, size_t agentCount)
+{
+    CLOG_ASSERT(agentCount > 0 && agentCount <= NL_MAX_PLAYERS && agentCount <= NL_MAX_PARTICIPANTS,
+                "illegal agent count %zu", agentCount)
+
+    self->games = games;
+    self->matchCount = matchCount;
+    self->agentCount = agentCount;
+    self->observationSize = NL_VECTOR_ENV_BALL_OBSERVATION_SIZE + agentCount * NL_VECTOR_ENV_AVATAR_OBSERVATION_SIZE +
+                            NL_VECTOR_ENV_GAME_OBSERVATION_SIZE;
+}
+
+static void writeObservation(const NlVectorEnv* self, const NlGame* game, float* target)
+{
+    const float scale = NL_VECTOR_ENV_POSITION_SCALE;
+    const NlRules* rules = nlGameRules(game);
+
+    *target++ = game->ball.circle.center.x * scale;
+    *target++ = game->ball.circle.center.y * scale;
+    *target++ = game->ball.velocity.x * scale;
+    *target++ = game->ball.velocity.y * scale;
+
+    for (size_t i = 0; i < self->agentCount; ++i) {
+        const NlParticipant* participant = &game->participantLookup[i];
+        const NlPlayer* player = participant->isUsed ? &game->players.players[participant->playerIndex] : 0;
+        if (player == 0 || player->controllingAvatarIndex == NL_AVATAR_INDEX_UNDEFINED) {
+            for (size_t j = 0; j < NL_VECTOR_ENV_AVATAR_OBSERVATION_SIZE; ++j) {
+                *target++ = 0.0f;
+            }
+            continue;
+        }
+        const NlAvatar* avatar = &game->avatars.avatars[player->controllingAvatarIndex];
+        *target++ = 1.0f;
+        *target++ = avatar->circle.center.x * scale;
+        *target++ = avatar->circle.center.y * scale;
+        *target++ = avatar->velocity.x * scale;
+        *target++ = avatar->velocity.y * scale;
+        *target++ = cosf(avatar->visualRotation);
+        *target++ = sinf(avatar->visualRotation);
+        *target++ = (float) avatar->teamIndex;
+    }
+
+    for (size_t i = 0; i < 2; ++i) {
+        const NlGoal* goal = &rules->constants.goals[i];
+        *target++ = (goal->rect.position.x + goal->rect.size.x * 0.5f) * scale;
+        *target++ = (goal->rect.position.y + goal->rect.size.y * 0.5f) * scale;
+    }
+    *target++ = (float) game->matchClockLeftInTicks / (float) rules->tickRate.matchDurationInTicks;
+    *target++ = (float) game->teams.teams[0].score;
+    *target++ = (float) game->teams.teams[1].score;
+    *target = game->phase == NlGamePhasePlaying ? 1.0f : 0.0f;
+}
+
+static void resetMatch(const NlVectorEnv* self, NlGame* game)
+{
+    NlPlayerInputWithParticipantInfo inputs[NL_MAX_PLAYERS];
+
+    nlGameInit(game);
+
+    for (size_t i = 0; i < self->agentCount; ++i) {
+        inputs[i].participantId = (uint8_t) i;
+        inputs[i].playerInput.inputType = NlPlayerInputTypeSelectTeam;
+        inputs[i].playerInput.input.selectTeam.preferredTeamToJoin = (uint8_t) (i % 2);
+    }
+    nlGameTick(game, inputs, self->agentCount, 0);
+
+    for (size_t i = 0; i < self->agentCount; ++i) {
+        inputs[i].playerInput.inputType = NlPlayerInputTypeInGame;
+        inputs[i].playerInput.input.inGameInput.horizontalAxis = 0;
+        inputs[i].playerInput.input.inGameInput.verticalAxis = 0;
+        inputs[i].playerInput.input.inGameInput.buttons = 0;
+    }
+
+    // Training has no use for the count down, so it is skipped once all avatars have spawned
+    while (game->phase != NlGamePhasePlaying) {
+        if (game->phase == NlGamePhaseCountDown) {
+            game->phaseCountDown = 0;
+        }
+        nlGameTick(game, inputs, self->agentCount, 0);
+    }
+}
+
+void nlVectorEnvResetRange(NlVectorEnv* self, size_t firstMatch, size_t matchCount, float* observations)
+{
+    CLOG_ASSERT(firstMatch + matchCount <= self->matchCount, "match range is out of bounds")
+
+    for (size_t matchIndex = firstMatch; matchIndex < firstMatch + matchCount; ++matchIndex) {
+        NlGame* game = &self->games[matchIndex];
+        resetMatch(self, game);
+        writeObservation(self, game, &observations[matchIndex * self->observationSize]);
+    }
+}
+
+static void actionsToInputs(const NlVectorEnv* self, const int8_t* actions, NlPlayerInputWithParticipantInfo* inputs)
+{
+    for (size_t i = 0; i < self->agentCount; ++i) {
+        const int8_t* action = &actions[i * NL_VECTOR_ENV_ACTION_SIZE];
+        inputs[i].participantId = (uint8_t) i;
+        inputs[i].playerInput.inputType = NlPlayerInputTypeInGame;
+        inputs[i].playerInput.input.inGameInput.horizontalAxis = action[0];
+        inputs[i].playerInput.input.inGameInput.verticalAxis = action[1];
+        inputs[i].playerInput.input.inGameInput.buttons = (uint8_t) (action[2] & 0x03);
+    }
+}
+
+void nlVectorEnvStepRange(NlVectorEnv* self, size_t firstMatch, size_t matchCount, const int8_t* actions,
+                          float* observations, float* rewards, uint8_t* dones)
+{
+    NlPlayerInputWithParticipantInfo inputs[NL_MAX_PLAYERS];
+    size_t actionStride = self->agentCount * NL_VECTOR_ENV_ACTION_SIZE;
+
+    CLOG_ASSERT(firstMatch + matchCount <= self->matchCount, "match range is out of bounds")
+
+    for (size_t matchIndex = firstMatch; matchIndex < firstMatch + matchCount; ++matchIndex) {
+        NlGame* game = &self->games[matchIndex];
+        uint8_t scoresBefore[2] = {game->teams.teams[0].score, game->teams.teams[1].score};
+
+        actionsToInputs(self, &actions[matchIndex * actionStride], inputs);
+        nlGameTick(game, inputs, self->agentCount, 0);
+
+        int scoreDiff[2] = {game->teams.teams[0].score - scoresBefore[0],
+                            game->teams.teams[1].score - scoresBefore[1]};
+        bool isDone = game->phase != NlGamePhasePlaying;
+
+        if (rewards != 0) {
+            for (size_t i = 0; i < self->agentCount; ++i) {
+                size_t team = i % 2;
+                rewards[matchIndex * self->agentCount + i] = (float) (scoreDiff[team] - scoreDiff[1 - team]);
+            }
+        }
+        if (dones != 0) {
+            dones[matchIndex] = isDone ? 1 : 0;
+        }
+
+        if (isDone) {
+            resetMatch(self, game);
+        }
+
+        writeObservation(self, game, &observations[matchIndex * self->observationSize]);
+    }
+}
+
+void nlVectorEnvReset(NlVectorEnv* self, float* observations)
+{
+    nlVectorEnvResetRange(self, 0, self->matchCount, observations);
+}
+
+void nlVectorEnvStep(NlVectorEnv* self, const int8_t* actions, float* observations, float* rewards, uint8_t* dones)
+{
+    nlVectorEnvStepRange(self, 0, self->matchCount, actions, observations, rewards, dones);
+}
@@ -23,6 +23,13 @@ static void setState(void* _self, const TransmuteState* state)
     CLOG_ASSERT(sizeof(NlGame) == state->octetSize, "transmute state size is wrong %zu", state->octetSize)
 
     self->game = *((const NlGame*) state->state);
+    const NlRules* rules = nlRulesResolve(self->game.rules);
+    if (rules == 0) {
+        CLOG_SOFT_ERROR("game has rules %d that are not registered", self->game.rules.id)
+    } else if (rules->tickRate.tickDurationMs != self->tickDurationMs) {
+        CLOG_SOFT_ERROR("game is for %hu ms ticks, but the vm ticks every %hu ms", rules->tickRate.tickDurationMs,
+                        self->tickDurationMs)
+    }
 }
 
 static int stateToString(void* _self, const TransmuteState* state, char* target, size_t maxTargetOctetSize)
@@ -52,13 +59,32 @@ static int inputToString(void* _self, const TransmuteParticipantInput* input, ch
     }
 }
 
-static void tick(void* _self, const TransmuteInput* input)
+/// Fills in for a participant that did not deliver an input in time. Only depends on the game state and the
+/// configured policy, so all peers fill in the same input.
+static NlPlayerInput noInputInTime(const NlSimulationVm* self, uint8_t participantId)
 {
-    NlSimulationVm* self = (NlSimulationVm*) _self;
+    NlPlayerInput previousInput;
+    const NlPlayer* player = nlGameFindSimulationPlayerFromParticipantId(&self->game, participantId);
+    if (player != 0) {
+        previousInput = player->playerInput;
+    } else {
+        tc_mem_clear_type(&previousInput);
+        previousInput.inputType = NlPlayerInputTypeForced;
+    }
 
-    NlPlayerInputWithParticipantInfo playerInputs[64];
+    return nlInputPredictionStep(self->noInputInTimePolicy, &previousInput);
+}
 
-    for (size_t i = 0; i < input->participantCount; ++i) {
+static size_t convertInput(const NlSimulationVm* self, const TransmuteInput* input,
+                           NlPlayerInputWithParticipantInfo* playerInputs)
+{
+    size_t participantCount = input->participantCount;
+    if (participantCount > NL_MAX_PARTICIPANTS) {
+        CLOG_SOFT_ERROR("too many participants %zu, only using the first %d", participantCount, NL_MAX_PARTICIPANTS)
+        participantCount = NL_MAX_PARTICIPANTS;
+    }
+
+    for (size_t i = 0; i < participantCount; ++i) {
         const TransmuteParticipantInput* transmuteParticipantInput = &input->participantInputs[i];
         switch (transmuteParticipantInput->inputType)
         {
@@ -67,8 +93,7 @@ static void tick(void* _self, const TransmuteInput* input)
                 playerInputs[i].playerInput = *(const NlPlayerInput*) transmuteParticipantInput->input;
                 break;
             case TransmuteParticipantInputTypeNoInputInTime:
-                tc_mem_clear_type(&playerInputs[i].playerInput);
-                playerInputs[i].playerInput.inputType = NlPlayerInputTypeForced;
+                playerInputs[i].playerInput = noInputInTime(self, transmuteParticipantInput->participantId);
                 break;
             case TransmuteParticipantInputTypeWaitingForReconnect:
                 tc_mem_clear_type(&playerInputs[i].playerInput);
@@ -78,10 +103,91 @@ static void tick(void* _self, const TransmuteInput* input)
         playerInputs[i].participantId = transmuteParticipantInput->participantId;
     }
 
-    nlGameTick(&self->game, playerInputs, input->participantCount, &self->log);
+    return participantCount;
+}
+
+/// The cache is only used when resimulating, live ticks are always simulated so they get their logging
+static void tickGame(NlSimulationVm* self, const NlPlayerInputWithParticipantInfo* playerInputs,
+                     size_t playerInputCount, bool isResimulation, Clog* log)
+{
+    if (self->cache == 0 || !isResimulation) {
+        nlGameTick(&self->game, playerInputs, playerInputCount, log);
+        return;
+    }
+
+    uint64_t stateHash = nlSimulationVmCacheHash(&self->game, sizeof(self->game));
+    uint64_t inputHash = nlSimulationVmCacheHash(playerInputs, sizeof(playerInputs[0]) * playerInputCount);
+
+    const NlGame* cachedResult = nlSimulationVmCacheFind(self->cache, stateHash, inputHash, &self->game, playerInputs,
+                                                         playerInputCount);
+    if (cachedResult != 0) {
+        self->game = *cachedResult;
+        return;
+    }
+
+    NlGame keyState = self->game;
+    nlGameTick(&self->game, playerInputs, playerInputCount, log);
+    nlSimulationVmCacheInsert(self->cache, stateHash, inputHash, &keyState, playerInputs, playerInputCount,
+                              &self->game);
+}
+
+static void tick(void* _self, const TransmuteInput* input)
+{
+    NlSimulationVm* self = (NlSimulationVm*) _self;
+
+    NlPlayerInputWithParticipantInfo playerInputs[NL_MAX_PARTICIPANTS];
+
+    size_t playerInputCount = convertInput(self, input, playerInputs);
+
+    tickGame(self, playerInputs, playerInputCount, false, &self->log);
+    nlSimulationVmPublish(self);
+}
+
+void nlSimulationVmTickMany(NlSimulationVm* self, const TransmuteInput* inputs, size_t tickCount, bool isResimulation)
+{
+    NlPlayerInputWithParticipantInfo playerInputs[NL_MAX_PARTICIPANTS];
+    Clog* log = isResimulation ? 0 : &self->log;
+
+    for (size_t tickIndex = 0; tickIndex < tickCount; ++tickIndex) {
+        size_t playerInputCount = convertInput(self, &inputs[tickIndex], playerInputs);
+        tickGame(self, playerInputs, playerInputCount, isResimulation, log);
+    }
+
+    if (!isResimulation) {
+        nlSimulationVmPublish(self);
+    }
+}
+
+void nlSimulationVmSetCache(NlSimulationVm* self, NlSimulationVmCache* cache)
+{
+    self->cache = cache;
+}
+
+void nlSimulationVmSetPublishedState(NlSimulationVm* self, NlPublishedState* publishedState)
+{
+    self->publishedState = publishedState;
+}
+
+void nlSimulationVmPublish(NlSimulationVm* self)
+{
+    if (self->publishedState == 0) {
+        return;
+    }
+
+    nlPublishedStatePublish(self->publishedState, &self->game);
+}
+
+void nlSimulationVmSetNoInputInTimePolicy(NlSimulationVm* self, NlInputPredictionPolicy policy)
+{
+    self->noInputInTimePolicy = policy;
 }
 
 void nlSimulationVmInit(NlSimulationVm* self, Clog log)
+{
+    nlSimulationVmInitWithTickDuration(self, NL_DEFAULT_TICK_DURATION_MS, log);
+}
+
+void nlSimulationVmInitWithTickDuration(NlSimulationVm* self, uint16_t tickDurationMs, Clog log)
 {
     TransmuteVmSetup transmuteVmSetup;
 
@@ -92,9 +198,13 @@ void nlSimulationVmInit(NlSimulationVm* self, Clog log)
     transmuteVmSetup.stateToString = stateToString;
     transmuteVmSetup.getStateFn = getState;
     transmuteVmSetup.setStateFn = setState;
-    transmuteVmSetup.tickDurationMs = 16;
+    transmuteVmSetup.tickDurationMs = tickDurationMs;
     transmuteVmSetup.tickFn = tick;
     self->log = log;
+    self->tickDurationMs = tickDurationMs;
+    self->cache = 0;
+    self->publishedState = 0;
+    self->noInputInTimePolicy = NlInputPredictionPolicyForced;
 
     transmuteVmInit(&self->transmuteVm, self, transmuteVmSetup, log);
 }
@@ -0,0 +1,116 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <nimble-ball-simulation/nimble_ball_simulation_vm_cache.h>
+#include <tiny-libc/tiny_libc.h>
+
+void nlSimulationVmCacheInit(NlSimulationVmCache* self, NlSimulationVmCacheEntry* entries, size_t capacity)
+{
+    CLOG_ASSERT(capacity > 0, "cache must have at least one entry")
+    self->entries = entries;
+    self->capacity = capacity;
+    nlSimulationVmCacheClear(self);
+}
+
+void nlSimulationVmCacheClear(NlSimulationVmCache* self)
+{
+    for (size_t i = 0; i < self->capacity; ++i) {
+        self->entries[i].isUsed = false;
+    }
+    tc_mem_clear_type(&self->stats);
+}
+
+static size_t entryIndex(const NlSimulationVmCache* self, uint64_t stateHash, uint64_t inputHash, size_t probe)
+{
+    return (size_t) (((stateHash ^ (inputHash * 0x9E3779B97F4A7C15ULL)) + probe) % self->capacity);
+}
+
+static bool isKeyEqual(const NlSimulationVmCacheEntry* entry, const NlGame* state,
+                       const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount)
+{
+    return entry->keyInputCount == inputCount &&
+           tc_memcmp(entry->keyInputs, inputs, sizeof(inputs[0]) * inputCount) == 0 &&
+           tc_memcmp(&entry->keyState, state, sizeof(NlGame)) == 0;
+}
+
+const NlGame* nlSimulationVmCacheFind(NlSimulationVmCache* self, uint64_t stateHash, uint64_t inputHash,
+                                      const NlGame* state, const NlPlayerInputWithParticipantInfo* inputs,
+                                      size_t inputCount)
+{
+    self->stats.lookupCount++;
+
+    for (size_t probe = 0; probe < NL_SIMULATION_VM_CACHE_PROBE_COUNT; ++probe) {
+        const NlSimulationVmCacheEntry* entry = &self->entries[entryIndex(self, stateHash, inputHash, probe)];
+        if (entry->isUsed && entry->stateHash == stateHash && entry->inputHash == inputHash &&
+            isKeyEqual(entry, state, inputs, inputCount)) {
+            self->stats.hitCount++;
+            return &entry->resultState;
+        }
+    }
+
+    return 0;
+}
+
+void nlSimulationVmCacheInsert(NlSimulationVmCache* self, uint64_t stateHash, uint64_t inputHash,
+                               const NlGame* state, const NlPlayerInputWithParticipantInfo* inputs,
+                               size_t inputCount, const NlGame* resultState)
+{
+    CLOG_ASSERT(inputCount <= NL_MAX_PARTICIPANTS, "too many inputs %zu", inputCount)
+
+    // Use the first free entry in the probe range, otherwise replace the oldest one
+    NlSimulationVmCacheEntry* entry = 0;
+    for (size_t probe = 0; probe < NL_SIMULATION_VM_CACHE_PROBE_COUNT; ++probe) {
+        NlSimulationVmCacheEntry* candidate = &self->entries[entryIndex(self, stateHash, inputHash, probe)];
+        if (!candidate->isUsed) {
+            entry = candidate;
+            break;
+        }
+        if (entry == 0 || candidate->insertedAt < entry->insertedAt) {
+            entry = candidate;
+        }
+    }
+
+    if (entry->isUsed) {
+        self->stats.evictCount++;
+    }
+
+    entry->stateHash = stateHash;
+    entry->inputHash = inputHash;
+    entry->keyState = *state;
+    tc_memcpy_type_n(entry->keyInputs, inputs, inputCount);
+    entry->keyInputCount = inputCount;
+    entry->resultState = *resultState;
+    entry->isUsed = true;
+    entry->insertedAt = self->stats.insertCount;
+
+    self->stats.insertCount++;
+}
+
+static uint64_t mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value;
+    hash *= 0x100000001B3ULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+/// Hashes eight octets at a time, the whole NlGame is hashed on every cached tick
+uint64_t nlSimulationVmCacheHash(const void* data, size_t octetCount)
+{
+    const uint8_t* octets = (const uint8_t*) data;
+    uint64_t hash = 0xCBF29CE484222325ULL ^ octetCount;
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= octetCount; i += sizeof(uint64_t)) {
+        uint64_t value;
+        tc_memcpy_octets(&value, &octets[i], sizeof(value));
+        hash = mix(hash, value);
+    }
+
+    for (; i < octetCount; ++i) {
+        hash = mix(hash, octets[i]);
+    }
+
+    return hash;
+}
@@ -2,6 +2,7 @@
  *  Copyright (c) Peter Bjorklund. All rights reserved.
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
 #include "utest.h"
 #include <clog/clog.h>
 #include <nimble-ball-simulation/nimble_ball_simulation.h>
@@ -32,3 +33,629 @@ UTEST(NimbleBall, verify)
     ASSERT_EQ(NlGamePhaseCountDown, game.phase);
     ASSERT_EQ(62 * 3 - 1, game.phaseCountDown);
 }
+
+UTEST(NimbleBall, stableHandles)
+{
+    NlGame game;
+    nlGameInit(&game);
+
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBall";
+
+    NlPlayerInputWithParticipantInfo inputs[3];
+    setSelectTeamInput(&inputs[0], 1, 0);
+    setSelectTeamInput(&inputs[1], 2, 1);
+    setSelectTeamInput(&inputs[2], 3, 1);
+
+    nlGameTick(&game, inputs, 3, &subLog);
+    ASSERT_EQ(3, game.players.playerCount);
+    ASSERT_EQ(3, game.avatars.avatarCount);
+
+    const NlPlayer* lastPlayer = nlGameFindSimulationPlayerFromParticipantId(&game, 3);
+    ASSERT_TRUE(lastPlayer != 0);
+    NlPlayerHandle lastPlayerHandle = nlGamePlayerHandle(&game, lastPlayer->playerIndex);
+    NlAvatarHandle lastAvatarHandle = nlGameAvatarHandle(&game, lastPlayer->controllingAvatarIndex);
+
+    const NlPlayer* leavingPlayer = nlGameFindSimulationPlayerFromParticipantId(&game, 2);
+    NlPlayerHandle leavingPlayerHandle = nlGamePlayerHandle(&game, leavingPlayer->playerIndex);
+    NlAvatarHandle leavingAvatarHandle = nlGameAvatarHandle(&game, leavingPlayer->controllingAvatarIndex);
+
+    // Participant 2 leaves, the others must keep their slots
+    inputs[1] = inputs[2];
+    nlGameTick(&game, inputs, 2, &subLog);
+    ASSERT_EQ(2, game.players.playerCount);
+    ASSERT_EQ(2, game.avatars.avatarCount);
+
+    ASSERT_TRUE(nlGameResolvePlayer(&game, leavingPlayerHandle) == 0);
+    ASSERT_TRUE(nlGameResolveAvatar(&game, leavingAvatarHandle) == 0);
+
+    const NlPlayer* resolvedPlayer = nlGameResolvePlayer(&game, lastPlayerHandle);
+    ASSERT_TRUE(resolvedPlayer != 0);
+    ASSERT_EQ(3, resolvedPlayer->assignedToParticipantIndex);
+    const NlAvatar* resolvedAvatar = nlGameResolveAvatar(&game, lastAvatarHandle);
+    ASSERT_TRUE(resolvedAvatar != 0);
+    ASSERT_EQ(resolvedPlayer->playerIndex, resolvedAvatar->controlledByPlayerIndex);
+    ASSERT_EQ(resolvedAvatar->avatarIndex, resolvedPlayer->controllingAvatarIndex);
+
+    // A new participant reuses the free slot, but old handles must stay stale
+    setSelectTeamInput(&inputs[2], 4, 0);
+    nlGameTick(&game, inputs, 3, &subLog);
+    ASSERT_EQ(3, game.players.playerCount);
+    ASSERT_TRUE(nlGameResolvePlayer(&game, leavingPlayerHandle) == 0);
+    ASSERT_TRUE(nlGameResolvePlayer(&game, lastPlayerHandle) != 0);
+}
+
+#define RESIMULATE_TICK_COUNT (12)
+
+static void predictTicks(NlGame* game, int8_t predictedAxis, NlTickFootprint* footprints)
+{
+    for (size_t i = 0; i < RESIMULATE_TICK_COUNT; ++i) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        setInGameInput(&inputs[0], 1, predictedAxis, 0, 0);
+        setInGameInput(&inputs[1], 2, 10, 0, 0);
+        NlGameTickOutput output;
+        output.footprint = &footprints[i];
+        output.events = 0;
+        output.stats = 0;
+        nlGameTickWithOutput(game, inputs, 2, &output, 0);
+    }
+}
+
+UTEST(NimbleBall, partialResimulation)
+{
+    NlGame rollbackState;
+    nlGameInit(&rollbackState);
+    startTwoPlayerMatch(&rollbackState);
+    ASSERT_EQ(NlGamePhasePlaying, rollbackState.phase);
+
+    NlTickFootprint footprints[RESIMULATE_TICK_COUNT];
+    NlGame predictedState = rollbackState;
+    predictTicks(&predictedState, 0, footprints);
+
+    NlPlayerInput correctedInputs[RESIMULATE_TICK_COUNT];
+    NlGame fullyResimulatedState = rollbackState;
+    for (size_t i = 0; i < RESIMULATE_TICK_COUNT; ++i) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        setInGameInput(&inputs[0], 1, -50, 0, 0);
+        setInGameInput(&inputs[1], 2, 10, 0, 0);
+        correctedInputs[i] = inputs[0].playerInput;
+        nlGameTick(&fullyResimulatedState, inputs, 2, 0);
+    }
+
+    ASSERT_TRUE(nlGameResimulateParticipant(&predictedState, &rollbackState, footprints, correctedInputs,
+                                            RESIMULATE_TICK_COUNT, 1));
+    ASSERT_EQ(0, memcmp(&predictedState, &fullyResimulatedState, sizeof(NlGame)));
+}
+
+UTEST(NimbleBall, partialResimulationFallsBackWhenBallIsTouched)
+{
+    NlGame rollbackState;
+    nlGameInit(&rollbackState);
+    startTwoPlayerMatch(&rollbackState);
+
+    const NlPlayer* player = nlGameFindSimulationPlayerFromParticipantId(&rollbackState, 1);
+    rollbackState.ball.circle.center = rollbackState.avatars.avatars[player->controllingAvatarIndex].circle.center;
+
+    NlTickFootprint footprints[RESIMULATE_TICK_COUNT];
+    NlGame predictedState = rollbackState;
+    predictTicks(&predictedState, 0, footprints);
+    ASSERT_TRUE(footprints[0].dribbleTouchedMask != 0);
+
+    NlPlayerInput correctedInputs[RESIMULATE_TICK_COUNT];
+    for (size_t i = 0; i < RESIMULATE_TICK_COUNT; ++i) {
+        correctedInputs[i].inputType = NlPlayerInputTypeInGame;
+        correctedInputs[i].input.inGameInput.horizontalAxis = -50;
+        correctedInputs[i].input.inGameInput.verticalAxis = 0;
+        correctedInputs[i].input.inGameInput.buttons = 0;
+    }
+
+    NlGame unchangedState = predictedState;
+    ASSERT_FALSE(nlGameResimulateParticipant(&predictedState, &rollbackState, footprints, correctedInputs,
+                                             RESIMULATE_TICK_COUNT, 1));
+    ASSERT_EQ(0, memcmp(&predictedState, &unchangedState, sizeof(NlGame)));
+}
+
+static size_t countEvents(const NlGameEvents* events, NlGameEventType eventType)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < events->count; ++i) {
+        if (events->events[i].eventType == eventType) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void tickWithEvents(NlGame* game, const NlPlayerInputWithParticipantInfo* inputs, size_t inputCount,
+                           NlGameEvents* events)
+{
+    NlGameTickOutput output;
+    output.footprint = 0;
+    output.events = events;
+    output.stats = 0;
+    nlGameEventsClear(events);
+    nlGameTickWithOutput(game, inputs, inputCount, &output, 0);
+}
+
+UTEST(NimbleBall, tickEvents)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    NlGameEvent eventBuffer[16];
+    NlGameEvents events;
+    nlGameEventsInit(&events, eventBuffer, 16);
+
+    // Participant 1 releases a built up kick next to the ball, participant 2 starts a slide tackle
+    NlAvatar* kicker = &game.avatars.avatars[nlGameFindSimulationPlayerFromParticipantId(&game, 1)
+                                                 ->controllingAvatarIndex];
+    kicker->circle.center.x = 300.0f;
+    kicker->circle.center.y = 160.0f;
+    kicker->visualRotation = 0.0f;
+    kicker->kickPower = 40;
+    game.ball.circle.center.x = 335.0f;
+    game.ball.circle.center.y = 160.0f;
+    game.ball.velocity = blVector2Zero();
+
+    NlPlayerInputWithParticipantInfo inputs[3];
+    setInGameInput(&inputs[0], 1, 0, 0, 0);
+    setInGameInput(&inputs[1], 2, 0, 0, 0);
+    inputs[1].playerInput.input.inGameInput.buttons = 0x02;
+    tickWithEvents(&game, inputs, 2, &events);
+
+    ASSERT_EQ(1u, countEvents(&events, NlGameEventTypeKick));
+    ASSERT_EQ(1u, countEvents(&events, NlGameEventTypeSlideTackle));
+    for (size_t i = 0; i < events.count; ++i) {
+        if (events.events[i].eventType == NlGameEventTypeKick) {
+            ASSERT_EQ(kicker->avatarIndex, events.events[i].data.kick.avatarIndex);
+            ASSERT_EQ(40, events.events[i].data.kick.kickPower);
+        }
+    }
+
+    // Ball moving into the lower border
+    inputs[1].playerInput.input.inGameInput.buttons = 0;
+    game.ball.circle.center.x = 200.0f;
+    game.ball.circle.center.y = 31.0f;
+    game.ball.velocity.x = 0.0f;
+    game.ball.velocity.y = -5.0f;
+    tickWithEvents(&game, inputs, 2, &events);
+    ASSERT_EQ(1u, countEvents(&events, NlGameEventTypeBallHitBorder));
+
+    // Ball inside the goal of team 0
+    game.ball.circle.center.x = 20.0f;
+    game.ball.circle.center.y = 160.0f;
+    game.ball.velocity = blVector2Zero();
+    tickWithEvents(&game, inputs, 2, &events);
+    ASSERT_EQ(1u, countEvents(&events, NlGameEventTypeGoal));
+    ASSERT_EQ(1u, countEvents(&events, NlGameEventTypePhaseChanged));
+    ASSERT_EQ(NlGameEventTypeGoal, events.events[0].eventType);
+    ASSERT_EQ(1, events.events[0].data.goal.scoringTeamIndex);
+    ASSERT_EQ(game.teams.teams[1].score, events.events[0].data.goal.score);
+    ASSERT_EQ(NlGameEventTypePhaseChanged, events.events[1].eventType);
+    ASSERT_EQ(NlGamePhasePlaying, events.events[1].data.phaseChanged.previousPhase);
+    ASSERT_EQ(NlGamePhaseAfterAGoal, events.events[1].data.phaseChanged.phase);
+
+    setSelectTeamInput(&inputs[2], 3, 0);
+    tickWithEvents(&game, inputs, 3, &events);
+    ASSERT_EQ(1u, events.count);
+    ASSERT_EQ(NlGameEventTypeJoined, events.events[0].eventType);
+    ASSERT_EQ(3, events.events[0].data.joined.participantId);
+
+    tickWithEvents(&game, inputs, 1, &events);
+    ASSERT_EQ(2u, countEvents(&events, NlGameEventTypeLeft));
+
+    // Events that do not fit are dropped
+    NlGameEvents smallEvents;
+    nlGameEventsInit(&smallEvents, eventBuffer, 1);
+    tickWithEvents(&game, inputs, 3, &smallEvents);
+    ASSERT_EQ(1u, smallEvents.count);
+    ASSERT_EQ(1u, smallEvents.droppedCount);
+}
+
+static void tickWithStats(NlGame* game, NlGame* gameWithoutStats, const NlPlayerInputWithParticipantInfo* inputs,
+                          NlMatchStats* stats)
+{
+    NlGameTickOutput output;
+    output.footprint = 0;
+    output.events = 0;
+    output.stats = stats;
+    nlGameTickWithOutput(game, inputs, 2, &output, 0);
+    nlGameTick(gameWithoutStats, inputs, 2, 0);
+}
+
+UTEST(NimbleBall, matchStats)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    NlMatchStats stats;
+    nlMatchStatsInit(&stats);
+
+    // Participant 1 (team 0) releases a kick towards the goal of team 1
+    uint8_t kickerIndex = nlGameFindSimulationPlayerFromParticipantId(&game, 1)->controllingAvatarIndex;
+    NlAvatar* kicker = &game.avatars.avatars[kickerIndex];
+    kicker->circle.center.x = 500.0f;
+    kicker->circle.center.y = 160.0f;
+    kicker->visualRotation = 0.0f;
+    kicker->kickPower = 40;
+    game.ball.circle.center.x = 535.0f;
+    game.ball.circle.center.y = 160.0f;
+    game.ball.velocity = blVector2Zero();
+
+    NlGame gameWithoutStats = game;
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[0], 1, 0, 0, 0);
+    setInGameInput(&inputs[1], 2, 0, 0, 0);
+    inputs[1].playerInput.input.inGameInput.verticalAxis = 40;
+
+    for (size_t i = 0; i < 60 && game.phase == NlGamePhasePlaying; ++i) {
+        tickWithStats(&game, &gameWithoutStats, inputs, &stats);
+    }
+    ASSERT_EQ(NlGamePhaseAfterAGoal, game.phase);
+
+    ASSERT_EQ(0, memcmp(&game, &gameWithoutStats, sizeof(NlGame)));
+
+    ASSERT_EQ(1, stats.teams[0].kickCount);
+    ASSERT_EQ(1, stats.teams[0].shotCount);
+    ASSERT_EQ(1, stats.teams[0].goalCount);
+    ASSERT_EQ(0, stats.teams[1].goalCount);
+    ASSERT_EQ(1, stats.avatars[kickerIndex].goalCount);
+    ASSERT_EQ(stats.playedTickCount, stats.teams[0].possessionTicks);
+    ASSERT_EQ(0u, stats.teams[1].possessionTicks);
+    ASSERT_TRUE(stats.teams[1].distanceCovered > 1.0f);
+    ASSERT_EQ(NL_AVATAR_INDEX_UNDEFINED, stats.lastTouchedAvatarIndex);
+    ASSERT_FALSE(stats.isMatchOver);
+
+    while (game.phase != NlGamePhasePlaying) {
+        tickWithStats(&game, &gameWithoutStats, inputs, &stats);
+    }
+
+    // Another avatar in the slot of the kicker does not inherit the stats, the team keeps them
+    game.avatars.avatars[kickerIndex].generation++;
+    gameWithoutStats.avatars.avatars[kickerIndex].generation++;
+    tickWithStats(&game, &gameWithoutStats, inputs, &stats);
+    ASSERT_EQ(0, stats.avatars[kickerIndex].goalCount);
+    ASSERT_EQ(0, stats.avatars[kickerIndex].kickCount);
+    ASSERT_EQ(1, stats.teams[0].goalCount);
+
+    uint32_t playedTickCount = stats.playedTickCount;
+    game.matchClockLeftInTicks = 0;
+    tickWithStats(&game, &gameWithoutStats, inputs, &stats);
+    ASSERT_EQ(NlGamePhasePostGame, game.phase);
+    ASSERT_TRUE(stats.isMatchOver);
+    ASSERT_EQ(playedTickCount + 1, stats.playedTickCount);
+}
+
+static void assertForkMatchesGame(int* utest_result, const NlGameFork* fork, const NlGame* game)
+{
+    ASSERT_EQ(game->avatars.avatarCount, fork->avatars.avatarCount);
+    for (size_t i = 0; i < fork->avatars.avatarCount; ++i) {
+        const NlAvatar* forkAvatar = &fork->avatars.avatars[i];
+        ASSERT_EQ(0, memcmp(forkAvatar, &game->avatars.avatars[forkAvatar->avatarIndex], sizeof(NlAvatar)));
+    }
+    ASSERT_EQ(0, memcmp(&fork->ball, &game->ball, sizeof(NlBall)));
+    ASSERT_EQ(0, memcmp(&fork->teams, &game->teams, sizeof(NlTeams)));
+    ASSERT_EQ(game->phase, fork->phase);
+    ASSERT_EQ(game->phaseCountDown, fork->phaseCountDown);
+    ASSERT_EQ(game->matchClockLeftInTicks, fork->matchClockLeftInTicks);
+}
+
+UTEST(NimbleBall, forkTickMatchesGameTick)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    // Get the ball moving between the avatars so dribbles, kicks and tackles happen
+    NlAvatar* kicker = &game.avatars.avatars[nlGameFindSimulationPlayerFromParticipantId(&game, 1)
+                                                 ->controllingAvatarIndex];
+    kicker->circle.center.x = 300.0f;
+    kicker->circle.center.y = 160.0f;
+    kicker->kickPower = 30;
+    game.ball.circle.center.x = 335.0f;
+    game.ball.circle.center.y = 160.0f;
+
+    NlGameFork fork;
+    nlGameFork(&fork, &game);
+    NlGameFork copiedFork;
+    nlGameForkCopy(&copiedFork, &fork);
+    assertForkMatchesGame(utest_result, &copiedFork, &game);
+
+    for (size_t tick = 0; tick < 200 && game.phase == NlGamePhasePlaying; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        NlPlayerInGameInput forkInputs[2];
+        for (uint8_t participantId = 1; participantId <= 2; ++participantId) {
+            NlPlayerInputWithParticipantInfo* input = &inputs[participantId - 1];
+            setInGameInput(input, participantId, (int8_t) (participantId == 1 ? 40 : -40), 0, 0);
+            input->playerInput.input.inGameInput.verticalAxis = (int8_t) ((tick % 40) < 20 ? 20 : -20);
+            input->playerInput.input.inGameInput.buttons = (uint8_t) ((tick % 30) < 10 ? 0x01 : 0) |
+                                                           (uint8_t) (tick % 50 == 25 ? 0x02 : 0);
+
+            uint8_t avatarIndex = nlGameFindSimulationPlayerFromParticipantId(&game, participantId)
+                                      ->controllingAvatarIndex;
+            for (size_t i = 0; i < copiedFork.avatars.avatarCount; ++i) {
+                if (copiedFork.avatars.avatars[i].avatarIndex == avatarIndex) {
+                    forkInputs[i] = input->playerInput.input.inGameInput;
+                }
+            }
+        }
+
+        nlGameTick(&game, inputs, 2, 0);
+        nlGameForkTick(&copiedFork, forkInputs);
+        assertForkMatchesGame(utest_result, &copiedFork, &game);
+    }
+    ASSERT_TRUE(kicker->kickedCounter > 0);
+}
+
+UTEST(NimbleBall, ballPredictionMatchesTicking)
+{
+    const BlVector2 velocities[] = {{9.0f, 3.0f}, {-12.0f, 7.0f}, {0.5f, 0.0f}, {0.0f, 0.0f}, {2.0f, -1.0f}};
+    const uint32_t tickCounts[] = {1, 5, 50, 150, 400};
+
+    for (size_t velocityIndex = 0; velocityIndex < sizeof(velocities) / sizeof(velocities[0]); ++velocityIndex) {
+        NlGame game;
+        nlGameInit(&game);
+        NlBall start = game.ball;
+        start.circle.center.x = 320.0f;
+        start.circle.center.y = 180.0f;
+        start.velocity = velocities[velocityIndex];
+
+        for (size_t countIndex = 0; countIndex < sizeof(tickCounts) / sizeof(tickCounts[0]); ++countIndex) {
+            uint32_t tickCount = tickCounts[countIndex];
+            NlBall ticked = start;
+            uint32_t wallHitTicks[NL_BALL_PREDICTION_MAX_WALL_HITS];
+            size_t wallHitCount = 0;
+            for (uint32_t tick = 1; tick <= tickCount; ++tick) {
+                if (nlBallTick(&ticked, nlGameRules(&game)) && wallHitCount < NL_BALL_PREDICTION_MAX_WALL_HITS) {
+                    wallHitTicks[wallHitCount++] = tick;
+                }
+            }
+
+            NlBallPrediction prediction;
+            nlBallPredict(&start, nlGameRules(&game), tickCount, &prediction);
+
+            ASSERT_NEAR(ticked.circle.center.x, prediction.ball.circle.center.x, 0.05f);
+            ASSERT_NEAR(ticked.circle.center.y, prediction.ball.circle.center.y, 0.05f);
+            ASSERT_NEAR(ticked.velocity.x, prediction.ball.velocity.x, 0.01f);
+            ASSERT_NEAR(ticked.velocity.y, prediction.ball.velocity.y, 0.01f);
+            ASSERT_EQ(wallHitCount, prediction.wallHitCount);
+            for (size_t i = 0; i < wallHitCount; ++i) {
+                ASSERT_EQ(wallHitTicks[i], prediction.wallHitTicks[i]);
+            }
+        }
+    }
+}
+
+UTEST(NimbleBall, ballPredictionSkipsStraightStretches)
+{
+    NlGame game;
+    nlGameInit(&game);
+    NlBall ball = game.ball;
+    ball.circle.center.x = 320.0f;
+    ball.circle.center.y = 180.0f;
+    ball.velocity.x = 1.5f;
+    ball.velocity.y = 0.0f;
+
+    NlBallPrediction prediction;
+    nlBallPredict(&ball, nlGameRules(&game), 100, &prediction);
+    ASSERT_EQ(0, prediction.wallHitCount);
+    ASSERT_LT(prediction.exactTickCount, (size_t) 4);
+
+    NlBallPrediction longPrediction;
+    nlBallPredict(&ball, nlGameRules(&game), 100000, &longPrediction);
+    ASSERT_LT(longPrediction.exactTickCount, (size_t) 4);
+    ASSERT_EQ(0.0f, longPrediction.ball.velocity.x);
+}
+
+UTEST(NimbleBall, fastBallBouncesOnBorder)
+{
+    NlGame game;
+    nlGameInit(&game);
+    NlBall ball = game.ball;
+    ball.circle.center.x = 320.0f;
+    ball.circle.center.y = 45.0f;
+    ball.velocity.x = 0.0f;
+    ball.velocity.y = -50.0f;
+
+    // Would end up on the other side of the lower border if only checked after the move
+    ASSERT_TRUE(nlBallTick(&ball, nlGameRules(&game)));
+    ASSERT_GT(ball.velocity.y, 0.0f);
+    ASSERT_GE(ball.circle.center.y, g_nlConstants.borderSegments[0].a.y + ball.circle.radius - 0.5f);
+}
+
+UTEST(NimbleBall, slowBallBouncesAsBefore)
+{
+    NlGame game;
+    nlGameInit(&game);
+    NlBall ball = game.ball;
+    ball.circle.center.x = 320.0f;
+    ball.circle.center.y = 40.0f;
+    ball.velocity.x = 3.0f;
+    ball.velocity.y = -9.0f;
+
+    // Slower than its radius per tick, so it is moved first and pushed out of the border after
+    ASSERT_FALSE(nlBallTick(&ball, nlGameRules(&game)));
+    ASSERT_TRUE(nlBallTick(&ball, nlGameRules(&game)));
+    ASSERT_NEAR(30.10f, ball.circle.center.y, 0.01f);
+    ASSERT_EQ(1, ball.collideCounter);
+}
+
+UTEST(NimbleBall, fastBallThroughGoalScores)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+    int scoreBefore = game.teams.teams[0].score;
+
+    const NlGoal* goal = &g_nlConstants.goals[1];
+    game.ball.circle.center.x = goal->rect.position.x - 15.0f;
+    game.ball.circle.center.y = goal->rect.position.y + goal->rect.size.y / 2;
+    game.ball.velocity.x = 90.0f;
+    game.ball.velocity.y = 0.0f;
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[0], 1, 0, 0, 0);
+    setInGameInput(&inputs[1], 2, 0, 0, 0);
+    nlGameTick(&game, inputs, 2, 0);
+
+    ASSERT_EQ(NlGamePhaseAfterAGoal, game.phase);
+    ASSERT_EQ(scoreBefore + 1, game.teams.teams[0].score);
+}
+
+UTEST(NimbleBall, tickRateKeepsTimeAndMotionPerSecond)
+{
+    NlGame defaultGame;
+    nlGameInit(&defaultGame);
+    NlGame slowGame;
+    nlGameInitWithTickDuration(&slowGame, 32);
+
+    const NlTickRate* defaultTickRate = &nlGameRules(&defaultGame)->tickRate;
+    const NlTickRate* slowTickRate = &nlGameRules(&slowGame)->tickRate;
+    ASSERT_EQ(defaultTickRate->matchDurationInTicks, slowTickRate->matchDurationInTicks * 2);
+    ASSERT_EQ(defaultTickRate->countDownTicks, slowTickRate->countDownTicks * 2);
+    ASSERT_EQ(defaultTickRate->maxKickPowerTicks, slowTickRate->maxKickPowerTicks * 2);
+
+    // Roll the ball without touching the borders for the same amount of time
+    NlBall defaultBall = defaultGame.ball;
+    NlBall slowBall = slowGame.ball;
+    for (size_t tick = 0; tick < 60; ++tick) {
+        nlBallTick(&defaultBall, nlGameRules(&defaultGame));
+        if ((tick % 2) == 1) {
+            nlBallTick(&slowBall, nlGameRules(&slowGame));
+        }
+    }
+
+    float travelled = blVector2Length(blVector2Sub(defaultBall.circle.center, defaultGame.ball.circle.center));
+    ASSERT_GT(travelled, 50.0f);
+    ASSERT_NEAR(defaultBall.circle.center.x, slowBall.circle.center.x, travelled * 0.02f);
+    ASSERT_NEAR(defaultBall.circle.center.y, slowBall.circle.center.y, travelled * 0.02f);
+    ASSERT_NEAR(defaultBall.velocity.x * 2.0f, slowBall.velocity.x, 0.01f);
+}
+
+UTEST(NimbleBall, defaultRulesetDerivesDefaultConstants)
+{
+    NlConstants constants;
+    nlConstantsInit(&constants, &g_nlDefaultRuleset);
+
+    for (size_t i = 0; i < 2; ++i) {
+        ASSERT_EQ(g_nlConstants.goals[i].ownedByTeam, constants.goals[i].ownedByTeam);
+        ASSERT_EQ(g_nlConstants.goals[i].facingLeft, constants.goals[i].facingLeft);
+        ASSERT_EQ(g_nlConstants.goals[i].rect.position.x, constants.goals[i].rect.position.x);
+        ASSERT_EQ(g_nlConstants.goals[i].rect.position.y, constants.goals[i].rect.position.y);
+        ASSERT_EQ(g_nlConstants.goals[i].rect.size.x, constants.goals[i].rect.size.x);
+        ASSERT_EQ(g_nlConstants.goals[i].rect.size.y, constants.goals[i].rect.size.y);
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        ASSERT_EQ(g_nlConstants.borderSegments[i].a.x, constants.borderSegments[i].a.x);
+        ASSERT_EQ(g_nlConstants.borderSegments[i].a.y, constants.borderSegments[i].a.y);
+        ASSERT_EQ(g_nlConstants.borderSegments[i].b.x, constants.borderSegments[i].b.x);
+        ASSERT_EQ(g_nlConstants.borderSegments[i].b.y, constants.borderSegments[i].b.y);
+    }
+    ASSERT_EQ(g_nlConstants.matchDurationInTicks, constants.matchDurationInTicks);
+}
+
+UTEST(NimbleBall, defaultRulesFastPathMatchesGenericPath)
+{
+    NlGame fastGame;
+    nlGameInit(&fastGame);
+    ASSERT_TRUE(fastGame.rules.isDefault);
+
+    // A copy of the default ruleset has the same rules, but is ticked through the generic path
+    NlRuleset copiedRuleset = g_nlDefaultRuleset;
+    NlGame genericGame;
+    nlGameInitWithRuleset(&genericGame, &copiedRuleset, NL_DEFAULT_TICK_DURATION_MS);
+    ASSERT_FALSE(genericGame.rules.isDefault);
+
+    startTwoPlayerMatch(&fastGame);
+    startTwoPlayerMatch(&genericGame);
+
+    for (size_t tick = 0; tick < 300; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        for (uint8_t participantId = 1; participantId <= 2; ++participantId) {
+            NlPlayerInputWithParticipantInfo* input = &inputs[participantId - 1];
+            setInGameInput(input, participantId, (int8_t) (participantId == 1 ? 40 : -40), 0, 0);
+            input->playerInput.input.inGameInput.verticalAxis = (int8_t) ((tick % 40) < 20 ? 20 : -20);
+            input->playerInput.input.inGameInput.buttons = (uint8_t) ((tick % 30) < 10 ? 0x01 : 0) |
+                                                           (uint8_t) (tick % 50 == 25 ? 0x02 : 0);
+        }
+        nlGameTick(&fastGame, inputs, 2, 0);
+        nlGameTick(&genericGame, inputs, 2, 0);
+    }
+
+    ASSERT_EQ(fastGame.phase, genericGame.phase);
+    ASSERT_EQ(fastGame.ball.circle.center.x, genericGame.ball.circle.center.x);
+    ASSERT_EQ(fastGame.ball.circle.center.y, genericGame.ball.circle.center.y);
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        ASSERT_EQ(fastGame.avatars.avatars[i].circle.center.x, genericGame.avatars.avatars[i].circle.center.x);
+        ASSERT_EQ(fastGame.avatars.avatars[i].circle.center.y, genericGame.avatars.avatars[i].circle.center.y);
+        ASSERT_EQ(fastGame.avatars.avatars[i].kickedCounter, genericGame.avatars.avatars[i].kickedCounter);
+    }
+}
+
+UTEST(NimbleBall, rulesetChangesArena)
+{
+    NlRuleset ruleset = g_nlDefaultRuleset;
+    ruleset.arenaWidth += 100.0f;
+    ruleset.goalSize = 120.0f;
+    ruleset.matchDurationInTicks = 1000;
+
+    NlGame game;
+    nlGameInitWithRuleset(&game, &ruleset, NL_DEFAULT_TICK_DURATION_MS);
+
+    ASSERT_EQ(g_nlConstants.goals[1].rect.position.x + 100.0f, nlGameRules(&game)->constants.goals[1].rect.position.x);
+    ASSERT_EQ(120.0f, nlGameRules(&game)->constants.goals[0].rect.size.y);
+    ASSERT_EQ(1000, game.matchClockLeftInTicks);
+
+    // The ball bounces on the moved right border instead of the default one
+    NlBall ball = game.ball;
+    ball.circle.center.x = g_nlConstants.borderSegments[4].a.x + 30.0f;
+    ball.circle.center.y = g_nlConstants.borderSegments[4].b.y + 30.0f;
+    ball.velocity.x = 4.0f;
+    ball.velocity.y = 0.0f;
+    for (size_t tick = 0; tick < 10; ++tick) {
+        ASSERT_FALSE(nlBallTick(&ball, nlGameRules(&game)));
+    }
+    ASSERT_GT(ball.circle.center.x, g_nlConstants.borderSegments[4].a.x + 60.0f);
+}
+
+UTEST(NimbleBall, rulesAreReferencedByTheGame)
+{
+    NlRuleset ruleset = g_nlDefaultRuleset;
+    ruleset.goalSize = 90.0f;
+
+    NlGame game;
+    nlGameInitWithRuleset(&game, &ruleset, 20);
+    NlGame sameRulesGame;
+    nlGameInitWithRuleset(&sameRulesGame, &ruleset, 20);
+    NlGame otherDurationGame;
+    nlGameInitWithRuleset(&otherDurationGame, &ruleset, 24);
+
+    ASSERT_NE(NL_DEFAULT_RULES_ID, game.rules.id);
+    ASSERT_EQ(game.rules.id, sameRulesGame.rules.id);
+    ASSERT_NE(game.rules.id, otherDurationGame.rules.id);
+    ASSERT_EQ(90.0f, nlGameRules(&game)->ruleset.goalSize);
+    ASSERT_EQ(20, nlGameRules(&game)->tickRate.tickDurationMs);
+
+    NlRulesRef unknownRef;
+    unknownRef.id = NL_MAX_REGISTERED_RULES;
+    unknownRef.isDefault = false;
+    ASSERT_TRUE(nlRulesResolve(unknownRef) == 0);
+}
+
+UTEST(NimbleBall, tickRateClampsTimersThatDoNotFit)
+{
+    NlRuleset ruleset = g_nlDefaultRuleset;
+    ruleset.maxKickPowerTicks = 200;
+    ruleset.matchDurationInTicks = 60000;
+
+    NlTickRate tickRate;
+    nlTickRateInit(&tickRate, &ruleset, NL_MIN_TICK_DURATION_MS);
+
+    ASSERT_EQ(UINT8_MAX, tickRate.maxKickPowerTicks);
+    ASSERT_EQ(UINT16_MAX, tickRate.matchDurationInTicks);
+    ASSERT_EQ(g_nlDefaultRuleset.kickCooldownTicks * 2, tickRate.kickCooldownTicks);
+}
@@ -0,0 +1,97 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_baseline_manager.h>
+
+static void storeTick(NlBaselineManager* manager, uint32_t tickId)
+{
+    NlGame game;
+    nlGameInit(&game);
+    game.tickCount = (uint16_t) tickId;
+    nlBaselineManagerStore(manager, tickId, &game);
+}
+
+UTEST(NimbleBall, baselineManagerShares)
+{
+    static NlBaselineManager manager;
+    nlBaselineManagerInit(&manager);
+
+    NlBaselineClient clients[100];
+    for (size_t i = 0; i < 100; ++i) {
+        nlBaselineClientInit(&clients[i]);
+    }
+
+    uint32_t baselineTickId = 0;
+    ASSERT_TRUE(nlBaselineManagerBaseline(&manager, &clients[0], &baselineTickId) == 0);
+
+    for (uint32_t tickId = 1; tickId <= 4; ++tickId) {
+        storeTick(&manager, tickId);
+        storeTick(&manager, tickId);
+    }
+    ASSERT_EQ(4u, manager.stats.storeCount);
+
+    // Most clients ack the same few ticks and share the stored state
+    for (size_t i = 0; i < 100; ++i) {
+        nlBaselineManagerAck(&manager, &clients[i], 2 + (uint32_t) (i % 2));
+    }
+
+    const NlGame* first = nlBaselineManagerBaseline(&manager, &clients[0], &baselineTickId);
+    ASSERT_EQ(2u, baselineTickId);
+    ASSERT_EQ(2, first->tickCount);
+    ASSERT_TRUE(first == nlBaselineManagerBaseline(&manager, &clients[2], &baselineTickId));
+    ASSERT_EQ(3u, nlBaselineManagerBaseline(&manager, &clients[1], &baselineTickId)->tickCount);
+
+    // Older and unknown acks keep the current baseline
+    nlBaselineManagerAck(&manager, &clients[0], 1);
+    nlBaselineManagerAck(&manager, &clients[0], 99);
+    nlBaselineManagerBaseline(&manager, &clients[0], &baselineTickId);
+    ASSERT_EQ(2u, baselineTickId);
+
+    nlBaselineManagerAck(&manager, &clients[0], 4);
+    nlBaselineManagerBaseline(&manager, &clients[0], &baselineTickId);
+    ASSERT_EQ(4u, baselineTickId);
+}
+
+UTEST(NimbleBall, baselineManagerEviction)
+{
+    static NlBaselineManager manager;
+    nlBaselineManagerInit(&manager);
+
+    NlBaselineClient slowClient;
+    nlBaselineClientInit(&slowClient);
+    NlBaselineClient client;
+    nlBaselineClientInit(&client);
+
+    storeTick(&manager, 1);
+    nlBaselineManagerAck(&manager, &slowClient, 1);
+
+    // States that a client uses are kept while there are others to evict
+    uint32_t tickId = 2;
+    for (; tickId < 2 + NL_BASELINE_MANAGER_CAPACITY * 2; ++tickId) {
+        storeTick(&manager, tickId);
+        nlBaselineManagerAck(&manager, &client, tickId);
+    }
+    uint32_t baselineTickId = 0;
+    ASSERT_TRUE(nlBaselineManagerBaseline(&manager, &slowClient, &baselineTickId) != 0);
+    ASSERT_EQ(1u, baselineTickId);
+    ASSERT_EQ(0u, manager.stats.evictedWithClientsCount);
+
+    // When every state has clients, the oldest is evicted and its clients fall back to full snapshots
+    NlBaselineClient pinningClients[NL_BASELINE_MANAGER_CAPACITY];
+    for (size_t i = 0; i < NL_BASELINE_MANAGER_CAPACITY; ++i) {
+        nlBaselineClientInit(&pinningClients[i]);
+        storeTick(&manager, tickId);
+        nlBaselineManagerAck(&manager, &pinningClients[i], tickId);
+        tickId++;
+    }
+    ASSERT_TRUE(manager.stats.evictedWithClientsCount > 0);
+    size_t fallbackCount = manager.stats.fallbackCount;
+    ASSERT_TRUE(nlBaselineManagerBaseline(&manager, &slowClient, &baselineTickId) == 0);
+    ASSERT_EQ(fallbackCount + 1, manager.stats.fallbackCount);
+
+    nlBaselineManagerRemoveClient(&manager, &slowClient);
+    nlBaselineManagerRemoveClient(&manager, &pinningClients[NL_BASELINE_MANAGER_CAPACITY - 1]);
+}
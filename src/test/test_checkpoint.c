@@ -0,0 +1,148 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_checkpoint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !defined _WIN32
+
+#define CHECKPOINT_TEST_PATH "nimble_ball_checkpoint_test.bin"
+#define CHECKPOINT_TEST_SLOT_COUNT (6)
+#define CHECKPOINT_TEST_MATCH_COUNT (4)
+
+static void tickHostedMatch(NlSimulationVm* vm, NlCheckpointInputs* recentInputs, size_t tickCount, int8_t axis)
+{
+    for (size_t i = 0; i < tickCount; ++i) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        for (uint8_t participant = 0; participant < 2; ++participant) {
+            uint8_t participantId = (uint8_t) (participant + 1);
+            if (vm->game.tickCount == 0) {
+                setSelectTeamInput(&inputs[participant], participantId, participant);
+            } else {
+                setInGameInput(&inputs[participant], participantId, participant == 0 ? axis : (int8_t) -axis,
+                               (int8_t) (i % 60 < 30 ? 40 : -40), (uint8_t) (i % 20 < 5 ? 0x01 : 0));
+            }
+        }
+        nlCheckpointInputsAdd(recentInputs, vm->game.tickCount, inputs, 2);
+        nlGameTick(&vm->game, inputs, 2, 0);
+    }
+}
+
+UTEST(NimbleBall, checkpointResumesHostedMatches)
+{
+    Clog log;
+    log.config = &g_clog;
+    log.constantPrefix = "Checkpoint";
+
+    static NlSimulationVm vms[CHECKPOINT_TEST_MATCH_COUNT];
+    static NlCheckpointInputs recentInputs[CHECKPOINT_TEST_MATCH_COUNT];
+    remove(CHECKPOINT_TEST_PATH);
+
+    // Two matches with the default rules and two with a variant ruleset at other tick durations
+    NlRuleset ruleset = g_nlDefaultRuleset;
+    ruleset.goalSize = 100.0f;
+    const uint16_t tickDurations[CHECKPOINT_TEST_MATCH_COUNT] = {NL_DEFAULT_TICK_DURATION_MS, 20, 24, 32};
+
+    NlCheckpointFile file;
+    ASSERT_EQ(0, nlCheckpointFileOpen(&file, CHECKPOINT_TEST_PATH, CHECKPOINT_TEST_SLOT_COUNT));
+    for (size_t i = 0; i < CHECKPOINT_TEST_MATCH_COUNT; ++i) {
+        nlSimulationVmInitWithTickDuration(&vms[i], tickDurations[i], log);
+        nlGameInitWithRuleset(&vms[i].game, i < 2 ? &g_nlDefaultRuleset : &ruleset, tickDurations[i]);
+        nlCheckpointInputsInit(&recentInputs[i]);
+        tickHostedMatch(&vms[i], &recentInputs[i], 200 + i * 50, (int8_t) (30 + i * 40));
+        ASSERT_EQ(0, nlCheckpointFileWrite(&file, i + 1, 1000 + i, &vms[i], &recentInputs[i]));
+    }
+    nlCheckpointFileClose(&file);
+
+    // A restarted process maps the same file and continues the matches
+    static NlCheckpointMatch match;
+    ASSERT_EQ(0, nlCheckpointFileOpen(&file, CHECKPOINT_TEST_PATH, CHECKPOINT_TEST_SLOT_COUNT));
+    ASSERT_FALSE(nlCheckpointFileRead(&file, 0, &match));
+    for (size_t restoreIndex = 0; restoreIndex < CHECKPOINT_TEST_MATCH_COUNT; ++restoreIndex) {
+        // Restored in the opposite order, so a new process would hand out other rules ids
+        size_t i = CHECKPOINT_TEST_MATCH_COUNT - 1 - restoreIndex;
+        ASSERT_TRUE(nlCheckpointFileRead(&file, i + 1, &match));
+        ASSERT_EQ(1000u + i, match.matchId);
+        ASSERT_EQ(0, memcmp(&vms[i].game, &match.game, sizeof(NlGame)));
+        const NlCheckpointTickInputs* latest = nlCheckpointInputsGet(&match.inputs, 0);
+        ASSERT_TRUE(latest != 0);
+        ASSERT_EQ(vms[i].game.tickCount - 1u, latest->tickId);
+
+        ASSERT_EQ(tickDurations[i], match.tickDurationMs);
+        match.game.rules.id = NL_INVALID_RULES_ID;
+
+        static NlSimulationVm resumedVm;
+        static NlCheckpointInputs resumedInputs;
+        ASSERT_EQ(0, nlCheckpointMatchRestoreVm(&match, &resumedVm, log));
+        ASSERT_EQ(tickDurations[i], nlGameRules(&resumedVm.game)->tickRate.tickDurationMs);
+        resumedInputs = match.inputs;
+        tickHostedMatch(&resumedVm, &resumedInputs, 100, 50);
+        tickHostedMatch(&vms[i], &recentInputs[i], 100, 50);
+        ASSERT_EQ(0, memcmp(&vms[i].game, &resumedVm.game, sizeof(NlGame)));
+    }
+
+    nlCheckpointFileClearSlot(&file, 2);
+    ASSERT_FALSE(nlCheckpointFileRead(&file, 2, &match));
+    nlCheckpointFileClose(&file);
+
+    // The slot count is part of the file layout
+    ASSERT_TRUE(nlCheckpointFileOpen(&file, CHECKPOINT_TEST_PATH, CHECKPOINT_TEST_SLOT_COUNT + 1) < 0);
+    remove(CHECKPOINT_TEST_PATH);
+}
+
+UTEST(NimbleBall, checkpointFallsBackToIntactCopy)
+{
+    Clog log;
+    log.config = &g_clog;
+    log.constantPrefix = "Checkpoint";
+
+    static NlSimulationVm vm;
+    static NlCheckpointInputs recentInputs;
+    static NlCheckpointMatch match;
+    remove(CHECKPOINT_TEST_PATH);
+
+    NlCheckpointFile file;
+    ASSERT_EQ(0, nlCheckpointFileOpen(&file, CHECKPOINT_TEST_PATH, 1));
+    nlSimulationVmInit(&vm, log);
+    nlGameInit(&vm.game);
+    nlCheckpointInputsInit(&recentInputs);
+
+    tickHostedMatch(&vm, &recentInputs, 120, 60);
+    ASSERT_EQ(0, nlCheckpointFileWrite(&file, 0, 7, &vm, &recentInputs));
+    uint16_t firstTickCount = vm.game.tickCount;
+    tickHostedMatch(&vm, &recentInputs, 60, 60);
+    ASSERT_EQ(0, nlCheckpointFileWrite(&file, 0, 7, &vm, &recentInputs));
+
+    ASSERT_TRUE(nlCheckpointFileRead(&file, 0, &match));
+    ASSERT_EQ(2u, match.sequence);
+    ASSERT_EQ(vm.game.tickCount, match.game.tickCount);
+
+    // Simulate that the newest copy, the second in the slot, was only partly written back
+    size_t copyOctetCount = (file.octetCount - 64) / 2;
+    file.octets[file.octetCount - copyOctetCount / 2] ^= 0xff;
+
+    ASSERT_TRUE(nlCheckpointFileRead(&file, 0, &match));
+    ASSERT_EQ(1u, match.sequence);
+    ASSERT_EQ(firstTickCount, match.game.tickCount);
+
+    // The next write replaces the broken copy, not the only intact one with the lower sequence
+    tickHostedMatch(&vm, &recentInputs, 60, 60);
+    ASSERT_EQ(0, nlCheckpointFileWrite(&file, 0, 7, &vm, &recentInputs));
+    ASSERT_TRUE(nlCheckpointFileRead(&file, 0, &match));
+    ASSERT_EQ(3u, match.sequence);
+    ASSERT_EQ(vm.game.tickCount, match.game.tickCount);
+
+    file.octets[file.octetCount - copyOctetCount / 2] ^= 0xff;
+    ASSERT_TRUE(nlCheckpointFileRead(&file, 0, &match));
+    ASSERT_EQ(1u, match.sequence);
+
+    nlCheckpointFileClose(&file);
+    remove(CHECKPOINT_TEST_PATH);
+}
+
+#endif
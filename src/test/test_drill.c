@@ -0,0 +1,122 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+static void randomDrillInputs(NlPlayerInputWithParticipantInfo* inputs, size_t tick, uint32_t* seed)
+{
+    for (uint8_t i = 0; i < 2; ++i) {
+        *seed = *seed * 1664525u + 1013904223u;
+        setInGameInput(&inputs[i], (uint8_t) (i + 1), (int8_t) (*seed >> 24), (int8_t) (*seed >> 16),
+                       (uint8_t) ((tick % 30) < 10 ? 0x01 : 0));
+    }
+}
+
+UTEST(NimbleBall, drillWithOneBallMatchesGame)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    NlGame drillGame = game;
+    NlDrill drill;
+    nlDrillInit(&drill, &drillGame, 1);
+    nlDrillSetBall(&drill, 0, &game.ball);
+
+    uint32_t seed = 7;
+    size_t comparedTicks = 0;
+    for (size_t tick = 0; tick < 600 && game.phase == NlGamePhasePlaying; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        randomDrillInputs(inputs, tick, &seed);
+        nlGameTick(&game, inputs, 2, 0);
+        nlGameTickDrill(&drillGame, &drill, inputs, 2, 0);
+        if (game.phase != NlGamePhasePlaying) {
+            break;
+        }
+
+        NlBall ball;
+        nlDrillBall(&drill, 0, &ball);
+        ASSERT_EQ(game.ball.circle.center.x, ball.circle.center.x);
+        ASSERT_EQ(game.ball.circle.center.y, ball.circle.center.y);
+        ASSERT_EQ(game.ball.velocity.x, ball.velocity.x);
+        ASSERT_EQ(game.ball.velocity.y, ball.velocity.y);
+        ASSERT_EQ(game.ball.collideCounter, ball.collideCounter);
+        for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+            ASSERT_EQ(game.avatars.avatars[i].circle.center.x, drillGame.avatars.avatars[i].circle.center.x);
+            ASSERT_EQ(game.avatars.avatars[i].circle.center.y, drillGame.avatars.avatars[i].circle.center.y);
+        }
+        comparedTicks++;
+    }
+
+    ASSERT_TRUE(comparedTicks > 100);
+}
+
+UTEST(NimbleBall, drillKicksOnlyClosestBall)
+{
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+
+    const NlPlayer* player = nlGameFindSimulationPlayerFromParticipantId(&game, 1);
+    const NlAvatar* avatar = &game.avatars.avatars[player->controllingAvatarIndex];
+    BlVector2 avatarPosition = avatar->circle.center;
+
+    // Both balls are within kick reach, only the closest one is within dribble reach
+    NlDrill drill;
+    nlDrillInit(&drill, &game, 3);
+    NlBall ball;
+    nlDrillBall(&drill, 0, &ball);
+    ball.circle.center.x = avatarPosition.x + avatar->circle.radius + 5.0f;
+    ball.circle.center.y = avatarPosition.y;
+    nlDrillSetBall(&drill, 1, &ball);
+    ball.circle.center.x = avatarPosition.x - avatar->circle.radius * 2.0f - 5.0f;
+    nlDrillSetBall(&drill, 2, &ball);
+    NlBall untouchedBefore;
+    nlDrillBall(&drill, 0, &untouchedBefore);
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[1], 2, 0, 0, 0);
+    for (size_t tick = 0; tick < 20; ++tick) {
+        setInGameInput(&inputs[0], 1, 0, 0, (uint8_t) (tick < 10 ? 0x01 : 0));
+        nlGameTickDrill(&game, &drill, inputs, 2, 0);
+    }
+
+    NlBall kicked;
+    NlBall behind;
+    NlBall untouched;
+    nlDrillBall(&drill, 1, &kicked);
+    nlDrillBall(&drill, 2, &behind);
+    nlDrillBall(&drill, 0, &untouched);
+    ASSERT_EQ(1, game.avatars.avatars[player->controllingAvatarIndex].kickedCounter);
+    ASSERT_TRUE(blVector2Length(kicked.velocity) > 1.0f);
+    ASSERT_EQ(0.0f, behind.velocity.x);
+    ASSERT_EQ(0.0f, behind.velocity.y);
+    ASSERT_EQ(untouchedBefore.circle.center.x, untouched.circle.center.x);
+    ASSERT_EQ(untouchedBefore.circle.center.y, untouched.circle.center.y);
+}
+
+#define DRILL_FULL_TICK_COUNT (600)
+
+// Every ball stays in play with the most balls a drill can have, timings are in the drill benchmark
+UTEST(NimbleBall, drillKeepsAllBalls)
+{
+    static NlDrill drill;
+    NlGame game;
+    nlGameInit(&game);
+    startTwoPlayerMatch(&game);
+    nlDrillInit(&drill, &game, NL_DRILL_MAX_BALLS);
+
+    uint32_t seed = 11;
+    for (size_t tick = 0; tick < DRILL_FULL_TICK_COUNT; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        randomDrillInputs(inputs, tick, &seed);
+        nlGameTickDrill(&game, &drill, inputs, 2, 0);
+    }
+
+    ASSERT_EQ(NlGamePhasePlaying, game.phase);
+    ASSERT_EQ((size_t) NL_DRILL_MAX_BALLS, (size_t) drill.balls.count);
+}
@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_input_predictor.h>
+
+static NlPlayerInput inGameInput(int8_t horizontalAxis, uint8_t buttons)
+{
+    NlPlayerInput input;
+    input.inputType = NlPlayerInputTypeInGame;
+    input.input.inGameInput.horizontalAxis = horizontalAxis;
+    input.input.inGameInput.verticalAxis = 0;
+    input.input.inGameInput.buttons = buttons;
+    return input;
+}
+
+UTEST(NimbleBall, inputPredictionPolicies)
+{
+    NlPlayerInput previous = inGameInput(100, 0x03);
+
+    NlPlayerInput forced = nlInputPredictionStep(NlInputPredictionPolicyForced, &previous);
+    ASSERT_EQ(NlPlayerInputTypeForced, forced.inputType);
+
+    NlPlayerInput held = nlInputPredictionStep(NlInputPredictionPolicyHoldLast, &previous);
+    ASSERT_TRUE(nlPlayerInputIsEqual(&previous, &held));
+
+    NlPlayerInput released = nlInputPredictionStep(NlInputPredictionPolicyReleaseSlideTackle, &previous);
+    ASSERT_EQ(100, released.input.inGameInput.horizontalAxis);
+    ASSERT_EQ(0x01, released.input.inGameInput.buttons);
+
+    NlPlayerInput decayed = previous;
+    for (size_t i = 0; i < 32; ++i) {
+        decayed = nlInputPredictionStep(NlInputPredictionPolicyDecayToNeutral, &decayed);
+    }
+    ASSERT_EQ(0, decayed.input.inGameInput.horizontalAxis);
+}
+
+UTEST(NimbleBall, inputPredictorTelemetry)
+{
+    NlInputPredictor predictor;
+    nlInputPredictorInit(&predictor, NlInputPredictionPolicyHoldLast);
+
+    NlPlayerInput first = inGameInput(40, 0);
+    nlInputPredictorConfirm(&predictor, 5, 10, &first);
+
+    for (uint32_t tickId = 11; tickId <= 16; ++tickId) {
+        NlPlayerInput predicted = nlInputPredictorPredict(&predictor, 5, tickId);
+        ASSERT_TRUE(nlPlayerInputIsEqual(&first, &predicted));
+    }
+
+    ASSERT_FALSE(nlInputPredictorConfirm(&predictor, 5, 11, &first));
+
+    NlPlayerInput changed = inGameInput(-40, 0);
+    ASSERT_TRUE(nlInputPredictorConfirm(&predictor, 5, 12, &changed));
+
+    const NlInputPredictorStats* stats = &predictor.participants[5].stats;
+    ASSERT_EQ(6u, stats->predictionCount);
+    ASSERT_EQ(2u, stats->confirmedCount);
+    ASSERT_EQ(1u, stats->mispredictionCount);
+    ASSERT_EQ(5u, stats->maxRollbackDepth);
+    ASSERT_EQ(0.5f, nlInputPredictorMispredictionRate(&predictor, 5));
+    ASSERT_EQ(0.0f, nlInputPredictorMispredictionRate(&predictor, NL_MAX_PARTICIPANTS));
+
+    // Illegal participant ids from the network are predicted as forced and their inputs are ignored
+    NlPlayerInput illegalPrediction = nlInputPredictorPredict(&predictor, 0xff, 13);
+    ASSERT_EQ(NlPlayerInputTypeForced, illegalPrediction.inputType);
+    ASSERT_FALSE(nlInputPredictorConfirm(&predictor, NL_MAX_PARTICIPANTS, 13, &changed));
+
+    NlPlayerInput predictedAfterChange = nlInputPredictorPredict(&predictor, 5, 17);
+    ASSERT_TRUE(nlPlayerInputIsEqual(&changed, &predictedAfterChange));
+}
@@ -0,0 +1,125 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_input_queue.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+static void pushInput(NlInputQueue* queue, uint32_t tickId, uint8_t participantId, int8_t horizontalAxis)
+{
+    NlInputQueueEntry entry;
+    entry.tickId = tickId;
+    entry.participantId = participantId;
+    entry.entryType = NlInputQueueEntryTypeInput;
+    entry.playerInput.inputType = NlPlayerInputTypeInGame;
+    entry.playerInput.input.inGameInput.horizontalAxis = horizontalAxis;
+    entry.playerInput.input.inGameInput.verticalAxis = 0;
+    entry.playerInput.input.inGameInput.buttons = 0;
+    nlInputQueuePush(queue, &entry);
+}
+
+UTEST(NimbleBall, inputAssembly)
+{
+    static NlInputQueue queue;
+    nlInputQueueInit(&queue);
+
+    NlInputAssembly assembly;
+    nlInputAssemblyInit(&assembly, 10);
+
+    pushInput(&queue, 10, 2, 5);
+    pushInput(&queue, 11, 2, 6);
+    pushInput(&queue, 10, 7, -5);
+
+    TransmuteInput input;
+    ASSERT_EQ(10u, nlInputAssemblyNextTick(&assembly, &queue, &input));
+    ASSERT_EQ(2u, input.participantCount);
+    ASSERT_EQ(2, input.participantInputs[0].participantId);
+    ASSERT_EQ(TransmuteParticipantInputTypeNormal, input.participantInputs[0].inputType);
+    ASSERT_EQ(5, ((const NlPlayerInput*) input.participantInputs[0].input)->input.inGameInput.horizontalAxis);
+    ASSERT_EQ(7, input.participantInputs[1].participantId);
+
+    NlInputQueueEntry reconnect;
+    reconnect.tickId = 11;
+    reconnect.participantId = 7;
+    reconnect.entryType = NlInputQueueEntryTypeWaitingForReconnect;
+    nlInputQueuePush(&queue, &reconnect);
+
+    ASSERT_EQ(11u, nlInputAssemblyNextTick(&assembly, &queue, &input));
+    ASSERT_EQ(TransmuteParticipantInputTypeNormal, input.participantInputs[0].inputType);
+    ASSERT_EQ(6, ((const NlPlayerInput*) input.participantInputs[0].input)->input.inGameInput.horizontalAxis);
+    ASSERT_EQ(TransmuteParticipantInputTypeWaitingForReconnect, input.participantInputs[1].inputType);
+
+    // Participant 2 is late for tick 12
+    ASSERT_EQ(12u, nlInputAssemblyNextTick(&assembly, &queue, &input));
+    ASSERT_EQ(TransmuteParticipantInputTypeNoInputInTime, input.participantInputs[0].inputType);
+    pushInput(&queue, 12, 2, 1);
+
+    NlInputQueueEntry left;
+    left.tickId = 13;
+    left.participantId = 7;
+    left.entryType = NlInputQueueEntryTypeLeft;
+    nlInputQueuePush(&queue, &left);
+
+    ASSERT_EQ(13u, nlInputAssemblyNextTick(&assembly, &queue, &input));
+    ASSERT_EQ(1u, input.participantCount);
+    ASSERT_EQ(1u, assembly.stats.lateCount);
+    ASSERT_EQ(2u, assembly.stats.missingCount);
+}
+
+#if !defined _WIN32
+
+#define STRESS_ENTRY_COUNT (1000000u)
+
+static void* produceEntries(void* _queue)
+{
+    NlInputQueue* queue = (NlInputQueue*) _queue;
+    NlInputQueueEntry entry;
+    entry.participantId = 0;
+    entry.entryType = NlInputQueueEntryTypeInput;
+    entry.playerInput.inputType = NlPlayerInputTypeInGame;
+
+    for (uint32_t i = 0; i < STRESS_ENTRY_COUNT; ++i) {
+        entry.tickId = i;
+        entry.playerInput.input.inGameInput.horizontalAxis = (int8_t) (i % 100);
+        while (!nlInputQueuePush(queue, &entry)) {
+        }
+    }
+
+    return 0;
+}
+
+UTEST(NimbleBall, inputQueueStress)
+{
+    static NlInputQueue queue;
+    nlInputQueueInit(&queue);
+
+    pthread_t producer;
+    pthread_create(&producer, 0, produceEntries, &queue);
+
+    uint32_t expectedTickId = 0;
+    bool isInOrder = true;
+    while (expectedTickId < STRESS_ENTRY_COUNT) {
+        NlInputQueueEntry entry;
+        if (!nlInputQueuePop(&queue, &entry)) {
+            continue;
+        }
+        if (entry.tickId != expectedTickId ||
+            entry.playerInput.input.inGameInput.horizontalAxis != (int8_t) (expectedTickId % 100)) {
+            isInOrder = false;
+        }
+        expectedTickId++;
+    }
+
+    pthread_join(producer, 0);
+
+    ASSERT_TRUE(isInOrder);
+    NlInputQueueEntry entry;
+    ASSERT_FALSE(nlInputQueuePop(&queue, &entry));
+}
+
+#endif
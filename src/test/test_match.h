@@ -0,0 +1,62 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_SIMULATION_TEST_MATCH_H
+#define NIMBLE_BALL_SIMULATION_TEST_MATCH_H
+
+// Input and match setup helpers shared by the tests and the benchmarks
+
+#include <nimble-ball-simulation/nimble_ball_simulation.h>
+
+static inline void setSelectTeamPlayerInput(NlPlayerInput* input, uint8_t team)
+{
+    input->inputType = NlPlayerInputTypeSelectTeam;
+    input->input.selectTeam.preferredTeamToJoin = team;
+}
+
+static inline void setInGamePlayerInput(NlPlayerInput* input, int8_t horizontalAxis, int8_t verticalAxis,
+                                        uint8_t buttons)
+{
+    input->inputType = NlPlayerInputTypeInGame;
+    input->input.inGameInput.horizontalAxis = horizontalAxis;
+    input->input.inGameInput.verticalAxis = verticalAxis;
+    input->input.inGameInput.buttons = buttons;
+}
+
+static inline void setSelectTeamInput(NlPlayerInputWithParticipantInfo* input, uint8_t participantId, uint8_t team)
+{
+    input->participantId = participantId;
+    setSelectTeamPlayerInput(&input->playerInput, team);
+}
+
+static inline void setInGameInput(NlPlayerInputWithParticipantInfo* input, uint8_t participantId,
+                                  int8_t horizontalAxis, int8_t verticalAxis, uint8_t buttons)
+{
+    input->participantId = participantId;
+    setInGamePlayerInput(&input->playerInput, horizontalAxis, verticalAxis, buttons);
+}
+
+/// Participant 1 joins team 0 and participant 2 joins team 1, in a single tick
+static inline void joinTwoPlayers(NlGame* game)
+{
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setSelectTeamInput(&inputs[0], 1, 0);
+    setSelectTeamInput(&inputs[1], 2, 1);
+    nlGameTick(game, inputs, 2, 0);
+}
+
+/// Joins two players to an initialized game and ticks with neutral inputs until the match is playing
+static inline void startTwoPlayerMatch(NlGame* game)
+{
+    joinTwoPlayers(game);
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[0], 1, 0, 0, 0);
+    setInGameInput(&inputs[1], 2, 0, 0, 0);
+    while (game->phase != NlGamePhasePlaying) {
+        nlGameTick(game, inputs, 2, 0);
+    }
+}
+
+#endif
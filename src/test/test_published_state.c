@@ -0,0 +1,127 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_published_state.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+static void fillGame(NlGame* game, uint16_t tickCount)
+{
+    game->tickCount = tickCount;
+    game->ball.circle.center.x = (float) tickCount;
+    game->ball.circle.center.y = (float) tickCount * 2.0f;
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        game->avatars.avatars[i].circle.center.x = (float) tickCount;
+    }
+    game->matchClockLeftInTicks = (uint16_t) (0xffff - tickCount);
+}
+
+static bool isConsistent(const NlGame* game)
+{
+    uint16_t tickCount = game->tickCount;
+    if (game->ball.circle.center.x != (float) tickCount || game->ball.circle.center.y != (float) tickCount * 2.0f) {
+        return false;
+    }
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if (game->avatars.avatars[i].circle.center.x != (float) tickCount) {
+            return false;
+        }
+    }
+    return game->matchClockLeftInTicks == (uint16_t) (0xffff - tickCount);
+}
+
+UTEST(NimbleBall, publishedState)
+{
+    static NlPublishedState publishedState;
+    nlPublishedStateInit(&publishedState);
+
+    NlGame game;
+    nlGameInit(&game);
+    ASSERT_FALSE(nlPublishedStateRead(&publishedState, &game));
+
+    for (uint16_t i = 1; i < 5; ++i) {
+        fillGame(&game, i);
+        nlPublishedStatePublish(&publishedState, &game);
+    }
+
+    NlGame readGame;
+    ASSERT_TRUE(nlPublishedStateRead(&publishedState, &readGame));
+    ASSERT_EQ(0, memcmp(&game, &readGame, sizeof(NlGame)));
+}
+
+#if !defined _WIN32
+
+#define PUBLISH_STRESS_TICK_COUNT (60000)
+#define PUBLISH_STRESS_READER_COUNT (4)
+
+typedef struct PublishStressReader {
+    NlPublishedState* publishedState;
+    volatile int* isDone;
+    size_t readCount;
+    bool isAllConsistent;
+    bool isMonotonic;
+} PublishStressReader;
+
+static void* readPublishedStates(void* _reader)
+{
+    PublishStressReader* reader = (PublishStressReader*) _reader;
+    NlGame game;
+    uint16_t lastTickCount = 0;
+
+    while (!__atomic_load_n(reader->isDone, __ATOMIC_ACQUIRE)) {
+        if (!nlPublishedStateRead(reader->publishedState, &game)) {
+            continue;
+        }
+        reader->readCount++;
+        if (!isConsistent(&game)) {
+            reader->isAllConsistent = false;
+        }
+        if (game.tickCount < lastTickCount) {
+            reader->isMonotonic = false;
+        }
+        lastTickCount = game.tickCount;
+    }
+
+    return 0;
+}
+
+UTEST(NimbleBall, publishedStateStress)
+{
+    static NlPublishedState publishedState;
+    nlPublishedStateInit(&publishedState);
+
+    volatile int isDone = 0;
+    PublishStressReader readers[PUBLISH_STRESS_READER_COUNT];
+    pthread_t threads[PUBLISH_STRESS_READER_COUNT];
+
+    for (size_t i = 0; i < PUBLISH_STRESS_READER_COUNT; ++i) {
+        readers[i].publishedState = &publishedState;
+        readers[i].isDone = &isDone;
+        readers[i].readCount = 0;
+        readers[i].isAllConsistent = true;
+        readers[i].isMonotonic = true;
+        pthread_create(&threads[i], 0, readPublishedStates, &readers[i]);
+    }
+
+    NlGame game;
+    nlGameInit(&game);
+    for (uint16_t tick = 1; tick < PUBLISH_STRESS_TICK_COUNT; ++tick) {
+        fillGame(&game, tick);
+        nlPublishedStatePublish(&publishedState, &game);
+    }
+
+    __atomic_store_n(&isDone, 1, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < PUBLISH_STRESS_READER_COUNT; ++i) {
+        pthread_join(threads[i], 0);
+        ASSERT_TRUE(readers[i].isAllConsistent);
+        ASSERT_TRUE(readers[i].isMonotonic);
+    }
+}
+
+#endif
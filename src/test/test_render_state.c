@@ -0,0 +1,87 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <basal/math.h>
+#include <clog/clog.h>
+#include <math.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_render_state.h>
+
+static void setupAvatar(NlGame* game, size_t index, uint8_t generation, float x, float rotation)
+{
+    NlAvatar* avatar = &game->avatars.avatars[index];
+    game->avatars.activeMask |= (NlSlotMask) (1u << index);
+    avatar->generation = generation;
+    avatar->circle.center.x = x;
+    avatar->circle.center.y = 100.0f;
+    avatar->visualRotation = rotation;
+}
+
+UTEST(NimbleBall, renderStateInterpolate)
+{
+    NlGame from;
+    nlGameInit(&from);
+    NlGame to;
+    nlGameInit(&to);
+
+    // Rotation crosses PI, the short way is through PI and not through zero
+    setupAvatar(&from, 0, 1, 10.0f, BL_PI - 0.1f);
+    setupAvatar(&to, 0, 1, 20.0f, -BL_PI + 0.1f);
+    // Slot 3 was reused by another avatar between the ticks
+    setupAvatar(&from, 3, 1, 50.0f, 0.0f);
+    setupAvatar(&to, 3, 2, 80.0f, 1.0f);
+    // Slot 5 spawned
+    setupAvatar(&to, 5, 1, 30.0f, 0.5f);
+
+    from.ball.circle.center.x = 0.0f;
+    to.ball.circle.center.x = 8.0f;
+
+    NlRenderState state;
+    nlRenderStateInterpolate(&state, &from, &to, 0.25f);
+
+    ASSERT_EQ(to.avatars.activeMask, state.activeMask);
+    ASSERT_NEAR(12.5f, state.avatarX[0], 0.0001f);
+    ASSERT_NEAR(100.0f, state.avatarY[0], 0.0001f);
+    ASSERT_NEAR(BL_PI - 0.05f, state.avatarRotation[0], 0.0001f);
+    ASSERT_NEAR(80.0f, state.avatarX[3], 0.0001f);
+    ASSERT_NEAR(1.0f, state.avatarRotation[3], 0.0001f);
+    ASSERT_NEAR(30.0f, state.avatarX[5], 0.0001f);
+    ASSERT_NEAR(2.0f, state.ballPosition.x, 0.0001f);
+
+    // Past PI the rotation wraps around to stay in range
+    nlRenderStateInterpolate(&state, &from, &to, 0.75f);
+    ASSERT_NEAR(-BL_PI + 0.05f, state.avatarRotation[0], 0.0001f);
+}
+
+UTEST(NimbleBall, renderStateInterpolateSpectator)
+{
+    NlSpectatorState from;
+    NlSpectatorState to;
+    from.activeMask = 1u << 2;
+    to.activeMask = (1u << 2) | (1u << 4);
+
+    from.avatars[2].position.x = 0.0f;
+    from.avatars[2].position.y = 0.0f;
+    from.avatars[2].visualRotation = -3.0f;
+    to.avatars[2].position.x = 10.0f;
+    to.avatars[2].position.y = -10.0f;
+    to.avatars[2].visualRotation = 3.0f;
+    to.avatars[4].position.x = 40.0f;
+    to.avatars[4].position.y = 40.0f;
+    to.avatars[4].visualRotation = 0.0f;
+    from.ballPosition.x = 0.0f;
+    from.ballPosition.y = 0.0f;
+    to.ballPosition.x = 0.0f;
+    to.ballPosition.y = 4.0f;
+
+    NlRenderState state;
+    nlRenderStateInterpolateSpectator(&state, &from, &to, 0.5f);
+
+    ASSERT_EQ(to.activeMask, state.activeMask);
+    ASSERT_NEAR(5.0f, state.avatarX[2], 0.0001f);
+    ASSERT_NEAR(-5.0f, state.avatarY[2], 0.0001f);
+    ASSERT_NEAR(BL_PI, fabsf(state.avatarRotation[2]), 0.0001f);
+    ASSERT_NEAR(40.0f, state.avatarX[4], 0.0001f);
+    ASSERT_NEAR(2.0f, state.ballPosition.y, 0.0001f);
+}
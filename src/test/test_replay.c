@@ -0,0 +1,177 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay.h>
+#include <stdlib.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+#define REPLAY_TEST_REPLAY_COUNT (2)
+#define REPLAY_TEST_TICK_COUNT (1200)
+#define REPLAY_TEST_KEYFRAME_INTERVAL (120)
+#define REPLAY_TEST_KEYFRAME_COUNT (REPLAY_TEST_TICK_COUNT / REPLAY_TEST_KEYFRAME_INTERVAL)
+#define REPLAY_TEST_WORKER_COUNT (4)
+
+static NlReplayTick g_replayTicks[REPLAY_TEST_REPLAY_COUNT][REPLAY_TEST_TICK_COUNT];
+static NlReplayKeyframe g_replayKeyframes[REPLAY_TEST_REPLAY_COUNT][REPLAY_TEST_KEYFRAME_COUNT];
+
+/// Returns true if all the ticks fit in the recorder
+static bool recordReplayWithRuleset(size_t replayIndex, const NlRuleset* ruleset, uint16_t tickDurationMs,
+                                    NlReplay* replay)
+{
+    NlReplayRecorder recorder;
+    nlReplayRecorderInit(&recorder, g_replayTicks[replayIndex], REPLAY_TEST_TICK_COUNT,
+                         g_replayKeyframes[replayIndex], REPLAY_TEST_KEYFRAME_COUNT, REPLAY_TEST_KEYFRAME_INTERVAL);
+
+    NlGame game;
+    nlGameInitWithRuleset(&game, ruleset, tickDurationMs);
+    uint32_t seed = (uint32_t) (replayIndex + 1);
+    for (size_t tick = 0; tick < REPLAY_TEST_TICK_COUNT; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        for (uint8_t participant = 0; participant < 2; ++participant) {
+            uint8_t participantId = (uint8_t) (participant + 1);
+            if (tick == 0) {
+                setSelectTeamInput(&inputs[participant], participantId, participant);
+                continue;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            setInGameInput(&inputs[participant], participantId, (int8_t) (seed >> 24), (int8_t) (seed >> 16),
+                           (uint8_t) ((tick % 40) < 12 ? 0x01 : 0));
+        }
+        if (!nlReplayRecorderTick(&recorder, &game, inputs, 2)) {
+            return false;
+        }
+    }
+
+    nlReplayRecorderReplay(&recorder, replay);
+
+    // The recorder is full
+    return !nlReplayRecorderTick(&recorder, &game, 0, 0);
+}
+
+static bool recordReplay(size_t replayIndex, NlReplay* replay)
+{
+    return recordReplayWithRuleset(replayIndex, &g_nlDefaultRuleset, NL_DEFAULT_TICK_DURATION_MS, replay);
+}
+
+#if !defined _WIN32
+static void* verifySegments(void* _verifier)
+{
+    NlReplayVerifier* verifier = (NlReplayVerifier*) _verifier;
+    while (nlReplayVerifierVerifyNext(verifier)) {
+    }
+
+    return 0;
+}
+#endif
+
+static void verifyReplays(NlReplayVerifier* verifier, const NlReplay* replays, NlReplaySegment* segments)
+{
+    nlReplayVerifierInit(verifier, replays, REPLAY_TEST_REPLAY_COUNT, segments,
+                         REPLAY_TEST_REPLAY_COUNT * REPLAY_TEST_KEYFRAME_COUNT);
+
+#if !defined _WIN32
+    pthread_t workers[REPLAY_TEST_WORKER_COUNT];
+    for (size_t i = 0; i < REPLAY_TEST_WORKER_COUNT; ++i) {
+        pthread_create(&workers[i], 0, verifySegments, verifier);
+    }
+    for (size_t i = 0; i < REPLAY_TEST_WORKER_COUNT; ++i) {
+        pthread_join(workers[i], 0);
+    }
+#else
+    while (nlReplayVerifierVerifyNext(verifier)) {
+    }
+#endif
+}
+
+UTEST(NimbleBall, replayVerifiesSegmentsInParallel)
+{
+    NlReplay replays[REPLAY_TEST_REPLAY_COUNT];
+    for (size_t i = 0; i < REPLAY_TEST_REPLAY_COUNT; ++i) {
+        ASSERT_TRUE(recordReplay(i, &replays[i]));
+        ASSERT_EQ((size_t) REPLAY_TEST_KEYFRAME_COUNT, replays[i].keyframeCount);
+    }
+
+    // Round trip through the file format
+    size_t octetCount = nlReplayOctetCount(&replays[1]);
+    uint8_t* octets = (uint8_t*) malloc(octetCount);
+    ASSERT_EQ((int) octetCount, nlReplayWrite(&replays[1], octets, octetCount));
+    ASSERT_TRUE(nlReplayWrite(&replays[1], octets, octetCount - 1) < 0);
+    ASSERT_EQ(0, nlReplayRead(&replays[1], octets, octetCount));
+    ASSERT_TRUE(nlReplayRead(&replays[0], octets, octetCount - 1) < 0);
+    ASSERT_EQ((size_t) REPLAY_TEST_TICK_COUNT, replays[1].tickCount);
+
+    // Ticks without a keyframe to start from can not be resimulated
+    NlReplay withoutKeyframes = replays[1];
+    withoutKeyframes.keyframeCount = 0;
+    size_t withoutKeyframesOctetCount = nlReplayOctetCount(&withoutKeyframes);
+    uint8_t* withoutKeyframesOctets = (uint8_t*) malloc(withoutKeyframesOctetCount);
+    ASSERT_EQ((int) withoutKeyframesOctetCount,
+              nlReplayWrite(&withoutKeyframes, withoutKeyframesOctets, withoutKeyframesOctetCount));
+    ASSERT_TRUE(nlReplayRead(&withoutKeyframes, withoutKeyframesOctets, withoutKeyframesOctetCount) < 0);
+    free(withoutKeyframesOctets);
+
+    NlReplayVerifier verifier;
+    NlReplaySegment segments[REPLAY_TEST_REPLAY_COUNT * REPLAY_TEST_KEYFRAME_COUNT];
+    replays[0].ticks = g_replayTicks[0];
+    replays[0].keyframes = g_replayKeyframes[0];
+    verifyReplays(&verifier, replays, segments);
+    ASSERT_EQ((size_t) REPLAY_TEST_REPLAY_COUNT * REPLAY_TEST_KEYFRAME_COUNT, verifier.segmentCount);
+    ASSERT_EQ((uint32_t) REPLAY_TEST_REPLAY_COUNT * REPLAY_TEST_TICK_COUNT, verifier.verifiedTickCount);
+    for (size_t i = 0; i < REPLAY_TEST_REPLAY_COUNT; ++i) {
+        ASSERT_EQ(NL_REPLAY_NO_MISMATCH, nlReplayVerifierFirstMismatch(&verifier, i));
+    }
+
+    // A recorded hash that does not match is reported at its tick, even if a later segment also mismatches
+    g_replayTicks[0][700].stateHash ^= 1;
+    g_replayKeyframes[0][8].game.ball.circle.center.x += 1.0f;
+    verifyReplays(&verifier, replays, segments);
+    ASSERT_EQ(700u, nlReplayVerifierFirstMismatch(&verifier, 0));
+    ASSERT_EQ(NL_REPLAY_NO_MISMATCH, nlReplayVerifierFirstMismatch(&verifier, 1));
+
+    g_replayTicks[0][700].stateHash ^= 1;
+    verifyReplays(&verifier, replays, segments);
+    ASSERT_EQ(8u * REPLAY_TEST_KEYFRAME_INTERVAL, nlReplayVerifierFirstMismatch(&verifier, 0));
+
+    free(octets);
+}
+
+UTEST(NimbleBall, replayStoresItsRules)
+{
+    NlRuleset ruleset = g_nlDefaultRuleset;
+    ruleset.goalSize = 110.0f;
+    NlReplay replay;
+    ASSERT_TRUE(recordReplayWithRuleset(0, &ruleset, 33, &replay));
+
+    // Another process has other rules ids, the keyframes must not be played with the id they were recorded with
+    for (size_t i = 0; i < REPLAY_TEST_KEYFRAME_COUNT; ++i) {
+        g_replayKeyframes[0][i].game.rules.id = NL_INVALID_RULES_ID;
+    }
+
+    size_t octetCount = nlReplayOctetCount(&replay);
+    uint8_t* octets = (uint8_t*) malloc(octetCount);
+    ASSERT_EQ((int) octetCount, nlReplayWrite(&replay, octets, octetCount));
+    NlReplay readReplay;
+    ASSERT_EQ(0, nlReplayRead(&readReplay, octets, octetCount));
+
+    const NlRules* rules = nlRulesResolve(readReplay.rules);
+    ASSERT_TRUE(rules != 0);
+    ASSERT_EQ(33, rules->tickRate.tickDurationMs);
+    ASSERT_EQ(110.0f, rules->ruleset.goalSize);
+
+    NlReplayVerifier verifier;
+    NlReplaySegment segments[REPLAY_TEST_KEYFRAME_COUNT];
+    nlReplayVerifierInit(&verifier, &readReplay, 1, segments, REPLAY_TEST_KEYFRAME_COUNT);
+    while (nlReplayVerifierVerifyNext(&verifier)) {
+    }
+    ASSERT_EQ(NL_REPLAY_NO_MISMATCH, nlReplayVerifierFirstMismatch(&verifier, 0));
+    ASSERT_EQ((uint32_t) REPLAY_TEST_TICK_COUNT, verifier.verifiedTickCount);
+
+    free(octets);
+}
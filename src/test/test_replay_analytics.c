@@ -0,0 +1,197 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay_analytics.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+#define ANALYTICS_TEST_REPLAY_COUNT (8)
+#define ANALYTICS_TEST_TICK_COUNT (900)
+#define ANALYTICS_TEST_KEYFRAME_INTERVAL (300)
+#define ANALYTICS_TEST_KEYFRAME_COUNT (ANALYTICS_TEST_TICK_COUNT / ANALYTICS_TEST_KEYFRAME_INTERVAL)
+#define ANALYTICS_TEST_WORKER_COUNT (3)
+#define ANALYTICS_TEST_MISSING_REPLAY (5)
+
+static NlReplayTick g_analyticsTicks[ANALYTICS_TEST_REPLAY_COUNT][ANALYTICS_TEST_TICK_COUNT];
+static NlReplayKeyframe g_analyticsKeyframes[ANALYTICS_TEST_REPLAY_COUNT][ANALYTICS_TEST_KEYFRAME_COUNT];
+static NlReplay g_analyticsReplays[ANALYTICS_TEST_REPLAY_COUNT];
+
+typedef struct AnalyticsTestAggregate {
+    size_t matchCount;
+    size_t tickCount;
+    size_t kickCount;
+    size_t kickPowerSum;
+    size_t slideTackleCount;
+    size_t goalCount;
+    uint32_t goalTickSum;
+    size_t statsKickCount;
+} AnalyticsTestAggregate;
+
+static void recordAnalyticsReplay(size_t replayIndex)
+{
+    NlReplayRecorder recorder;
+    nlReplayRecorderInit(&recorder, g_analyticsTicks[replayIndex], ANALYTICS_TEST_TICK_COUNT,
+                         g_analyticsKeyframes[replayIndex], ANALYTICS_TEST_KEYFRAME_COUNT,
+                         ANALYTICS_TEST_KEYFRAME_INTERVAL);
+
+    NlGame game;
+    nlGameInit(&game);
+    uint32_t seed = (uint32_t) (replayIndex * 31 + 5);
+    for (size_t tick = 0; tick < ANALYTICS_TEST_TICK_COUNT; ++tick) {
+        NlPlayerInputWithParticipantInfo inputs[2];
+        for (uint8_t participant = 0; participant < 2; ++participant) {
+            uint8_t participantId = (uint8_t) (participant + 1);
+            if (tick == 0) {
+                setSelectTeamInput(&inputs[participant], participantId, participant);
+                continue;
+            }
+            seed = seed * 1664525u + 1013904223u;
+            uint8_t buttons = (uint8_t) ((tick % 35) < 10 ? 0x01 : 0) | (uint8_t) (tick % 90 == 45 ? 0x02 : 0);
+            setInGameInput(&inputs[participant], participantId, (int8_t) (seed >> 24), (int8_t) (seed >> 16), buttons);
+        }
+        nlReplayRecorderTick(&recorder, &game, inputs, 2);
+    }
+
+    nlReplayRecorderReplay(&recorder, &g_analyticsReplays[replayIndex]);
+}
+
+static bool loadReplay(void* userData, size_t replayIndex, NlReplay* target)
+{
+    (void) userData;
+    if (replayIndex == ANALYTICS_TEST_MISSING_REPLAY) {
+        return false;
+    }
+
+    *target = g_analyticsReplays[replayIndex];
+    return true;
+}
+
+static void countTick(void* userData, void* workerAggregate, size_t replayIndex, uint32_t tickIndex,
+                      const NlGame* game, const NlGameEvents* events)
+{
+    (void) userData;
+    (void) replayIndex;
+    (void) game;
+
+    AnalyticsTestAggregate* aggregate = (AnalyticsTestAggregate*) workerAggregate;
+    aggregate->tickCount++;
+    for (size_t i = 0; i < events->count; ++i) {
+        const NlGameEvent* event = &events->events[i];
+        switch (event->eventType) {
+            case NlGameEventTypeKick:
+                aggregate->kickCount++;
+                aggregate->kickPowerSum += event->data.kick.kickPower;
+                break;
+            case NlGameEventTypeSlideTackle:
+                aggregate->slideTackleCount++;
+                break;
+            case NlGameEventTypeGoal:
+                aggregate->goalCount++;
+                aggregate->goalTickSum += tickIndex;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void countMatch(void* userData, void* workerAggregate, size_t replayIndex, const NlGame* game,
+                       const NlMatchStats* stats)
+{
+    (void) userData;
+    (void) replayIndex;
+    (void) game;
+
+    AnalyticsTestAggregate* aggregate = (AnalyticsTestAggregate*) workerAggregate;
+    aggregate->matchCount++;
+    aggregate->statsKickCount += (size_t) stats->teams[0].kickCount + stats->teams[1].kickCount;
+}
+
+static void* processReplays(void* _worker)
+{
+    NlReplayAnalyticsWorker* worker = (NlReplayAnalyticsWorker*) _worker;
+    while (nlReplayAnalyticsWorkerProcessNext(worker)) {
+    }
+
+    return 0;
+}
+
+UTEST(NimbleBall, replayAnalyticsAggregatesAcrossWorkers)
+{
+    for (size_t i = 0; i < ANALYTICS_TEST_REPLAY_COUNT; ++i) {
+        recordAnalyticsReplay(i);
+    }
+
+    NlReplayAnalyticsCallbacks callbacks;
+    callbacks.load = loadReplay;
+    callbacks.release = 0;
+    callbacks.tick = countTick;
+    callbacks.match = countMatch;
+    callbacks.userData = 0;
+
+    // Reference run on a single worker
+    NlReplayAnalytics analytics;
+    nlReplayAnalyticsInit(&analytics, ANALYTICS_TEST_REPLAY_COUNT, callbacks);
+    AnalyticsTestAggregate serial = {0};
+    static NlReplayAnalyticsWorker serialWorker;
+    nlReplayAnalyticsWorkerInit(&serialWorker, &analytics, &serial);
+    while (nlReplayAnalyticsWorkerProcessNext(&serialWorker)) {
+    }
+    ASSERT_EQ(1u, analytics.skippedCount);
+    ASSERT_EQ((size_t) ANALYTICS_TEST_REPLAY_COUNT - 1, serial.matchCount);
+    ASSERT_EQ((size_t) (ANALYTICS_TEST_REPLAY_COUNT - 1) * ANALYTICS_TEST_TICK_COUNT, serial.tickCount);
+    ASSERT_TRUE(serial.kickCount > 0);
+    ASSERT_EQ(serial.kickCount, serial.statsKickCount);
+
+    nlReplayAnalyticsInit(&analytics, ANALYTICS_TEST_REPLAY_COUNT, callbacks);
+    AnalyticsTestAggregate aggregates[ANALYTICS_TEST_WORKER_COUNT];
+    static NlReplayAnalyticsWorker workers[ANALYTICS_TEST_WORKER_COUNT];
+    for (size_t i = 0; i < ANALYTICS_TEST_WORKER_COUNT; ++i) {
+        aggregates[i] = (AnalyticsTestAggregate){0};
+        nlReplayAnalyticsWorkerInit(&workers[i], &analytics, &aggregates[i]);
+    }
+
+#if !defined _WIN32
+    pthread_t threads[ANALYTICS_TEST_WORKER_COUNT];
+    for (size_t i = 0; i < ANALYTICS_TEST_WORKER_COUNT; ++i) {
+        pthread_create(&threads[i], 0, processReplays, &workers[i]);
+    }
+    for (size_t i = 0; i < ANALYTICS_TEST_WORKER_COUNT; ++i) {
+        pthread_join(threads[i], 0);
+    }
+#else
+    for (size_t i = 0; i < ANALYTICS_TEST_WORKER_COUNT; ++i) {
+        processReplays(&workers[i]);
+    }
+#endif
+
+    // Reduce
+    AnalyticsTestAggregate merged = {0};
+    uint64_t simulatedTickCount = 0;
+    for (size_t i = 0; i < ANALYTICS_TEST_WORKER_COUNT; ++i) {
+        merged.matchCount += aggregates[i].matchCount;
+        merged.tickCount += aggregates[i].tickCount;
+        merged.kickCount += aggregates[i].kickCount;
+        merged.kickPowerSum += aggregates[i].kickPowerSum;
+        merged.slideTackleCount += aggregates[i].slideTackleCount;
+        merged.goalCount += aggregates[i].goalCount;
+        merged.goalTickSum += aggregates[i].goalTickSum;
+        merged.statsKickCount += aggregates[i].statsKickCount;
+        simulatedTickCount += workers[i].simulatedTickCount;
+    }
+
+    ASSERT_EQ(serial.matchCount, merged.matchCount);
+    ASSERT_EQ(serial.tickCount, merged.tickCount);
+    ASSERT_EQ(serial.kickCount, merged.kickCount);
+    ASSERT_EQ(serial.kickPowerSum, merged.kickPowerSum);
+    ASSERT_EQ(serial.slideTackleCount, merged.slideTackleCount);
+    ASSERT_EQ(serial.goalCount, merged.goalCount);
+    ASSERT_EQ(serial.goalTickSum, merged.goalTickSum);
+    ASSERT_EQ((uint64_t) serial.tickCount, simulatedTickCount);
+}
@@ -0,0 +1,201 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_pipeline.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+static void tickTwoPlayers(NlGame* game, size_t tickCount)
+{
+    joinTwoPlayers(game);
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    setInGameInput(&inputs[0], 1, 20, -10, 0);
+    setInGameInput(&inputs[1], 2, 20, -10, 0);
+    for (size_t i = 0; i < tickCount; ++i) {
+        nlGameTick(game, inputs, 2, 0);
+    }
+}
+
+UTEST(NimbleBall, snapshotDelta)
+{
+    NlGame baseline;
+    nlGameInit(&baseline);
+    tickTwoPlayers(&baseline, 200);
+
+    NlGame game = baseline;
+    tickTwoPlayers(&game, 3);
+
+    uint8_t octets[NL_SNAPSHOT_MAX_OCTET_COUNT];
+    int fullOctetCount = nlSnapshotEncode(&game, 0, octets, sizeof(octets));
+    ASSERT_EQ((int) NL_SNAPSHOT_MAX_OCTET_COUNT, fullOctetCount);
+
+    int deltaOctetCount = nlSnapshotEncode(&game, &baseline, octets, sizeof(octets));
+    ASSERT_TRUE(deltaOctetCount > 0);
+    ASSERT_TRUE(deltaOctetCount < fullOctetCount);
+    ASSERT_EQ(NlSnapshotTypeDelta, octets[0]);
+
+    NlGame decoded;
+    ASSERT_EQ(0, nlSnapshotDecode(octets, (size_t) deltaOctetCount, &baseline, &decoded));
+    ASSERT_EQ(0, memcmp(&game, &decoded, sizeof(NlGame)));
+
+    ASSERT_TRUE(nlSnapshotDecode(octets, (size_t) deltaOctetCount, 0, &decoded) < 0);
+}
+
+UTEST(NimbleBall, snapshotPipelineBackpressure)
+{
+    static NlSnapshotPipeline pipeline;
+    nlSnapshotPipelineInit(&pipeline);
+
+    NlGame game;
+    nlGameInit(&game);
+
+    for (uint32_t tickId = 0; tickId < NL_SNAPSHOT_PIPELINE_CAPACITY + 4; ++tickId) {
+        game.tickCount = (uint16_t) tickId;
+        bool wasSubmitted = nlSnapshotPipelineSubmit(&pipeline, &game, tickId);
+        ASSERT_EQ(tickId < NL_SNAPSHOT_PIPELINE_CAPACITY, wasSubmitted);
+    }
+    ASSERT_EQ(4u, pipeline.droppedCount);
+
+    ASSERT_TRUE(nlSnapshotPipelinePeekEncoded(&pipeline) == 0);
+
+    size_t encodedCount = 0;
+    while (nlSnapshotPipelineEncodeNext(&pipeline)) {
+        encodedCount++;
+    }
+    ASSERT_EQ((size_t) NL_SNAPSHOT_PIPELINE_CAPACITY, encodedCount);
+
+    for (uint32_t tickId = 0; tickId < NL_SNAPSHOT_PIPELINE_CAPACITY; ++tickId) {
+        const NlSnapshotPipelineSlot* slot = nlSnapshotPipelinePeekEncoded(&pipeline);
+        ASSERT_TRUE(slot != 0);
+        ASSERT_EQ(tickId, slot->tickId);
+        NlGame decoded;
+        ASSERT_EQ(0, nlSnapshotDecode(slot->octets, (size_t) slot->octetCount, 0, &decoded));
+        ASSERT_EQ(tickId, decoded.tickCount);
+        nlSnapshotPipelineRelease(&pipeline);
+    }
+    ASSERT_TRUE(nlSnapshotPipelinePeekEncoded(&pipeline) == 0);
+
+    ASSERT_TRUE(nlSnapshotPipelineSubmit(&pipeline, &game, 100));
+
+    // The state can also be written straight into the ring
+    NlGame* target = nlSnapshotPipelineAcquire(&pipeline);
+    ASSERT_TRUE(target != 0);
+    nlGameInit(target);
+    target->tickCount = 101;
+    nlSnapshotPipelineCommit(&pipeline, 101);
+    while (nlSnapshotPipelineEncodeNext(&pipeline)) {
+    }
+    nlSnapshotPipelineRelease(&pipeline);
+    const NlSnapshotPipelineSlot* slot = nlSnapshotPipelinePeekEncoded(&pipeline);
+    ASSERT_TRUE(slot != 0);
+    ASSERT_EQ(101u, slot->tickId);
+    NlGame decoded;
+    ASSERT_EQ(0, nlSnapshotDecode(slot->octets, (size_t) slot->octetCount, 0, &decoded));
+    ASSERT_EQ(101, decoded.tickCount);
+}
+
+#if !defined _WIN32
+
+#define SNAPSHOT_STRESS_TICK_COUNT (20000)
+#define SNAPSHOT_STRESS_WORKER_COUNT (3)
+
+typedef struct SnapshotStressContext {
+    NlSnapshotPipeline* pipeline;
+    volatile int isDone;
+    size_t consumedCount;
+    bool isInOrder;
+    bool isDecodedCorrectly;
+} SnapshotStressContext;
+
+static void* encodeSnapshots(void* _context)
+{
+    SnapshotStressContext* context = (SnapshotStressContext*) _context;
+
+    while (!__atomic_load_n(&context->isDone, __ATOMIC_ACQUIRE)) {
+        nlSnapshotPipelineEncodeNext(context->pipeline);
+    }
+
+    return 0;
+}
+
+static void* consumeSnapshots(void* _context)
+{
+    SnapshotStressContext* context = (SnapshotStressContext*) _context;
+    uint32_t lastTickId = 0;
+
+    while (!__atomic_load_n(&context->isDone, __ATOMIC_ACQUIRE)) {
+        const NlSnapshotPipelineSlot* slot = nlSnapshotPipelinePeekEncoded(context->pipeline);
+        if (slot == 0) {
+            continue;
+        }
+        NlGame decoded;
+        if (nlSnapshotDecode(slot->octets, (size_t) slot->octetCount, 0, &decoded) != 0 ||
+            decoded.tickCount != (uint16_t) slot->tickId) {
+            context->isDecodedCorrectly = false;
+        }
+        if (context->consumedCount > 0 && slot->tickId <= lastTickId) {
+            context->isInOrder = false;
+        }
+        lastTickId = slot->tickId;
+        context->consumedCount++;
+        nlSnapshotPipelineRelease(context->pipeline);
+    }
+
+    return 0;
+}
+
+UTEST(NimbleBall, snapshotPipelineStress)
+{
+    static NlSnapshotPipeline pipeline;
+    nlSnapshotPipelineInit(&pipeline);
+
+    SnapshotStressContext context;
+    context.pipeline = &pipeline;
+    context.isDone = 0;
+    context.consumedCount = 0;
+    context.isInOrder = true;
+    context.isDecodedCorrectly = true;
+
+    pthread_t workers[SNAPSHOT_STRESS_WORKER_COUNT];
+    for (size_t i = 0; i < SNAPSHOT_STRESS_WORKER_COUNT; ++i) {
+        pthread_create(&workers[i], 0, encodeSnapshots, &context);
+    }
+    pthread_t consumer;
+    pthread_create(&consumer, 0, consumeSnapshots, &context);
+
+    NlGame game;
+    nlGameInit(&game);
+    size_t submittedCount = 0;
+    for (uint32_t tickId = 1; tickId <= SNAPSHOT_STRESS_TICK_COUNT; ++tickId) {
+        game.tickCount = (uint16_t) tickId;
+        if (nlSnapshotPipelineSubmit(&pipeline, &game, tickId)) {
+            submittedCount++;
+        }
+    }
+
+    // Let the pipeline drain before stopping the threads
+    while (nlSnapshotPipelinePeekEncoded(&pipeline) != 0 ||
+           __atomic_load_n(&pipeline.releaseIndex, __ATOMIC_ACQUIRE) != pipeline.submitIndex) {
+    }
+
+    __atomic_store_n(&context.isDone, 1, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < SNAPSHOT_STRESS_WORKER_COUNT; ++i) {
+        pthread_join(workers[i], 0);
+    }
+    pthread_join(consumer, 0);
+
+    ASSERT_TRUE(context.isInOrder);
+    ASSERT_TRUE(context.isDecodedCorrectly);
+    ASSERT_EQ(submittedCount, context.consumedCount);
+    ASSERT_EQ((uint32_t) SNAPSHOT_STRESS_TICK_COUNT, pipeline.submittedCount);
+    ASSERT_EQ(SNAPSHOT_STRESS_TICK_COUNT - submittedCount, (size_t) pipeline.droppedCount);
+}
+
+#endif
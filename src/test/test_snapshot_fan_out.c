@@ -0,0 +1,109 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_fan_out.h>
+
+UTEST(NimbleBall, snapshotFanOutShares)
+{
+    static NlSnapshotFanOut fanOut;
+    nlSnapshotFanOutInit(&fanOut);
+
+    NlGame baseline;
+    nlGameInit(&baseline);
+    NlGame game = baseline;
+    game.tickCount = 10;
+
+    const NlSharedSnapshot* first = nlSnapshotFanOutAcquire(&fanOut, &game, 10, &baseline, 9, 0);
+    const NlSharedSnapshot* second = nlSnapshotFanOutAcquire(&fanOut, &game, 10, &baseline, 9, 0);
+    const NlSharedSnapshot* full = nlSnapshotFanOutAcquire(&fanOut, &game, 10, 0, 9, 0);
+    const NlSharedSnapshot* otherTier = nlSnapshotFanOutAcquire(&fanOut, &game, 10, &baseline, 9, 1);
+
+    ASSERT_TRUE(first != 0);
+    ASSERT_TRUE(first == second);
+    ASSERT_TRUE(full != first);
+    ASSERT_EQ(NL_SNAPSHOT_NO_BASELINE, full->baselineTickId);
+    ASSERT_TRUE(otherTier != first);
+    ASSERT_EQ(3u, fanOut.stats.encodeCount);
+    ASSERT_EQ(3u, first->refCount);
+
+    NlGame decoded;
+    ASSERT_EQ(0, nlSnapshotDecode(first->octets, (size_t) first->octetCount, &baseline, &decoded));
+    ASSERT_EQ(10, decoded.tickCount);
+
+    nlSharedSnapshotRelease(first);
+    nlSharedSnapshotRelease(second);
+    nlSharedSnapshotRelease(full);
+    nlSharedSnapshotRelease(otherTier);
+
+    // A new tick drops the references the fan out held for the previous one
+    const NlSharedSnapshot* next = nlSnapshotFanOutAcquire(&fanOut, &game, 11, 0, 0, 0);
+    ASSERT_TRUE(next != 0);
+    ASSERT_EQ(0u, first->refCount);
+    nlSharedSnapshotRelease(next);
+}
+
+UTEST(NimbleBall, snapshotFanOutExhausted)
+{
+    static NlSnapshotFanOut fanOut;
+    nlSnapshotFanOutInit(&fanOut);
+
+    NlGame game;
+    nlGameInit(&game);
+
+    // Subscribers that never release keep every snapshot alive
+    size_t acquiredCount = 0;
+    for (uint32_t tickId = 0; tickId < NL_SNAPSHOT_FAN_OUT_CAPACITY + 2; ++tickId) {
+        if (nlSnapshotFanOutAcquire(&fanOut, &game, tickId, 0, 0, 0) != 0) {
+            acquiredCount++;
+        }
+    }
+
+    ASSERT_EQ((size_t) NL_SNAPSHOT_FAN_OUT_CAPACITY, acquiredCount);
+    ASSERT_EQ(2u, fanOut.stats.exhaustedCount);
+}
+
+#define FAN_OUT_SCALING_TICK_COUNT (60)
+#define FAN_OUT_SCALING_BASELINE_COUNT (4)
+#define FAN_OUT_SCALING_TIER_COUNT (2)
+#define FAN_OUT_SCALING_MAX_SPECTATORS (1000)
+
+// The encode count only depends on the distinct (baseline, tier) variants, not on the spectator count.
+// Timings against encoding per connection are in the fan out benchmark.
+UTEST(NimbleBall, snapshotFanOutEncodesOncePerVariant)
+{
+    static NlSnapshotFanOut fanOut;
+    static const NlSharedSnapshot* sent[FAN_OUT_SCALING_MAX_SPECTATORS];
+    const size_t spectatorCounts[] = {1, 100, FAN_OUT_SCALING_MAX_SPECTATORS};
+
+    NlGame history[FAN_OUT_SCALING_BASELINE_COUNT + 1];
+    nlGameInit(&history[0]);
+    for (size_t i = 1; i <= FAN_OUT_SCALING_BASELINE_COUNT; ++i) {
+        history[i] = history[i - 1];
+        nlGameTick(&history[i], 0, 0, 0);
+    }
+
+    for (size_t countIndex = 0; countIndex < sizeof(spectatorCounts) / sizeof(spectatorCounts[0]); ++countIndex) {
+        size_t spectatorCount = spectatorCounts[countIndex];
+        size_t variantCount = FAN_OUT_SCALING_BASELINE_COUNT * FAN_OUT_SCALING_TIER_COUNT;
+        size_t expectedVariants = spectatorCount < variantCount ? spectatorCount : variantCount;
+        nlSnapshotFanOutInit(&fanOut);
+
+        for (uint32_t tickId = 0; tickId < FAN_OUT_SCALING_TICK_COUNT; ++tickId) {
+            for (size_t i = 0; i < spectatorCount; ++i) {
+                size_t baselineIndex = i % FAN_OUT_SCALING_BASELINE_COUNT;
+                uint8_t tier = (uint8_t) ((i / FAN_OUT_SCALING_BASELINE_COUNT) % FAN_OUT_SCALING_TIER_COUNT);
+                sent[i] = nlSnapshotFanOutAcquire(&fanOut, &history[FAN_OUT_SCALING_BASELINE_COUNT], tickId,
+                                                  &history[baselineIndex], (uint32_t) baselineIndex, tier);
+                ASSERT_TRUE(sent[i] != 0);
+            }
+            for (size_t i = 0; i < spectatorCount; ++i) {
+                nlSharedSnapshotRelease(sent[i]);
+            }
+        }
+
+        ASSERT_EQ(FAN_OUT_SCALING_TICK_COUNT * expectedVariants, fanOut.stats.encodeCount);
+    }
+}
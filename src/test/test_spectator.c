@@ -0,0 +1,92 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <basal/math.h>
+#include <clog/clog.h>
+#include <math.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_snapshot_fan_out.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_spectator.h>
+
+static void playTicks(NlGame* game, size_t tickCount)
+{
+    joinTwoPlayers(game);
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+    for (size_t i = 0; i < tickCount; ++i) {
+        int8_t direction = (int8_t) ((i % 60) < 30 ? 1 : -1);
+        setInGameInput(&inputs[0], 1, (int8_t) (direction * 60), (int8_t) (direction * 30), 0);
+        setInGameInput(&inputs[1], 2, (int8_t) (direction * -40), (int8_t) (direction * 30), 0);
+        nlGameTick(game, inputs, 2, 0);
+    }
+}
+
+UTEST(NimbleBall, spectatorLod)
+{
+    NlGame game;
+    nlGameInit(&game);
+    playTicks(&game, 400);
+    ASSERT_EQ(NlGamePhasePlaying, game.phase);
+
+    NlSpectatorLod lod;
+    nlSpectatorLodInit(&lod, 0.25f, 128, 3);
+
+    ASSERT_TRUE(nlSpectatorLodShouldEmit(&lod, 0));
+    ASSERT_FALSE(nlSpectatorLodShouldEmit(&lod, 1));
+    ASSERT_TRUE(nlSpectatorLodShouldEmit(&lod, 3));
+
+    NlSpectatorState state;
+    nlSpectatorStateFromGame(&state, &game);
+    ASSERT_EQ(game.avatars.activeMask, state.activeMask);
+
+    uint8_t octets[NL_SPECTATOR_MAX_OCTET_COUNT];
+    int octetCount = nlSpectatorStateEncode(&lod, &state, octets, sizeof(octets));
+    ASSERT_TRUE(octetCount > 0);
+    ASSERT_TRUE((size_t) octetCount * 10 < sizeof(NlGame));
+
+    NlSpectatorState decoded;
+    ASSERT_EQ(0, nlSpectatorStateDecode(&lod, octets, (size_t) octetCount, &decoded));
+    ASSERT_EQ(state.activeMask, decoded.activeMask);
+    ASSERT_EQ(game.phase, decoded.phase);
+    ASSERT_EQ(game.matchClockLeftInTicks, decoded.matchClockLeftInTicks);
+    ASSERT_TRUE(fabsf(decoded.ballPosition.x - game.ball.circle.center.x) <= 0.125f);
+    ASSERT_TRUE(fabsf(decoded.ballPosition.y - game.ball.circle.center.y) <= 0.125f);
+
+    for (size_t i = 0; i < NL_MAX_PLAYERS; ++i) {
+        if ((state.activeMask & (1u << i)) == 0) {
+            continue;
+        }
+        const NlAvatar* avatar = &game.avatars.avatars[i];
+        ASSERT_TRUE(fabsf(decoded.avatars[i].position.x - avatar->circle.center.x) <= 0.125f);
+        ASSERT_TRUE(fabsf(decoded.avatars[i].position.y - avatar->circle.center.y) <= 0.125f);
+        float rotationDiff = blAngleMinimalDiff(decoded.avatars[i].visualRotation, avatar->visualRotation);
+        ASSERT_TRUE(fabsf(rotationDiff) <= BL_PI / 128.0f + 0.0001f);
+        ASSERT_EQ(avatar->teamIndex, decoded.avatars[i].teamIndex);
+    }
+}
+
+UTEST(NimbleBall, spectatorFanOut)
+{
+    static NlSnapshotFanOut fanOut;
+    nlSnapshotFanOutInit(&fanOut);
+
+    NlSpectatorLod lod;
+    nlSpectatorLodInit(&lod, 0.5f, 64, 1);
+    nlSnapshotFanOutSetEncoder(&fanOut, nlSpectatorFanOutEncode, &lod);
+
+    NlGame game;
+    nlGameInit(&game);
+    playTicks(&game, 100);
+
+    const NlSharedSnapshot* spectator =
+        nlSnapshotFanOutAcquire(&fanOut, &game, 1, 0, 0, NlSnapshotPrecisionTierSpectator);
+    const NlSharedSnapshot* full = nlSnapshotFanOutAcquire(&fanOut, &game, 1, 0, 0, NlSnapshotPrecisionTierFull);
+    ASSERT_EQ(NlSnapshotTypeSpectator, spectator->octets[0]);
+    ASSERT_EQ(NlSnapshotTypeFull, full->octets[0]);
+    ASSERT_TRUE(spectator->octetCount * 10 < full->octetCount);
+
+    nlSharedSnapshotRelease(spectator);
+    nlSharedSnapshotRelease(full);
+}
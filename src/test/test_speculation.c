@@ -0,0 +1,67 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_speculation.h>
+
+UTEST(NimbleBall, speculation)
+{
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBallSpeculation";
+
+    NlSimulationVm simulationVm;
+    nlSimulationVmInit(&simulationVm, subLog);
+    nlGameInit(&simulationVm.game);
+
+    joinTwoPlayers(&simulationVm.game);
+
+    NlPlayerInputWithParticipantInfo inputs[2];
+
+    setInGameInput(&inputs[0], 1, 20, 0, 0x01);
+    setInGameInput(&inputs[1], 2, -20, 0, 0);
+    for (size_t i = 0; i < 10; ++i) {
+        nlGameTick(&simulationVm.game, inputs, 2, 0);
+    }
+
+    NlSpeculation speculation;
+    nlSpeculationInit(&speculation);
+    nlSpeculationBegin(&speculation, &simulationVm, 1, &inputs[0].playerInput, inputs, 2, 4);
+    ASSERT_EQ(3u, speculation.branchCount);
+
+    for (size_t i = 0; i < speculation.branchCount; ++i) {
+        nlSpeculationSimulateBranch(&speculation, i);
+    }
+
+    // The participant released the kick button
+    NlPlayerInputWithParticipantInfo actualInputs[3 * 2];
+    NlGame expectedState = simulationVm.game;
+    for (size_t tickIndex = 0; tickIndex < 3; ++tickIndex) {
+        setInGameInput(&actualInputs[tickIndex * 2], 1, 20, 0, 0);
+        setInGameInput(&actualInputs[tickIndex * 2 + 1], 2, -20, 0, 0);
+        nlGameTick(&expectedState, &actualInputs[tickIndex * 2], 2, 0);
+    }
+
+    NlGame baseState = simulationVm.game;
+    ASSERT_FALSE(nlSpeculationAdopt(&speculation, &simulationVm, actualInputs, 2, 0));
+    ASSERT_EQ(0u, speculation.stats.adoptAttemptCount);
+
+    ASSERT_TRUE(nlSpeculationAdopt(&speculation, &simulationVm, actualInputs, 2, 3));
+    ASSERT_EQ(0, memcmp(&expectedState, &simulationVm.game, sizeof(NlGame)));
+    ASSERT_EQ(1u, speculation.stats.hitCount);
+    ASSERT_EQ(1u, speculation.stats.hypothesisHitCount[NlSpeculationHypothesisReleaseKick]);
+
+    // The vm has moved on, the branches no longer continue from its state
+    ASSERT_FALSE(nlSpeculationAdopt(&speculation, &simulationVm, actualInputs, 2, 3));
+    ASSERT_EQ(0, memcmp(&expectedState, &simulationVm.game, sizeof(NlGame)));
+
+    // Nobody guessed a changed direction
+    simulationVm.game = baseState;
+    setInGameInput(&actualInputs[0], 1, -60, 0, 0);
+    ASSERT_FALSE(nlSpeculationAdopt(&speculation, &simulationVm, actualInputs, 2, 1));
+    ASSERT_EQ(3u, speculation.stats.adoptAttemptCount);
+    ASSERT_EQ(1u, speculation.stats.hitCount);
+}
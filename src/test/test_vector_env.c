@@ -0,0 +1,145 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "utest.h"
+#include <clog/clog.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_vector_env.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#endif
+
+#define VECTOR_ENV_MATCH_COUNT (8)
+#define VECTOR_ENV_AGENT_COUNT (4)
+#define VECTOR_ENV_STEP_COUNT (300)
+#define VECTOR_ENV_MAX_OBSERVATION_SIZE                                                                               \
+    (NL_VECTOR_ENV_BALL_OBSERVATION_SIZE + VECTOR_ENV_AGENT_COUNT * NL_VECTOR_ENV_AVATAR_OBSERVATION_SIZE +            \
+     NL_VECTOR_ENV_GAME_OBSERVATION_SIZE)
+
+static void randomActions(int8_t* actions, size_t count, uint32_t* seed)
+{
+    for (size_t i = 0; i < count; ++i) {
+        *seed = *seed * 1664525u + 1013904223u;
+        actions[i] = (int8_t) (*seed >> 24);
+    }
+}
+
+UTEST(NimbleBall, vectorEnv)
+{
+    static NlGame games[VECTOR_ENV_MATCH_COUNT];
+    static float observations[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_MAX_OBSERVATION_SIZE];
+    static int8_t actions[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_AGENT_COUNT * NL_VECTOR_ENV_ACTION_SIZE];
+    float rewards[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_AGENT_COUNT];
+    uint8_t dones[VECTOR_ENV_MATCH_COUNT];
+
+    NlVectorEnv env;
+    nlVectorEnvInit(&env, games, VECTOR_ENV_MATCH_COUNT, VECTOR_ENV_AGENT_COUNT);
+    ASSERT_EQ((size_t) VECTOR_ENV_MAX_OBSERVATION_SIZE, env.observationSize);
+
+    nlVectorEnvReset(&env, observations);
+    for (size_t matchIndex = 0; matchIndex < VECTOR_ENV_MATCH_COUNT; ++matchIndex) {
+        ASSERT_EQ(NlGamePhasePlaying, games[matchIndex].phase);
+        ASSERT_EQ(VECTOR_ENV_AGENT_COUNT, games[matchIndex].avatars.avatarCount);
+        const float* observation = &observations[matchIndex * env.observationSize];
+        for (size_t agent = 0; agent < VECTOR_ENV_AGENT_COUNT; ++agent) {
+            const float* avatarObservation = &observation[NL_VECTOR_ENV_BALL_OBSERVATION_SIZE +
+                                                          agent * NL_VECTOR_ENV_AVATAR_OBSERVATION_SIZE];
+            ASSERT_EQ(1.0f, avatarObservation[0]);
+            ASSERT_EQ((float) (agent % 2), avatarObservation[7]);
+        }
+    }
+
+    // Stepping through the env must give the same result as ticking the match directly
+    NlGame reference = games[3];
+    uint32_t seed = 42;
+    for (size_t step = 0; step < VECTOR_ENV_STEP_COUNT; ++step) {
+        randomActions(actions, sizeof(actions), &seed);
+
+        NlPlayerInputWithParticipantInfo inputs[VECTOR_ENV_AGENT_COUNT];
+        for (size_t agent = 0; agent < VECTOR_ENV_AGENT_COUNT; ++agent) {
+            const int8_t* action = &actions[(3 * VECTOR_ENV_AGENT_COUNT + agent) * NL_VECTOR_ENV_ACTION_SIZE];
+            inputs[agent].participantId = (uint8_t) agent;
+            inputs[agent].playerInput.inputType = NlPlayerInputTypeInGame;
+            inputs[agent].playerInput.input.inGameInput.horizontalAxis = action[0];
+            inputs[agent].playerInput.input.inGameInput.verticalAxis = action[1];
+            inputs[agent].playerInput.input.inGameInput.buttons = (uint8_t) (action[2] & 0x03);
+        }
+        nlGameTick(&reference, inputs, VECTOR_ENV_AGENT_COUNT, 0);
+
+        nlVectorEnvStep(&env, actions, observations, rewards, dones);
+
+        if (dones[3]) {
+            reference = games[3];
+            continue;
+        }
+        ASSERT_EQ(0, memcmp(&reference, &games[3], sizeof(NlGame)));
+        ASSERT_EQ(reference.ball.circle.center.x * (1.0f / 640.0f), observations[3 * env.observationSize]);
+        ASSERT_EQ(0.0f, rewards[3 * VECTOR_ENV_AGENT_COUNT]);
+    }
+}
+
+#if !defined _WIN32
+
+typedef struct VectorEnvWorker {
+    NlVectorEnv* env;
+    size_t firstMatch;
+    size_t matchCount;
+    const int8_t* actions;
+    float* observations;
+    float* rewards;
+    uint8_t* dones;
+} VectorEnvWorker;
+
+static void* stepMatches(void* _worker)
+{
+    VectorEnvWorker* worker = (VectorEnvWorker*) _worker;
+    nlVectorEnvStepRange(worker->env, worker->firstMatch, worker->matchCount, worker->actions, worker->observations,
+                         worker->rewards, worker->dones);
+    return 0;
+}
+
+UTEST(NimbleBall, vectorEnvThreadedRanges)
+{
+    static NlGame games[VECTOR_ENV_MATCH_COUNT];
+    static NlGame singleThreadedGames[VECTOR_ENV_MATCH_COUNT];
+    static float observations[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_MAX_OBSERVATION_SIZE];
+    static float singleThreadedObservations[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_MAX_OBSERVATION_SIZE];
+    static int8_t actions[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_AGENT_COUNT * NL_VECTOR_ENV_ACTION_SIZE];
+    float rewards[VECTOR_ENV_MATCH_COUNT * VECTOR_ENV_AGENT_COUNT];
+    uint8_t dones[VECTOR_ENV_MATCH_COUNT];
+
+    NlVectorEnv env;
+    nlVectorEnvInit(&env, games, VECTOR_ENV_MATCH_COUNT, VECTOR_ENV_AGENT_COUNT);
+    nlVectorEnvReset(&env, observations);
+    NlVectorEnv singleThreadedEnv;
+    nlVectorEnvInit(&singleThreadedEnv, singleThreadedGames, VECTOR_ENV_MATCH_COUNT, VECTOR_ENV_AGENT_COUNT);
+    nlVectorEnvReset(&singleThreadedEnv, singleThreadedObservations);
+
+    const size_t threadCount = 4;
+    const size_t matchesPerThread = VECTOR_ENV_MATCH_COUNT / threadCount;
+    uint32_t seed = 7;
+
+    for (size_t step = 0; step < 100; ++step) {
+        randomActions(actions, sizeof(actions), &seed);
+
+        pthread_t threads[4];
+        VectorEnvWorker workers[4];
+        for (size_t i = 0; i < threadCount; ++i) {
+            VectorEnvWorker worker = {&env, i * matchesPerThread, matchesPerThread, actions, observations, rewards,
+                                      dones};
+            workers[i] = worker;
+            pthread_create(&threads[i], 0, stepMatches, &workers[i]);
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            pthread_join(threads[i], 0);
+        }
+
+        nlVectorEnvStep(&singleThreadedEnv, actions, singleThreadedObservations, 0, 0);
+    }
+
+    ASSERT_EQ(0, memcmp(games, singleThreadedGames, sizeof(games)));
+    ASSERT_EQ(0, memcmp(observations, singleThreadedObservations, sizeof(observations)));
+}
+
+#endif
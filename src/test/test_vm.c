@@ -2,6 +2,7 @@
  *  Copyright (c) Peter Bjorklund. All rights reserved.
  *  Licensed under the MIT License. See LICENSE in the project root for license information.
  *--------------------------------------------------------------------------------------------*/
+#include "test_match.h"
 #include "utest.h"
 #include <clog/clog.h>
 #include <nimble-ball-simulation/nimble_ball_simulation_vm.h>
@@ -37,11 +38,8 @@ UTEST(NimbleBall, testvm)
     TransmuteInput input;
 
     NlPlayerInput playerInputs[2];
-    playerInputs[0].inputType = NlPlayerInputTypeInGame;
-    playerInputs[0].input.inGameInput.horizontalAxis = 33;
-
-    playerInputs[1].inputType = NlPlayerInputTypeSelectTeam;
-    playerInputs[1].input.selectTeam.preferredTeamToJoin = 1;
+    setInGamePlayerInput(&playerInputs[0], 33, 0, 0);
+    setSelectTeamPlayerInput(&playerInputs[1], 1);
 
     TransmuteParticipantInput participantInputs[2];
     participantInputs[0].octetSize = sizeof(NlPlayerInput);
@@ -61,3 +59,197 @@ UTEST(NimbleBall, testvm)
 
     ASSERT_EQ(1, simulationVm.game.tickCount);
 }
+
+UTEST(NimbleBall, tickMany)
+{
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBallVm";
+
+    NlSimulationVm singleStepVm;
+    nlSimulationVmInit(&singleStepVm, subLog);
+    nlGameInit(&singleStepVm.game);
+
+    NlSimulationVm batchedVm;
+    nlSimulationVmInit(&batchedVm, subLog);
+    batchedVm.game = singleStepVm.game;
+
+    NlPlayerInput selectTeamInput;
+    setSelectTeamPlayerInput(&selectTeamInput, 0);
+
+    NlPlayerInput inGameInput;
+    setInGamePlayerInput(&inGameInput, 40, -20, 0x01);
+
+#define TICK_MANY_COUNT (300)
+    TransmuteParticipantInput participantInputs[TICK_MANY_COUNT];
+    TransmuteInput inputs[TICK_MANY_COUNT];
+
+    for (size_t i = 0; i < TICK_MANY_COUNT; ++i) {
+        participantInputs[i].participantId = 0;
+        participantInputs[i].inputType = (i % 7 == 3) ? TransmuteParticipantInputTypeNoInputInTime
+                                                      : TransmuteParticipantInputTypeNormal;
+        participantInputs[i].input = i == 0 ? &selectTeamInput : &inGameInput;
+        participantInputs[i].octetSize = sizeof(NlPlayerInput);
+        inputs[i].participantInputs = &participantInputs[i];
+        inputs[i].participantCount = 1;
+    }
+
+    for (size_t i = 0; i < TICK_MANY_COUNT; ++i) {
+        transmuteVmTick(&singleStepVm.transmuteVm, &inputs[i]);
+    }
+
+    nlSimulationVmTickMany(&batchedVm, inputs, TICK_MANY_COUNT, true);
+
+    ASSERT_EQ(singleStepVm.game.tickCount, batchedVm.game.tickCount);
+    ASSERT_EQ(singleStepVm.game.phase, batchedVm.game.phase);
+    ASSERT_EQ(1, batchedVm.game.avatars.avatarCount);
+    ASSERT_EQ(singleStepVm.game.avatars.avatars[0].circle.center.x, batchedVm.game.avatars.avatars[0].circle.center.x);
+    ASSERT_EQ(singleStepVm.game.avatars.avatars[0].circle.center.y, batchedVm.game.avatars.avatars[0].circle.center.y);
+    ASSERT_EQ(singleStepVm.game.ball.circle.center.x, batchedVm.game.ball.circle.center.x);
+    ASSERT_EQ(singleStepVm.game.ball.circle.center.y, batchedVm.game.ball.circle.center.y);
+}
+
+UTEST(NimbleBall, resimulationCache)
+{
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBallVm";
+
+    NlSimulationVm simulationVm;
+    nlSimulationVmInit(&simulationVm, subLog);
+    nlGameInit(&simulationVm.game);
+
+    static NlSimulationVmCacheEntry entries[32];
+    NlSimulationVmCache cache;
+    nlSimulationVmCacheInit(&cache, entries, 32);
+    nlSimulationVmSetCache(&simulationVm, &cache);
+
+    NlPlayerInput playerInputs[2];
+    setSelectTeamPlayerInput(&playerInputs[0], 1);
+    setInGamePlayerInput(&playerInputs[1], -30, 10, 0);
+
+    TransmuteParticipantInput participantInputs[8];
+    TransmuteInput inputs[8];
+    for (size_t i = 0; i < 8; ++i) {
+        participantInputs[i].participantId = 4;
+        participantInputs[i].inputType = TransmuteParticipantInputTypeNormal;
+        participantInputs[i].input = i == 0 ? &playerInputs[0] : &playerInputs[1];
+        participantInputs[i].octetSize = sizeof(NlPlayerInput);
+        inputs[i].participantInputs = &participantInputs[i];
+        inputs[i].participantCount = 1;
+    }
+
+    NlGame rollbackState = simulationVm.game;
+
+    // Live ticks never use the cache
+    nlSimulationVmTickMany(&simulationVm, inputs, 8, false);
+    ASSERT_EQ(0u, cache.stats.lookupCount);
+    ASSERT_EQ(0u, cache.stats.insertCount);
+    NlGame predictedState = simulationVm.game;
+
+    // The first resimulation fills the cache
+    simulationVm.game = rollbackState;
+    nlSimulationVmTickMany(&simulationVm, inputs, 8, true);
+    ASSERT_EQ(0u, cache.stats.hitCount);
+    ASSERT_EQ(8u, cache.stats.insertCount);
+    ASSERT_EQ(0, tc_memcmp(&predictedState, &simulationVm.game, sizeof(NlGame)));
+
+    // Roll back and resimulate with the same inputs, every tick should be a cache hit
+    simulationVm.game = rollbackState;
+    nlSimulationVmTickMany(&simulationVm, inputs, 8, true);
+    ASSERT_EQ(8u, cache.stats.hitCount);
+    ASSERT_EQ(16u, cache.stats.lookupCount);
+    ASSERT_EQ(0, tc_memcmp(&predictedState, &simulationVm.game, sizeof(NlGame)));
+
+    // A corrected input for the last tick must miss
+    simulationVm.game = rollbackState;
+    playerInputs[1].input.inGameInput.horizontalAxis = 30;
+    nlSimulationVmTickMany(&simulationVm, inputs, 8, true);
+    ASSERT_EQ(9u, cache.stats.hitCount);
+}
+
+UTEST(NimbleBall, resimulationCacheComparesKeys)
+{
+    static NlSimulationVmCacheEntry entries[4];
+    NlSimulationVmCache cache;
+    nlSimulationVmCacheInit(&cache, entries, 4);
+
+    NlGame state;
+    nlGameInit(&state);
+    NlGame result = state;
+    result.tickCount = 1;
+    NlPlayerInputWithParticipantInfo inputs[1];
+    tc_mem_clear_type_n(inputs, 1);
+    nlSimulationVmCacheInsert(&cache, 42, 7, &state, inputs, 1, &result);
+    ASSERT_TRUE(nlSimulationVmCacheFind(&cache, 42, 7, &state, inputs, 1) != 0);
+
+    // Same hashes, but another state is a hash collision and must not hit
+    NlGame otherState = state;
+    otherState.tickCount = 99;
+    ASSERT_TRUE(nlSimulationVmCacheFind(&cache, 42, 7, &otherState, inputs, 1) == 0);
+
+    // And so must other inputs
+    NlPlayerInputWithParticipantInfo otherInputs[1];
+    tc_mem_clear_type_n(otherInputs, 1);
+    otherInputs[0].participantId = 3;
+    ASSERT_TRUE(nlSimulationVmCacheFind(&cache, 42, 7, &state, otherInputs, 1) == 0);
+}
+
+UTEST(NimbleBall, noInputInTimePolicy)
+{
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBallVm";
+
+    NlSimulationVm simulationVm;
+    nlSimulationVmInit(&simulationVm, subLog);
+    nlGameInit(&simulationVm.game);
+    nlSimulationVmSetNoInputInTimePolicy(&simulationVm, NlInputPredictionPolicyDecayToNeutral);
+
+    NlPlayerInput playerInput;
+    setInGamePlayerInput(&playerInput, 80, 0, 0);
+
+    TransmuteParticipantInput participantInput;
+    participantInput.participantId = 3;
+    participantInput.inputType = TransmuteParticipantInputTypeNormal;
+    participantInput.input = &playerInput;
+    participantInput.octetSize = sizeof(NlPlayerInput);
+
+    TransmuteInput input;
+    input.participantInputs = &participantInput;
+    input.participantCount = 1;
+
+    transmuteVmTick(&simulationVm.transmuteVm, &input);
+
+    participantInput.inputType = TransmuteParticipantInputTypeNoInputInTime;
+    transmuteVmTick(&simulationVm.transmuteVm, &input);
+
+    const NlPlayer* player = nlGameFindSimulationPlayerFromParticipantId(&simulationVm.game, 3);
+    ASSERT_EQ(NlPlayerInputTypeInGame, player->playerInput.inputType);
+    ASSERT_EQ(60, player->playerInput.input.inGameInput.horizontalAxis);
+}
+
+UTEST(NimbleBall, vmTickPublishes)
+{
+    Clog subLog;
+    subLog.config = &g_clog;
+    subLog.constantPrefix = "NimbleBallVm";
+
+    NlSimulationVm simulationVm;
+    nlSimulationVmInit(&simulationVm, subLog);
+    nlGameInit(&simulationVm.game);
+
+    static NlPublishedState publishedState;
+    nlPublishedStateInit(&publishedState);
+    nlSimulationVmSetPublishedState(&simulationVm, &publishedState);
+
+    TransmuteInput input;
+    input.participantInputs = 0;
+    input.participantCount = 0;
+    transmuteVmTick(&simulationVm.transmuteVm, &input);
+    transmuteVmTick(&simulationVm.transmuteVm, &input);
+
+    NlGame readGame;
+    ASSERT_TRUE(nlPublishedStateRead(&publishedState, &readGame));
+    ASSERT_EQ(simulationVm.game.tickCount, readGame.tickCount);
+}
@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "read_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+uint8_t* readFile(const char* path, size_t* octetCount)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == 0) {
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return 0;
+    }
+
+    uint8_t* octets = (uint8_t*) malloc((size_t) size);
+    if (octets != 0 && fread(octets, 1, (size_t) size, file) != (size_t) size) {
+        free(octets);
+        octets = 0;
+    }
+    fclose(file);
+    *octetCount = (size_t) size;
+
+    return octets;
+}
@@ -0,0 +1,15 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef NIMBLE_BALL_TOOLS_READ_FILE_H
+#define NIMBLE_BALL_TOOLS_READ_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Reads the whole file into a buffer allocated with malloc, which is aligned for nlReplayRead.
+/// Returns NULL if the file could not be read or is empty.
+uint8_t* readFile(const char* path, size_t* octetCount);
+
+#endif
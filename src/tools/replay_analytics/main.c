@@ -0,0 +1,219 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include "../common/read_file.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay_analytics.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Balancing data from recorded matches: kick power distribution, slide tackles and goal times. Replay files are
+// read by the workers as they claim them, so only one replay per thread is in memory.
+// usage: nimble_ball_replay_analytics [-j threads] replay...
+// The CMake build compiles the simulation into the tool with NL_LOG_DISABLED for the highest throughput.
+
+clog_config g_clog;
+
+#define REPLAY_ANALYTICS_MAX_THREADS (256)
+#define REPLAY_ANALYTICS_KICK_POWER_BUCKETS (8)
+#define REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS (10)
+
+typedef struct ReplayAnalyticsAggregate {
+    size_t kickPowerBuckets[REPLAY_ANALYTICS_KICK_POWER_BUCKETS];
+    size_t slideTackleCount;
+    size_t goalMinuteBuckets[REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS];
+    size_t goalCount;
+    size_t shotCount;
+    size_t matchCount;
+} ReplayAnalyticsAggregate;
+
+typedef struct ReplayAnalyticsFiles {
+    char** paths;
+    uint8_t** octets; ///< one entry per replay, only set while a worker holds the replay
+} ReplayAnalyticsFiles;
+
+static bool loadReplay(void* userData, size_t replayIndex, NlReplay* target)
+{
+    ReplayAnalyticsFiles* files = (ReplayAnalyticsFiles*) userData;
+    size_t octetCount = 0;
+    uint8_t* octets = readFile(files->paths[replayIndex], &octetCount);
+    if (octets == 0 || nlReplayRead(target, octets, octetCount) < 0) {
+        fprintf(stderr, "%s: could not read replay\n", files->paths[replayIndex]);
+        free(octets);
+        return false;
+    }
+    files->octets[replayIndex] = octets;
+
+    return true;
+}
+
+static void releaseReplay(void* userData, size_t replayIndex, NlReplay* replay)
+{
+    (void) replay;
+    ReplayAnalyticsFiles* files = (ReplayAnalyticsFiles*) userData;
+    free(files->octets[replayIndex]);
+    files->octets[replayIndex] = 0;
+}
+
+static void onTick(void* userData, void* workerAggregate, size_t replayIndex, uint32_t tickIndex, const NlGame* game,
+                   const NlGameEvents* events)
+{
+    (void) userData;
+    (void) replayIndex;
+
+    ReplayAnalyticsAggregate* aggregate = (ReplayAnalyticsAggregate*) workerAggregate;
+    const NlTickRate* tickRate = &nlGameRules(game)->tickRate;
+    for (size_t i = 0; i < events->count; ++i) {
+        const NlGameEvent* event = &events->events[i];
+        switch (event->eventType) {
+            case NlGameEventTypeKick: {
+                size_t bucket = (size_t) event->data.kick.kickPower * REPLAY_ANALYTICS_KICK_POWER_BUCKETS /
+                                ((size_t) tickRate->maxKickPowerTicks + 1);
+                aggregate->kickPowerBuckets[bucket < REPLAY_ANALYTICS_KICK_POWER_BUCKETS
+                                                ? bucket
+                                                : REPLAY_ANALYTICS_KICK_POWER_BUCKETS - 1]++;
+            } break;
+            case NlGameEventTypeSlideTackle:
+                aggregate->slideTackleCount++;
+                break;
+            case NlGameEventTypeGoal: {
+                size_t minute = (size_t) tickIndex * tickRate->tickDurationMs / 60000u;
+                aggregate->goalMinuteBuckets[minute < REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS
+                                                 ? minute
+                                                 : REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS - 1]++;
+                aggregate->goalCount++;
+            } break;
+            default:
+                break;
+        }
+    }
+}
+
+static void onMatch(void* userData, void* workerAggregate, size_t replayIndex, const NlGame* game,
+                    const NlMatchStats* stats)
+{
+    (void) userData;
+    (void) replayIndex;
+    (void) game;
+
+    ReplayAnalyticsAggregate* aggregate = (ReplayAnalyticsAggregate*) workerAggregate;
+    aggregate->shotCount += (size_t) stats->teams[0].shotCount + stats->teams[1].shotCount;
+    aggregate->matchCount++;
+}
+
+static void* processReplays(void* _worker)
+{
+    NlReplayAnalyticsWorker* worker = (NlReplayAnalyticsWorker*) _worker;
+    while (nlReplayAnalyticsWorkerProcessNext(worker)) {
+    }
+
+    return 0;
+}
+
+static double secondsNow(clockid_t clockId)
+{
+    struct timespec now;
+    clock_gettime(clockId, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    size_t threadCount = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+    int firstPath = 1;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+        threadCount = (size_t) atoi(argv[2]);
+        firstPath = 3;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > REPLAY_ANALYTICS_MAX_THREADS) {
+        threadCount = REPLAY_ANALYTICS_MAX_THREADS;
+    }
+
+    if (argc <= firstPath) {
+        fprintf(stderr, "usage: %s [-j threads] replay...\n", argv[0]);
+        return 2;
+    }
+    size_t replayCount = (size_t) (argc - firstPath);
+
+    ReplayAnalyticsFiles files;
+    files.paths = &argv[firstPath];
+    files.octets = (uint8_t**) calloc(replayCount, sizeof(uint8_t*));
+
+    NlReplayAnalyticsCallbacks callbacks;
+    callbacks.load = loadReplay;
+    callbacks.release = releaseReplay;
+    callbacks.tick = onTick;
+    callbacks.match = onMatch;
+    callbacks.userData = &files;
+
+    NlReplayAnalytics analytics;
+    nlReplayAnalyticsInit(&analytics, replayCount, callbacks);
+
+    NlReplayAnalyticsWorker* workers = (NlReplayAnalyticsWorker*) calloc(threadCount, sizeof(NlReplayAnalyticsWorker));
+    ReplayAnalyticsAggregate* aggregates = (ReplayAnalyticsAggregate*) calloc(threadCount,
+                                                                              sizeof(ReplayAnalyticsAggregate));
+    for (size_t i = 0; i < threadCount; ++i) {
+        nlReplayAnalyticsWorkerInit(&workers[i], &analytics, &aggregates[i]);
+    }
+
+    double startTime = secondsNow(CLOCK_MONOTONIC);
+    double startProcessorTime = secondsNow(CLOCK_PROCESS_CPUTIME_ID);
+    pthread_t threads[REPLAY_ANALYTICS_MAX_THREADS];
+    for (size_t i = 0; i < threadCount; ++i) {
+        pthread_create(&threads[i], 0, processReplays, &workers[i]);
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i], 0);
+    }
+    double elapsedTime = secondsNow(CLOCK_MONOTONIC) - startTime;
+    double processorTime = secondsNow(CLOCK_PROCESS_CPUTIME_ID) - startProcessorTime;
+
+    ReplayAnalyticsAggregate total;
+    memset(&total, 0, sizeof(total));
+    uint64_t simulatedTickCount = 0;
+    for (size_t i = 0; i < threadCount; ++i) {
+        const ReplayAnalyticsAggregate* aggregate = &aggregates[i];
+        for (size_t bucket = 0; bucket < REPLAY_ANALYTICS_KICK_POWER_BUCKETS; ++bucket) {
+            total.kickPowerBuckets[bucket] += aggregate->kickPowerBuckets[bucket];
+        }
+        for (size_t bucket = 0; bucket < REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS; ++bucket) {
+            total.goalMinuteBuckets[bucket] += aggregate->goalMinuteBuckets[bucket];
+        }
+        total.slideTackleCount += aggregate->slideTackleCount;
+        total.goalCount += aggregate->goalCount;
+        total.shotCount += aggregate->shotCount;
+        total.matchCount += aggregate->matchCount;
+        simulatedTickCount += workers[i].simulatedTickCount;
+    }
+
+    printf("matches: %zu (%u skipped)\n", total.matchCount, analytics.skippedCount);
+    printf("kick power:");
+    for (size_t bucket = 0; bucket < REPLAY_ANALYTICS_KICK_POWER_BUCKETS; ++bucket) {
+        printf(" %zu", total.kickPowerBuckets[bucket]);
+    }
+    printf("\nshots: %zu, slide tackles: %zu, goals: %zu\ngoals per minute:", total.shotCount,
+           total.slideTackleCount, total.goalCount);
+    for (size_t bucket = 0; bucket < REPLAY_ANALYTICS_GOAL_MINUTE_BUCKETS; ++bucket) {
+        printf(" %zu", total.goalMinuteBuckets[bucket]);
+    }
+    printf("\nsimulated %llu ticks on %zu threads in %.3f s, %.0f ticks per second per core\n",
+           (unsigned long long) simulatedTickCount, threadCount, elapsedTime,
+           processorTime > 0.0 ? (double) simulatedTickCount / processorTime : 0.0);
+
+    free(aggregates);
+    free(workers);
+    free(files.octets);
+
+    return analytics.skippedCount == 0 ? 0 : 1;
+}
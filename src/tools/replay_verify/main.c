@@ -0,0 +1,120 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include "../common/read_file.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <nimble-ball-simulation/nimble_ball_simulation_replay.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Verifies replay files against their recorded state hashes, spreading the keyframe segments over a thread pool.
+// usage: nimble_ball_replay_verify [-j threads] replay...
+
+clog_config g_clog;
+
+#define REPLAY_VERIFY_MAX_THREADS (256)
+
+static void* verifySegments(void* _verifier)
+{
+    NlReplayVerifier* verifier = (NlReplayVerifier*) _verifier;
+    while (nlReplayVerifierVerifyNext(verifier)) {
+    }
+
+    return 0;
+}
+
+static double secondsNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+    g_clog.log = clog_console;
+
+    size_t threadCount = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+    int firstPath = 1;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+        threadCount = (size_t) atoi(argv[2]);
+        firstPath = 3;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > REPLAY_VERIFY_MAX_THREADS) {
+        threadCount = REPLAY_VERIFY_MAX_THREADS;
+    }
+
+    if (argc <= firstPath) {
+        fprintf(stderr, "usage: %s [-j threads] replay...\n", argv[0]);
+        return 2;
+    }
+    size_t replayCount = (size_t) (argc - firstPath);
+
+    uint8_t** files = (uint8_t**) calloc(replayCount, sizeof(uint8_t*));
+    NlReplay* replays = (NlReplay*) calloc(replayCount, sizeof(NlReplay));
+    int exitCode = 0;
+    for (size_t i = 0; i < replayCount; ++i) {
+        const char* path = argv[firstPath + (int) i];
+        size_t octetCount = 0;
+        files[i] = readFile(path, &octetCount);
+        if (files[i] == 0 || nlReplayRead(&replays[i], files[i], octetCount) < 0) {
+            // Skipped with an empty replay, so the indices still match the paths
+            fprintf(stderr, "%s: could not read replay\n", path);
+            free(files[i]);
+            files[i] = 0;
+            replays[i].tickCount = 0;
+            replays[i].keyframeCount = 0;
+            exitCode = 1;
+        }
+    }
+
+    size_t segmentCount = nlReplayVerifierSegmentCount(replays, replayCount);
+    NlReplaySegment* segments = (NlReplaySegment*) calloc(segmentCount + 1, sizeof(NlReplaySegment));
+    NlReplayVerifier verifier;
+    nlReplayVerifierInit(&verifier, replays, replayCount, segments, segmentCount);
+
+    double startTime = secondsNow();
+    pthread_t threads[REPLAY_VERIFY_MAX_THREADS];
+    for (size_t i = 0; i < threadCount; ++i) {
+        pthread_create(&threads[i], 0, verifySegments, &verifier);
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        pthread_join(threads[i], 0);
+    }
+    double elapsedTime = secondsNow() - startTime;
+
+    for (size_t i = 0; i < replayCount; ++i) {
+        if (files[i] == 0) {
+            continue;
+        }
+        uint32_t mismatchTick = nlReplayVerifierFirstMismatch(&verifier, i);
+        if (mismatchTick == NL_REPLAY_NO_MISMATCH) {
+            printf("%s: ok, %zu ticks\n", argv[firstPath + (int) i], replays[i].tickCount);
+        } else {
+            printf("%s: first mismatch at tick %u\n", argv[firstPath + (int) i], mismatchTick);
+            exitCode = 1;
+        }
+    }
+
+    printf("verified %u ticks in %zu segments on %zu threads in %.3f s (%.0f ticks/s)\n",
+           verifier.verifiedTickCount, segmentCount, threadCount, elapsedTime,
+           elapsedTime > 0.0 ? (double) verifier.verifiedTickCount / elapsedTime : 0.0);
+
+    for (size_t i = 0; i < replayCount; ++i) {
+        free(files[i]);
+    }
+    free(segments);
+    free(replays);
+    free(files);
+
+    return exitCode;
+}